@@ -0,0 +1,21 @@
+# Unicode::Collate with the default table: construct a collator, or
+# construct one and sort 5,000 accented words with it.
+#   collate.pl new|sort
+use strict;
+use warnings;
+use Unicode::Collate;
+
+my $kind = shift // 'new';
+my $collator = Unicode::Collate->new;
+
+if ($kind eq 'new') {
+    print "new ", scalar keys %{ $collator->{mapping} }, "\n";
+} elsif ($kind eq 'sort') {
+    srand(42);
+    my @letters = ('a' .. 'z', "\x{e0}", "\x{e9}", "\x{f1}", "\x{f6}", "\x{df}", 'l', "\x{b7}");
+    my @words = map { join '', map { $letters[rand @letters] } 1 .. 3 + $_ % 8 } 1 .. 5000;
+    my @sorted = $collator->sort(@words);
+    print "sort ", scalar @sorted, "\n";
+} else {
+    die "unknown kind: $kind\n";
+}
@@ -0,0 +1,11 @@
+# Exception throughput: eval/die goes through the Asyncify setjmp emulation.
+use strict;
+use warnings;
+
+my $caught = 0;
+for my $i (1 .. 100_000) {
+    eval { die "boom $i\n" };
+    $caught++ if $@;
+    eval { 1 } or die;
+}
+print "$caught\n";
@@ -0,0 +1,40 @@
+# Fork fan-out workload: four forked children, each doing CPU work and
+# reporting back over pipe(), one more over an implicit-fork pipe open, and
+# waitpid with their exit statuses. Needs a host that runs children
+# (runner.mjs, see tools/proc.mjs).
+use strict;
+use warnings;
+
+sub work { my $s = 0; $s += $_ * $_ % 7 for 1 .. 2_000_000; $s }
+
+my %kids;
+for my $n (1 .. 4) {
+    pipe(my $r, my $w) or die "pipe: $!";
+    my $pid = fork() // die "fork: $!";
+    if (!$pid) {
+        close $r;
+        print $w work(), "\n";
+        close $w;
+        exit $n;
+    }
+    close $w;
+    $kids{$pid} = [$n, $r];
+}
+my $sum = 0;
+for my $pid (sort { $a <=> $b } keys %kids) {
+    my ($n, $r) = @{ $kids{$pid} };
+    chomp(my $line = <$r>);
+    waitpid($pid, 0) == $pid or die "waitpid: $!";
+    die "child $n: $?" unless $? >> 8 == $n;
+    $sum += $line;
+}
+
+my $pid = open(my $fh, '-|') // die "fork: $!";
+if (!$pid) {
+    print "$$\n";
+    exit 0;
+}
+chomp(my $child = <$fh>);
+close $fh or die "child: $?";
+die "\$\$ in the child is $child, not $pid" unless $child == $pid;
+print "$sum\n";
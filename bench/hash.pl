@@ -0,0 +1,61 @@
+# Hash-heavy workloads:
+#   hash.pl        insert, lookup, iterate and delete "key:<n>:<n>" keys
+#   hash.pl tags   look up short tag names in a few fixed tables, as
+#                  ExifTool does for every tag it reads
+#   hash.pl long   count and sum by composite keys of 40 bytes and more, as
+#                  aggregation scripts do
+# Keys of up to 24 bytes take Perl's SBOX32 path when the build has it, so
+# between them these cover both halves of the hash function choice (see
+# tools/hash-bench.mjs).
+use strict;
+use warnings;
+
+my $kind = shift // 'keys';
+
+if ($kind eq 'keys') {
+    my %h;
+    for my $i (1 .. 100_000) {
+        $h{"key:$i:" . ($i * 2654435761 % 4294967296)} = $i;
+    }
+    my $hits = 0;
+    for my $i (1 .. 100_000) {
+        $hits++ if exists $h{"key:$i:" . ($i * 2654435761 % 4294967296)};
+    }
+    my $sum = 0;
+    while (my ($k, $v) = each %h) {
+        $sum += $v;
+    }
+    delete $h{$_} for grep { /7:/ } keys %h;
+    print "$hits $sum ", scalar(keys %h), "\n";
+}
+elsif ($kind eq 'tags') {
+    srand(7);
+    my @names = map { join '', map { chr(65 + rand 26) } 1 .. 4 + rand 12 } 1 .. 2000;
+    my @tables = map { my $t = $_; +{ map { $_ => "$t:$_" } @names[$t * 400 .. $t * 400 + 799] } } 0 .. 3;
+    my ($hits, $misses) = (0, 0);
+    for my $round (1 .. 400) {
+        for my $name (@names) {
+            for my $table (@tables) {
+                if (exists $table->{$name}) { $hits++ } else { $misses++ }
+            }
+        }
+    }
+    print "$hits $misses\n";
+}
+elsif ($kind eq 'long') {
+    srand(11);
+    my @hosts = map { sprintf 'host-%03d.region-%d.example.internal', $_, $_ % 7 } 1 .. 200;
+    my @paths = map { sprintf '/api/v2/resource/%d/items', $_ } 1 .. 50;
+    my (%count, %bytes);
+    for my $i (1 .. 200_000) {
+        my $key = join '|', $hosts[rand @hosts], $paths[rand @paths], 200 + int(rand 4) * 100;
+        $count{$key}++;
+        $bytes{$key} += $i % 1500;
+    }
+    my $total = 0;
+    $total += $_ for values %bytes;
+    print scalar(keys %count), " $total\n";
+}
+else {
+    die "unknown kind: $kind\n";
+}
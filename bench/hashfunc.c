@@ -0,0 +1,122 @@
+/*
+ Perl's hash function on its own, for comparing the PERL_HASH_FUNC_* choices
+ without rebuilding the interpreter for each. Built against a configured
+ perl tree with the same flags the interpreter would get from
+ tools/profile.js hash_ccflags, so PERL_HASH_WITH_STATE is exactly what
+ hv.c would call:
+
+   wasic -O3 $(node tools/profile.js minimal hash_ccflags zaphod32) \
+     -I <perl tree> bench/hashfunc.c -o hashfunc-zaphod32.wasm
+
+ Prints one line per key set:
+
+   <set> <ns per key> <checksum>
+
+ The key sets follow the workloads: short tag and method names such as
+ ExifTool's tag tables are full of, the "key:<n>:<n>" keys of bench/hash.pl,
+ and the longer composite keys of aggregation scripts. Keys up to
+ SBOX32_MAX_LEN (24) bytes take the SBOX32 path when it is enabled.
+ */
+#include "EXTERN.h"
+#include "perl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define KEYS 4096
+#define ROUNDS 512
+
+struct key_set
+{
+    const char *name;
+    size_t min_len;
+    size_t max_len;
+};
+
+static const struct key_set sets[] = {
+    {"tags", 4, 16},
+    {"keys", 12, 24},
+    {"long", 32, 64},
+    {"bulk", 200, 300},
+};
+
+static char *keys[KEYS];
+static size_t lens[KEYS];
+
+static uint32_t rng = 42;
+static volatile U32 sink;
+
+static uint32_t next_random(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// Identifier-like keys: letters and digits, as hash keys mostly are.
+static void make_keys(const struct key_set *set)
+{
+    static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_:";
+    for (int i = 0; i < KEYS; i++)
+    {
+        size_t len = set->min_len + next_random() % (set->max_len - set->min_len + 1);
+        keys[i] = realloc(keys[i], len);
+        for (size_t j = 0; j < len; j++)
+        {
+            keys[i][j] = chars[next_random() % (sizeof(chars) - 1)];
+        }
+        lens[i] = len;
+    }
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(void)
+{
+    static __PERL_HASH_WORD_TYPE state[PERL_HASH_STATE_WORDS];
+    U8 seed[PERL_HASH_SEED_BYTES];
+
+    for (size_t i = 0; i < sizeof(seed); i++)
+    {
+        seed[i] = (U8)next_random();
+    }
+    PERL_HASH_SEED_STATE(seed, (U8 *)state);
+    printf("# %s, %d keys x %d rounds\n", PERL_HASH_FUNC, KEYS, ROUNDS);
+
+    for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++)
+    {
+        make_keys(&sets[s]);
+        U32 sum = 0;
+        double start = now_ns();
+        for (int r = 0; r < ROUNDS; r++)
+        {
+            for (int i = 0; i < KEYS; i++)
+            {
+                U32 hash;
+                PERL_HASH_WITH_STATE((U8 *)state, hash, keys[i], lens[i]);
+                sum += hash;
+            }
+        }
+        double ns = (now_ns() - start) / ((double)KEYS * ROUNDS);
+        // The sum keeps the loop from being optimized away. The checksum
+        // printed covers one round, so that it differs between functions.
+        sink = sum;
+        U32 check = 0;
+        for (int i = 0; i < KEYS; i++)
+        {
+            U32 hash;
+            PERL_HASH_WITH_STATE((U8 *)state, hash, keys[i], lens[i]);
+            check = check * 33 + hash;
+        }
+        printf("%s %.2f %08x\n", sets[s].name, ns, (unsigned)check);
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+# JSON codec throughput over a fixed 1 MiB document: the statically linked
+# Cpanel::JSON::XS against pure-Perl JSON::PP, both through the OO interface
+# (JSON::PP's functional interface is routed to the XS codec).
+#   json.pl encode_xs|decode_xs|encode_pp|decode_pp [rounds]
+use strict;
+use warnings;
+
+my ($kind, $rounds) = (shift // 'encode_xs', shift // 16);
+my $size = 1 << 20;
+
+# Records of fixed width, so that both codecs produce exactly $size bytes
+# once the padding is added: escapes, non-ASCII text, nesting, integers,
+# exact floats and booleans.
+my @records = map {
+    {
+        id     => 100_000 + $_,
+        name   => "user-" . (100_000 + $_),
+        note   => "caf\x{e9} \"quoted\"\tline\n",
+        tags   => [ 'alpha', 'beta', $_ % 2 ? 'odd' : 'even' ],
+        score  => ($_ % 8) + 0.5,
+        active => $_ % 3 ? \1 : \0,
+        owner  => { group => 'ops', level => $_ % 10 },
+    }
+} 1 .. 6000;
+my $doc = { records => \@records, pad => '' };
+
+my $class = $kind =~ /_pp$/ ? 'JSON::PP' : 'Cpanel::JSON::XS';
+eval "require $class; 1" or die $@;
+my $json = $class->new->utf8->canonical;
+
+# One encode to size the padding, which is then spliced into the text.
+my $text = $json->encode($doc);
+die "document is already over $size bytes\n" if length $text > $size;
+$doc->{pad} = 'x' x ($size - length $text);
+$text =~ s/"pad":""/"pad":"$doc->{pad}"/ or die "no padding in the document\n";
+
+my %run = (
+    encode => sub {
+        my $n = length $json->encode($doc);
+        $n == $size or die "encoded $n bytes instead of $size\n";
+        return $n;
+    },
+    decode => sub { scalar @{ $json->decode($text)->{records} } },
+);
+my $code = $run{ $kind =~ s/_(xs|pp)$//r } or die "unknown kind: $kind\n";
+
+my $result;
+$result = $code->() for 1 .. $rounds;
+print "$kind $result\n";
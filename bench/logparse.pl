@@ -0,0 +1,39 @@
+# Log-parsing throughput over the generated stream on stdin: readline, split
+# and index per line, plus index, split and UTF-8 decode/upgrade/downgrade
+# over 1000-line blocks. These are the memchr/memcmp/strlen and UTF-8
+# scanning paths that the SIMD build vectorizes.
+use strict;
+use warnings;
+
+my (%status, $sum, $retries, $found);
+my @block;
+
+sub scan_block {
+    my ($block) = @_;
+    my $pos = 0;
+    while (($pos = index($block, 'retry', $pos)) >= 0) {
+        $found++;
+        $pos++;
+    }
+    utf8::decode($block);
+    utf8::upgrade($block);
+    utf8::downgrade($block);
+    my @lines = split /\n/, $block;
+    $found += rindex($block, 'line') > 0;
+    return scalar @lines;
+}
+
+while (my $line = <STDIN>) {
+    chomp $line;
+    my @f = split / /, $line;
+    $status{$f[5]}++;
+    $sum += $f[3];
+    $retries++ if index($line, 'retry') >= 0;
+    push @block, $line;
+    if (@block == 1000) {
+        scan_block(join "\n", @block);
+        @block = ();
+    }
+}
+scan_block(join "\n", @block) if @block;
+print join(',', map { "$_=$status{$_}" } sort keys %status), " $sum $retries $found\n";
@@ -0,0 +1,20 @@
+# Fan-out workload: four children over pipe opens, each doing CPU work and
+# reporting back, plus system() and its exit status. Needs a host that runs
+# children (runner.mjs, see tools/proc.mjs).
+use strict;
+use warnings;
+
+my $work = 'my $s = 0; $s += $_ * $_ % 7 for 1 .. 2_000_000; print "$s\n"';
+my @kids = map {
+    open(my $fh, '-|', $^X, '-e', $work) or die "pipe open: $!";
+    $fh;
+} 1 .. 4;
+my $sum = 0;
+for my $fh (@kids) {
+    chomp(my $line = <$fh>);
+    close $fh or die "child: $?";
+    $sum += $line;
+}
+system($^X, '-e', 'exit 3');
+die "system: $?" unless $? >> 8 == 3;
+print "$sum\n";
@@ -0,0 +1,24 @@
+# Regex-heavy workload over a fixed synthetic access log.
+use strict;
+use warnings;
+
+srand(42);
+my @verbs = qw(GET POST PUT DELETE HEAD);
+my @lines;
+for my $i (1 .. 20_000) {
+    push @lines, sprintf('10.%d.%d.%d - - [18/Oct/2026:12:%02d:%02d +0000] "%s /api/v%d/items/%d?q=%x HTTP/1.1" %d %d',
+        int(rand 256), int(rand 256), int(rand 256), $i % 60, ($i * 7) % 60,
+        $verbs[$i % @verbs], 1 + $i % 3, int(rand 100_000), int(rand 2**31),
+        (200, 201, 304, 404, 500)[$i % 5], int(rand 50_000));
+}
+
+my (%status, %verb, $bytes);
+for my $line (@lines) {
+    next unless $line =~ m{^(\d+\.\d+\.\d+\.\d+) \S+ \S+ \[([^\]]+)\] "(\w+) (\S+) HTTP/[\d.]+" (\d{3}) (\d+)$};
+    $verb{$3}++;
+    $status{$5}++;
+    $bytes += $6;
+    (my $path = $4) =~ s/\d+/N/g;
+    $path =~ tr/a-z/A-Z/;
+}
+print join(',', map { "$_=$status{$_}" } sort keys %status), " $bytes\n";
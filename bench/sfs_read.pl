@@ -0,0 +1,28 @@
+# Open, slurp and close a fixed set of core modules from the SFS.
+use strict;
+use warnings;
+
+my @modules = qw(strict.pm warnings.pm Carp.pm Exporter.pm constant.pm
+                 overload.pm File/Spec/Unix.pm Scalar/Util.pm List/Util.pm);
+my @paths;
+for my $mod (@modules) {
+    for my $dir (@INC) {
+        next if ref $dir;
+        if (-f "$dir/$mod") {
+            push @paths, "$dir/$mod";
+            last;
+        }
+    }
+}
+die "no modules found in \@INC\n" unless @paths;
+
+my $bytes = 0;
+for (1 .. 1000) {
+    for my $path (@paths) {
+        open my $fh, '<', $path or die "$path: $!";
+        local $/;
+        $bytes += length <$fh>;
+        close $fh;
+    }
+}
+print "$bytes\n";
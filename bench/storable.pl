@@ -0,0 +1,62 @@
+# Storable against the ways scripts get by without it, on a lookup table of
+# 5,000 records:
+#   storable.pl build      build the table from its source text
+#   storable.pl retrieve   load it with retrieve() from a file nstore() wrote
+#   storable.pl dclone     deep-copy it 3 times with dclone()
+#   storable.pl dumper     deep-copy it 3 times with Data::Dumper and eval
+# retrieve writes its file on the first run, which bench.mjs discards as the
+# warmup, so later runs only read it.
+use strict;
+use warnings;
+
+my $kind = shift // 'build';
+my $file = ($ENV{TMPDIR} // '/tmp') . '/zeroperl-bench-storable-1.bin';
+
+sub build {
+    srand(42);
+    my @words = map { join '', map { chr(97 + rand 26) } 1 .. 3 + rand 6 } 1 .. 2000;
+    my %table;
+    for my $i (1 .. 5_000) {
+        my $line = join ' ', map { $words[rand @words] } 1 .. 8;
+        my @tokens = split ' ', $line;
+        $table{"id$i"} = {
+            line   => $line,
+            tokens => \@tokens,
+            counts => { map { $_ => length } @tokens },
+            key    => lc(join '-', sort @tokens),
+        };
+    }
+    return \%table;
+}
+
+my %run = (
+    build    => sub { build() },
+    retrieve => sub {
+        require Storable;
+        Storable::nstore(build(), $file) unless -e $file;
+        return Storable::retrieve($file);
+    },
+    dclone => sub {
+        require Storable;
+        my $table = build();
+        my $copy;
+        $copy = Storable::dclone($table) for 1 .. 3;
+        return $copy;
+    },
+    dumper => sub {
+        require Data::Dumper;
+        my $table = build();
+        no warnings 'once';
+        local $Data::Dumper::Indent = 0;
+        my $copy;
+        for (1 .. 3) {
+            my $VAR1;
+            $copy = eval Data::Dumper::Dumper($table) or die $@;
+        }
+        return $copy;
+    },
+);
+my $code = $run{$kind} or die "unknown kind: $kind\n";
+
+my $table = $code->();
+print "$kind ", scalar(keys %$table), " $table->{id5000}{key}\n";
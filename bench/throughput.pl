@@ -0,0 +1,46 @@
+# Codec throughput: 16 passes over 1 MiB of fixed data with one of the
+# statically linked XS modules.
+#   throughput.pl base64|md5|sha256|zlib|crc32
+use strict;
+use warnings;
+
+my $kind = shift // 'base64';
+my $rounds = 16;
+
+# Half random bytes, half log-like text, so zlib has something to match.
+srand(42);
+my $data = pack('N*', map { int rand 2**32 } 1 .. 1 << 17)
+    . join('', map { "record $_ status " . ($_ % 7 ? 'ok' : 'retry') . "\n" } 1 .. 40_000);
+$data = substr($data, 0, 1 << 20);
+
+my %run = (
+    base64 => sub {
+        require MIME::Base64;
+        my $enc = MIME::Base64::encode_base64($data);
+        MIME::Base64::decode_base64($enc) eq $data or die "base64 round trip failed\n";
+        return length $enc;
+    },
+    md5 => sub {
+        require Digest::MD5;
+        return Digest::MD5::md5_hex($data);
+    },
+    sha256 => sub {
+        require Digest::SHA;
+        return Digest::SHA::sha256_hex($data);
+    },
+    zlib => sub {
+        require Compress::Zlib;
+        my $z = Compress::Zlib::compress($data);
+        Compress::Zlib::uncompress($z) eq $data or die "zlib round trip failed\n";
+        return length $z;
+    },
+    crc32 => sub {
+        require Compress::Raw::Zlib;
+        return Compress::Raw::Zlib::crc32($data);
+    },
+);
+my $code = $run{$kind} or die "unknown kind: $kind\n";
+
+my $result;
+$result = $code->() for 1 .. $rounds;
+print "$kind $result\n";
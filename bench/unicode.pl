@@ -0,0 +1,17 @@
+# First use of Unicode data in a fresh interpreter: one property match and
+# one case mapping on non-ASCII text. Compare with the startup case.
+#   unicode.pl prop|lc
+use strict;
+use warnings;
+
+my $kind = shift // 'prop';
+my $text = "caf\x{e9} \x{3a3}\x{3bf}\x{3c6}\x{3af}\x{3b1} \x{100}\x{17d}";
+
+if ($kind eq 'prop') {
+    my $n = () = $text =~ /\p{L}/g;
+    print "prop $n\n";
+} elsif ($kind eq 'lc') {
+    print 'lc ', length(lc $text), "\n";
+} else {
+    die "unknown kind: $kind\n";
+}
@@ -0,0 +1,99 @@
+package Image::ExifTool::LazyTable;
+
+# zeroperl's lazily loaded ExifTool tag tables. tools/exiftool-split.pl
+# moves the larger tag tables out of ExifTool's modules into
+# auto/<module path>/<table>.pl, as AutoSplit does for subs, and leaves a
+# call to Define() in their place. Each table's hash is tied to this class
+# until it is first used. That first use reads the table's source and
+# evaluates it through the loader sub the splitter adds to the end of the
+# module, which can see the module's file-scoped lexicals. The hash is then
+# untied and filled, and from there on it is an ordinary hash.
+#
+# A hash is not untied while Perl is iterating over it: keys, values and
+# each are answered from a copy until the iteration ends, and the next use
+# after that unties it.
+#
+# Set ZEROPERL_EXIFTOOL_LAZY=0 to load every table where it is defined, as
+# the unsplit modules do.
+
+use strict;
+use warnings;
+
+our $VERSION = '1.00';
+
+my $lazy = !defined $ENV{ZEROPERL_EXIFTOOL_LAZY} || $ENV{ZEROPERL_EXIFTOOL_LAZY};
+
+# Define(\%table, \&loader, 'Image/ExifTool/Canon/Main')
+sub Define
+{
+    my ($hash, $loader, $name) = @_;
+    my $self = bless { hash => $hash, loader => $loader, name => $name }, __PACKAGE__;
+    if ($lazy) {
+        tie %$hash, __PACKAGE__, $self;
+    } else {
+        %$hash = $self->Source;
+    }
+}
+
+# The table's key/value list, from auto/<module path>/<table>.pl next to
+# the module, or anywhere in @INC.
+sub Source
+{
+    my $self = shift;
+    my $name = $$self{name};
+    (my $module = $name) =~ s{/[^/]+$}{.pm};
+    my $file = $INC{$module};
+    unless (defined $file and $file =~ s{\Q$module\E$}{auto/$name.pl}) {
+        ($file) = grep { -f } map { "$_/auto/$name.pl" } grep { !ref } @INC;
+        defined $file or die "Can't locate auto/$name.pl in \@INC\n";
+    }
+    open my $fh, '<', $file or die "Can't read $file: $!\n";
+    my $src = do { local $/; <$fh> };
+    close $fh;
+    local $@;
+    my @list = $$self{loader}->($src);
+    die "Error loading $file: $@" if $@;
+    return @list;
+}
+
+# The table, untied and filled, or the copy while it is being iterated.
+sub Table
+{
+    my $self = shift;
+    return $$self{copy} if $$self{iterating};
+    my $hash = $$self{hash};
+    my @list = $$self{copy} ? %{$$self{copy}} : $self->Source;
+    # The caller holds the tied object, which untie would warn about.
+    no warnings 'untie';
+    untie %$hash;
+    %$hash = @list;
+    return $hash;
+}
+
+sub TIEHASH { return $_[1] }
+
+sub FETCH    { return $_[0]->Table->{$_[1]} }
+sub STORE    { $_[0]->Table->{$_[1]} = $_[2] }
+sub EXISTS   { return exists $_[0]->Table->{$_[1]} }
+sub DELETE   { return delete $_[0]->Table->{$_[1]} }
+sub CLEAR    { %{$_[0]->Table} = () }
+sub SCALAR   { return scalar %{$_[0]->Table} }
+
+sub FIRSTKEY
+{
+    my $self = shift;
+    $$self{copy} ||= { $self->Source };
+    $$self{iterating} = 1;
+    keys %{$$self{copy}};
+    return $self->NEXTKEY;
+}
+
+sub NEXTKEY
+{
+    my $self = shift;
+    my ($key) = each %{$$self{copy}};
+    $$self{iterating} = 0 unless defined $key;
+    return $key;
+}
+
+1;
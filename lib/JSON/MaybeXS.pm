@@ -0,0 +1,83 @@
+package JSON::MaybeXS;
+
+# zeroperl's JSON::MaybeXS: the same interface as the CPAN module, choosing
+# the statically linked Cpanel::JSON::XS when the build has it and JSON::PP
+# otherwise. Nothing is looked up on disk to decide: a linked extension
+# already has its bootstrap sub when the interpreter starts.
+
+use strict;
+use warnings;
+
+use Carp ();
+use Exporter ();
+use Scalar::Util ();
+
+our $VERSION = '1.004008';
+our @ISA = ('Exporter');
+our @EXPORT = qw(encode_json decode_json JSON);
+our @EXPORT_OK = qw(is_bool to_json from_json);
+our %EXPORT_TAGS = (
+    all    => [ @EXPORT, @EXPORT_OK ],
+    legacy => [qw(to_json from_json)],
+);
+
+my $class;
+BEGIN {
+    # PERL_JSON_PP_ONLY keeps the pure-Perl codec, as it does for JSON::PP.
+    if (!$ENV{PERL_JSON_PP_ONLY} && defined &Cpanel::JSON::XS::bootstrap
+        && eval { require Cpanel::JSON::XS; 1 }) {
+        $class = 'Cpanel::JSON::XS';
+    } else {
+        require JSON::PP;
+        $class = 'JSON::PP';
+    }
+}
+
+our $JSON_Class = $class;
+
+sub JSON () { $class }
+
+*encode_json = $class->can('encode_json');
+*decode_json = $class->can('decode_json');
+
+sub is_bool {
+    die 'is_bool is not a method' if $_[1];
+    # Both codecs decode true and false as JSON::PP::Boolean objects.
+    Scalar::Util::blessed($_[0]) and $_[0]->isa('JSON::PP::Boolean');
+}
+
+sub to_json ($@) {
+    if (ref $_[0] eq 'JSON::MaybeXS' or (@_ > 2 and @_ % 2 == 0)) {
+        Carp::croak 'to_json should not be called as a method';
+    }
+    my $json = $class->new;
+    if (@_ == 2 and ref $_[1] eq 'HASH') {
+        my $opt = $_[1];
+        $json->$_($opt->{$_}) for keys %$opt;
+    }
+    return $json->encode($_[0]);
+}
+
+sub from_json ($@) {
+    if (ref $_[0] eq 'JSON::MaybeXS' or (@_ > 2 and @_ % 2 == 0)) {
+        Carp::croak 'from_json should not be called as a method';
+    }
+    my $json = $class->new;
+    if (@_ == 2 and ref $_[1] eq 'HASH') {
+        my $opt = $_[1];
+        $json->$_($opt->{$_}) for keys %$opt;
+    }
+    return $json->decode($_[0]);
+}
+
+# JSON::MaybeXS->new(utf8 => 1, pretty => 1), with the options as a list or
+# a hash reference, returns an object of the chosen class.
+sub new {
+    shift;
+    my %args = @_ == 1 ? %{ $_[0] } : @_;
+    my $new = $class->new;
+    $new->$_($args{$_}) for keys %args;
+    return $new;
+}
+
+1;
@@ -1,11 +1,20 @@
 #ifndef ASYNCJMP_SUPPORT_ASYNCIFY_H
 #define ASYNCJMP_SUPPORT_ASYNCIFY_H
 
+// Asyncify keeps its state in wasm globals, which wasi-threads gives every
+// thread its own copy of. The bookkeeping on the C side has to follow, so
+// in a -pthread build it is thread-local.
+#ifdef _REENTRANT
+#define ASYNCJMP_THREAD_LOCAL _Thread_local
+#else
+#define ASYNCJMP_THREAD_LOCAL
+#endif
+
 __attribute__((import_module("asyncify"), import_name("start_unwind"))) void asyncify_start_unwind(void *buf);
 #define asyncify_start_unwind(buf)         \
     do                                     \
     {                                      \
-        extern void *pl_asyncify_unwind_buf; \
+        extern ASYNCJMP_THREAD_LOCAL void *pl_asyncify_unwind_buf; \
         pl_asyncify_unwind_buf = (buf);      \
         asyncify_start_unwind((buf));      \
     } while (0)
@@ -14,7 +23,7 @@ __attribute__((import_module("asyncify"), import_name("stop_unwind"))) void asyn
 #define asyncify_stop_unwind()             \
     do                                     \
     {                                      \
-        extern void *pl_asyncify_unwind_buf; \
+        extern ASYNCJMP_THREAD_LOCAL void *pl_asyncify_unwind_buf; \
         pl_asyncify_unwind_buf = NULL;       \
         asyncify_stop_unwind();            \
     } while (0)
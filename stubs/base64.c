@@ -0,0 +1,283 @@
+/*
+ SIMD128 MIME::Base64 codec.
+
+ Only built into the SIMD flavour. xs_init() registers
+ zeroperl_boot_MIME__Base64 as MIME::Base64's bootstrap: it runs the stock
+ boot_MIME__Base64 and then points encode_base64 and decode_base64 at the
+ versions below, which produce exactly the same results (line length,
+ end-of-line handling, padding, and skipping of characters outside the
+ alphabet) but convert 12 bytes <-> 16 characters per step.
+ */
+#include <stdbool.h>
+#include <wasm_simd128.h>
+#include "EXTERN.h"
+#include "perl.h"
+#include "XSUB.h"
+
+#define MAX_LINE 76 /* same as MIME::Base64 */
+#define LINE_GROUPS (MAX_LINE / 4)
+
+EXTERN_C void boot_MIME__Base64(pTHX_ CV *cv);
+
+static const char basis_64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#define XX 255 /* not in the alphabet */
+#define EQ 254 /* padding */
+static const unsigned char index_64[256] = {
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, 62, XX, XX, XX, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, XX, XX, XX, EQ, XX, XX,
+    XX, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, XX, XX, XX, XX, XX,
+    XX, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+    XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX, XX,
+};
+
+static inline v128_t in_range(v128_t v, uint8_t lo, uint8_t hi)
+{
+    return wasm_u8x16_le(wasm_i8x16_sub(v, wasm_u8x16_splat(lo)), wasm_u8x16_splat(hi - lo));
+}
+
+/* 12 bytes at s (16 readable) -> 16 characters at r. */
+static inline void encode12(const unsigned char *s, unsigned char *r)
+{
+    /* One 24-bit group per 32-bit lane, first byte most significant. */
+    const v128_t u = wasm_i8x16_swizzle(wasm_v128_load(s),
+                                        wasm_i8x16_const(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1));
+    const v128_t m = wasm_i32x4_splat(0x3f);
+
+    /* Spread the four 6-bit fields over the lane's bytes, in output order. */
+    v128_t c = wasm_v128_and(wasm_u32x4_shr(u, 18), m);
+    c = wasm_v128_or(c, wasm_i32x4_shl(wasm_v128_and(wasm_u32x4_shr(u, 12), m), 8));
+    c = wasm_v128_or(c, wasm_i32x4_shl(wasm_v128_and(wasm_u32x4_shr(u, 6), m), 16));
+    c = wasm_v128_or(c, wasm_i32x4_shl(wasm_v128_and(u, m), 24));
+
+    /* 0..25 -> 'A'.., 26..51 -> 'a'.., 52..61 -> '0'.., 62 -> '+', 63 -> '/' */
+    v128_t offset = wasm_i8x16_splat('A');
+    offset = wasm_v128_bitselect(wasm_i8x16_splat('a' - 26), offset, wasm_u8x16_gt(c, wasm_u8x16_splat(25)));
+    offset = wasm_v128_bitselect(wasm_i8x16_splat('0' - 52), offset, wasm_u8x16_gt(c, wasm_u8x16_splat(51)));
+    offset = wasm_v128_bitselect(wasm_i8x16_splat('+' - 62), offset, wasm_i8x16_eq(c, wasm_i8x16_splat(62)));
+    offset = wasm_v128_bitselect(wasm_i8x16_splat('/' - 63), offset, wasm_i8x16_eq(c, wasm_i8x16_splat(63)));
+    wasm_v128_store(r, wasm_i8x16_add(c, offset));
+}
+
+/* 16 characters at s -> 12 bytes at r (16 writable). Returns false, and
+   writes nothing, if any character is outside the alphabet, padding
+   included; the caller then takes the byte-at-a-time path. */
+static inline bool decode16(const unsigned char *s, unsigned char *r)
+{
+    const v128_t in = wasm_v128_load(s);
+    const v128_t upper = in_range(in, 'A', 'Z');
+    const v128_t lower = in_range(in, 'a', 'z');
+    const v128_t digit = in_range(in, '0', '9');
+    const v128_t plus = wasm_i8x16_eq(in, wasm_i8x16_splat('+'));
+    const v128_t slash = wasm_i8x16_eq(in, wasm_i8x16_splat('/'));
+    if (!wasm_i8x16_all_true(wasm_v128_or(wasm_v128_or(upper, lower), wasm_v128_or(wasm_v128_or(digit, plus), slash))))
+    {
+        return false;
+    }
+
+    v128_t offset = wasm_v128_and(upper, wasm_i8x16_splat(-'A'));
+    offset = wasm_v128_or(offset, wasm_v128_and(lower, wasm_i8x16_splat(26 - 'a')));
+    offset = wasm_v128_or(offset, wasm_v128_and(digit, wasm_i8x16_splat(52 - '0')));
+    offset = wasm_v128_or(offset, wasm_v128_and(plus, wasm_i8x16_splat(62 - '+')));
+    offset = wasm_v128_or(offset, wasm_v128_and(slash, wasm_i8x16_splat(63 - '/')));
+    const v128_t v = wasm_i8x16_add(in, offset);
+
+    /* Merge 6-bit values pairwise into 12 bits, then into 24 bits per lane. */
+    const v128_t ab = wasm_v128_or(wasm_i16x8_shl(wasm_v128_and(v, wasm_i16x8_splat(0x3f)), 6), wasm_u16x8_shr(v, 8));
+    const v128_t abcd = wasm_v128_or(wasm_i32x4_shl(wasm_v128_and(ab, wasm_i32x4_splat(0xfff)), 12), wasm_u32x4_shr(ab, 16));
+    wasm_v128_store(r, wasm_i8x16_swizzle(abcd, wasm_i8x16_const(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)));
+    return true;
+}
+
+static char *append_eol(char *r, const char *eol, STRLEN eollen)
+{
+    Copy(eol, r, eollen, char);
+    return r + eollen;
+}
+
+XS(zeroperl_xs_encode_base64)
+{
+    dXSARGS;
+    if (items < 1 || items > 2)
+    {
+        croak_xs_usage(cv, "sv, ...");
+    }
+
+    SV *sv = ST(0);
+    const char *eol = "\n";
+    STRLEN eollen = 1;
+    STRLEN len;
+
+    sv_utf8_downgrade(sv, FALSE);
+    const unsigned char *str = (const unsigned char *)SvPV(sv, len);
+    if (items > 1 && SvOK(ST(1)))
+    {
+        eol = SvPV(ST(1), eollen);
+    }
+
+    STRLEN rlen = (len + 2) / 3 * 4;
+    if (rlen)
+    {
+        rlen += ((rlen - 1) / MAX_LINE + 1) * eollen;
+    }
+    SV *RETVAL = newSV(rlen ? rlen : 1);
+    SvPOK_on(RETVAL);
+    SvCUR_set(RETVAL, rlen);
+    char *r = SvPVX(RETVAL);
+
+    const unsigned char *end = str + len;
+    bool first = true;
+    while (str < end)
+    {
+        if (!first)
+        {
+            r = append_eol(r, eol, eollen);
+        }
+        first = false;
+
+        const unsigned char *line_end = end - str > LINE_GROUPS * 3 ? str + LINE_GROUPS * 3 : end;
+        while (line_end - str >= 12 && end - str >= 16)
+        {
+            encode12(str, (unsigned char *)r);
+            str += 12;
+            r += 16;
+        }
+        for (; str < line_end; str += 3)
+        {
+            const STRLEN left = line_end - str;
+            const unsigned char c1 = str[0];
+            const unsigned char c2 = left > 1 ? str[1] : 0;
+            *r++ = basis_64[c1 >> 2];
+            *r++ = basis_64[((c1 & 0x3) << 4) | ((c2 & 0xF0) >> 4)];
+            if (left > 2)
+            {
+                const unsigned char c3 = str[2];
+                *r++ = basis_64[((c2 & 0xF) << 2) | ((c3 & 0xC0) >> 6)];
+                *r++ = basis_64[c3 & 0x3F];
+            }
+            else
+            {
+                *r++ = left == 2 ? basis_64[(c2 & 0xF) << 2] : '=';
+                *r++ = '=';
+                str = line_end;
+                break;
+            }
+        }
+    }
+    if (rlen)
+    {
+        r = append_eol(r, eol, eollen);
+    }
+    *r = '\0';
+
+    ST(0) = sv_2mortal(RETVAL);
+    XSRETURN(1);
+}
+
+XS(zeroperl_xs_decode_base64)
+{
+    dXSARGS;
+    if (items != 1)
+    {
+        croak_xs_usage(cv, "sv");
+    }
+
+    STRLEN len;
+    const unsigned char *str = (const unsigned char *)SvPV(ST(0), len);
+    const unsigned char *end = str + len;
+
+    /* Room for the 16-byte vector store at the end. */
+    SV *RETVAL = newSV(len * 3 / 4 + 16);
+    SvPOK_on(RETVAL);
+    char *r = SvPVX(RETVAL);
+
+    while (str < end)
+    {
+        if (end - str >= 16 && decode16(str, (unsigned char *)r))
+        {
+            str += 16;
+            r += 12;
+            continue;
+        }
+
+        /* One group of four, exactly as MIME::Base64 does it. */
+        unsigned char c[4];
+        int i = 0;
+        do
+        {
+            const unsigned char uc = index_64[*str++];
+            if (uc != XX)
+            {
+                c[i++] = uc;
+            }
+            if (str == end)
+            {
+                if (i < 4)
+                {
+                    if (i < 2)
+                    {
+                        goto done;
+                    }
+                    if (i == 2)
+                    {
+                        c[2] = EQ;
+                    }
+                    c[3] = EQ;
+                }
+                break;
+            }
+        } while (i < 4);
+
+        if (c[0] == EQ || c[1] == EQ)
+        {
+            break;
+        }
+        *r++ = (c[0] << 2) | ((c[1] & 0x30) >> 4);
+        if (c[2] == EQ)
+        {
+            break;
+        }
+        *r++ = ((c[1] & 0x0F) << 4) | ((c[2] & 0x3C) >> 2);
+        if (c[3] == EQ)
+        {
+            break;
+        }
+        *r++ = ((c[2] & 0x03) << 6) | c[3];
+    }
+done:
+    SvCUR_set(RETVAL, r - SvPVX(RETVAL));
+    *r = '\0';
+
+    ST(0) = sv_2mortal(RETVAL);
+    XSRETURN(1);
+}
+
+XS(zeroperl_boot_MIME__Base64)
+{
+    /* The stock boot does the version handshake and defines every XSUB;
+       then swap in the vectorized bodies. Prototypes are kept. */
+    boot_MIME__Base64(aTHX_ cv);
+
+    CV *encode = get_cv("MIME::Base64::encode_base64", 0);
+    CV *decode = get_cv("MIME::Base64::decode_base64", 0);
+    if (encode && CvISXSUB(encode))
+    {
+        CvXSUB(encode) = zeroperl_xs_encode_base64;
+    }
+    if (decode && CvISXSUB(decode))
+    {
+        CvXSUB(decode) = zeroperl_xs_decode_base64;
+    }
+}
@@ -0,0 +1,852 @@
+/*
+ Metadata cache for read-only host directories.
+
+ Outside the SFS, every stat(), access(), open() and directory read is a
+ WASI host call, and most of the ones Perl makes fail: require probes each
+ @INC directory in turn, -e/-f checks look for optional files, and glob()
+ lists directories and lstat()s every match. When the host directory cannot
+ change while the instance runs, none of these answers can change either.
+
+ ZEROPERL_IMMUTABLE lists such directories, separated by ':'. For paths
+ below them this file remembers, in an in-module hash table keyed by the
+ absolute path:
+   - the result of stat() and lstat(), including failures (negative
+     lookups), so a missing file costs one host call per instance;
+   - the result of access() for each mode;
+   - open() failures, so read-only opens of known-missing paths fail
+     without asking the host;
+   - complete directory listings, which opendir()/readdir() then serve
+     from memory.
+ Opening an immutable path for writing drops its entry and its parent's
+ listing, but nothing else is invalidated: only list directories that
+ really are read-only for the lifetime of the instance. dirfd() is not
+ available on a directory served from the cache.
+
+ Directory streams on the tmpfs (see tmpfs.c) are handed to it here too.
+
+ Counters are available through zeroperl_fscache_get_stats(), and are
+ printed to stderr at exit when ZEROPERL_FSCACHE_STATS is set. In the
+ wasi-threads build one lock covers the table and the open directory list;
+ a directory stream itself belongs to the thread that opened it.
+ */
+#include "fscache.h"
+#include "lock.h"
+#include "tmpfs.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef NAME_MAX
+#define NAME_MAX 255
+#endif
+
+#define FSCACHE_PATH_MAX 1024
+#define FSCACHE_MAX_PREFIXES 16
+#define ERR_UNKNOWN (-1)
+
+extern int __real_stat(const char *restrict path, struct stat *restrict st);
+extern int __real_lstat(const char *restrict path, struct stat *restrict st);
+extern int __real_access(const char *path, int amode);
+extern int __real_open(const char *path, int flags, ...);
+extern DIR *__real_opendir(const char *path);
+extern struct dirent *__real_readdir(DIR *dir);
+extern int __real_closedir(DIR *dir);
+extern void __real_rewinddir(DIR *dir);
+extern long __real_telldir(DIR *dir);
+extern void __real_seekdir(DIR *dir, long loc);
+extern int __real_dirfd(DIR *dir);
+
+struct fscache_dirent
+{
+    ino_t ino;
+    unsigned char type;
+    const char *name;
+};
+
+struct fscache_listing
+{
+    size_t count;
+    struct fscache_dirent *items; // names are stored right after the array
+};
+
+// For every cached result, ERR_UNKNOWN means not asked yet, 0 success and
+// anything else the errno the host returned.
+struct fscache_entry
+{
+    char *path;
+    uint32_t hash;
+    int stat_err;
+    int lstat_err;
+    struct stat st;
+    struct stat lst;
+    int access_err[8]; // by amode (F_OK, R_OK, W_OK, X_OK combinations)
+    struct fscache_listing *listing;
+};
+
+// A directory stream served from a cached listing. Handed out as DIR *;
+// the wrappers recognise it by address.
+struct fscache_dir
+{
+    struct fscache_dir *next;
+    struct fscache_listing *listing;
+    size_t pos;
+    union
+    {
+        struct dirent ent;
+        char buf[sizeof(struct dirent) + NAME_MAX + 1];
+    } out;
+};
+
+static bool initialised;
+static char *prefixes[FSCACHE_MAX_PREFIXES];
+static size_t prefix_lens[FSCACHE_MAX_PREFIXES];
+static size_t nprefixes;
+
+static struct fscache_entry **slots;
+static size_t slot_count; // power of two
+static size_t slot_used;
+
+static struct fscache_dir *open_dirs;
+static struct zeroperl_fscache_stats stats;
+
+ZEROPERL_MUTEX(fscache_lock);
+
+/* -------------------------------------------------------------------------
+ * Paths.
+ * ------------------------------------------------------------------------- */
+
+// Make path absolute (wasi-libc keeps the cwd itself, so getcwd() is not a
+// host call) and drop empty and "." components. ".." is kept: this is only
+// a cache key, and two spellings of one file just get two entries. A
+// trailing slash is kept too, since it changes what stat() returns.
+static bool normalize(char *dst, const char *path)
+{
+    char tmp[FSCACHE_PATH_MAX];
+    size_t len;
+
+    if (path[0] == '/')
+    {
+        len = strlen(path);
+        if (len >= sizeof(tmp))
+        {
+            return false;
+        }
+        memcpy(tmp, path, len + 1);
+    }
+    else
+    {
+        if (!getcwd(tmp, sizeof(tmp)))
+        {
+            return false;
+        }
+        size_t cwd = strlen(tmp);
+        len = strlen(path);
+        if (cwd + 1 + len >= sizeof(tmp))
+        {
+            return false;
+        }
+        tmp[cwd] = '/';
+        memcpy(tmp + cwd + 1, path, len + 1);
+    }
+
+    size_t j = 0;
+    for (size_t i = 0; tmp[i]; i++)
+    {
+        if (tmp[i] == '/' && j > 0 && dst[j - 1] == '/')
+        {
+            continue;
+        }
+        if (tmp[i] == '.' && j > 0 && dst[j - 1] == '/' && (tmp[i + 1] == '/' || tmp[i + 1] == '\0'))
+        {
+            if (tmp[i + 1] == '/')
+            {
+                i++;
+            }
+            continue;
+        }
+        dst[j++] = tmp[i];
+    }
+    dst[j] = '\0';
+    return true;
+}
+
+static void init(void)
+{
+    const char *env = getenv("ZEROPERL_IMMUTABLE");
+    initialised = true;
+    if (!env)
+    {
+        return;
+    }
+
+    char key[FSCACHE_PATH_MAX];
+    while (*env && nprefixes < FSCACHE_MAX_PREFIXES)
+    {
+        const char *end = strchr(env, ':');
+        size_t len = end ? (size_t)(end - env) : strlen(env);
+        if (len > 0 && len < sizeof(key))
+        {
+            char dir[FSCACHE_PATH_MAX];
+            memcpy(dir, env, len);
+            dir[len] = '\0';
+            if (normalize(key, dir))
+            {
+                size_t klen = strlen(key);
+                while (klen > 1 && key[klen - 1] == '/')
+                {
+                    key[--klen] = '\0';
+                }
+                prefixes[nprefixes] = strdup(key);
+                prefix_lens[nprefixes] = klen;
+                nprefixes++;
+            }
+        }
+        env += len;
+        if (*env == ':')
+        {
+            env++;
+        }
+    }
+}
+
+// Normalise path into key and report whether it lies below an immutable
+// directory.
+static bool immutable_key(const char *path, char *key)
+{
+    if (!initialised)
+    {
+        init();
+    }
+    if (!nprefixes || !path || !normalize(key, path))
+    {
+        stats.passthrough++;
+        return false;
+    }
+    for (size_t i = 0; i < nprefixes; i++)
+    {
+        size_t n = prefix_lens[i];
+        if (strncmp(key, prefixes[i], n) == 0 && (key[n] == '\0' || key[n] == '/' || n == 1))
+        {
+            return true;
+        }
+    }
+    stats.passthrough++;
+    return false;
+}
+
+/* -------------------------------------------------------------------------
+ * Hash table (open addressing, linear probing, FNV-1a).
+ * ------------------------------------------------------------------------- */
+
+static uint32_t hash_path(const char *s)
+{
+    uint32_t h = 2166136261u;
+    for (; *s; s++)
+    {
+        h = (h ^ (unsigned char)*s) * 16777619u;
+    }
+    return h;
+}
+
+static bool grow(void)
+{
+    size_t count = slot_count ? slot_count * 2 : 256;
+    struct fscache_entry **fresh = calloc(count, sizeof(*fresh));
+    if (!fresh)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < slot_count; i++)
+    {
+        struct fscache_entry *e = slots[i];
+        if (!e)
+        {
+            continue;
+        }
+        size_t j = e->hash & (count - 1);
+        while (fresh[j])
+        {
+            j = (j + 1) & (count - 1);
+        }
+        fresh[j] = e;
+    }
+    free(slots);
+    slots = fresh;
+    slot_count = count;
+    return true;
+}
+
+// Find the entry for key, creating it if create is set. Returns NULL if it
+// does not exist (or cannot be allocated).
+static struct fscache_entry *lookup(const char *key, bool create)
+{
+    uint32_t h = hash_path(key);
+    if (slot_count)
+    {
+        for (size_t i = h & (slot_count - 1); slots[i]; i = (i + 1) & (slot_count - 1))
+        {
+            if (slots[i]->hash == h && strcmp(slots[i]->path, key) == 0)
+            {
+                return slots[i];
+            }
+        }
+    }
+    if (!create)
+    {
+        return NULL;
+    }
+    if ((slot_used + 1) * 4 > slot_count * 3 && !grow())
+    {
+        return NULL;
+    }
+
+    struct fscache_entry *e = calloc(1, sizeof(*e));
+    if (!e || !(e->path = strdup(key)))
+    {
+        free(e);
+        return NULL;
+    }
+    e->hash = h;
+    e->stat_err = ERR_UNKNOWN;
+    e->lstat_err = ERR_UNKNOWN;
+    for (int m = 0; m < 8; m++)
+    {
+        e->access_err[m] = ERR_UNKNOWN;
+    }
+
+    size_t i = h & (slot_count - 1);
+    while (slots[i])
+    {
+        i = (i + 1) & (slot_count - 1);
+    }
+    slots[i] = e;
+    slot_used++;
+    stats.entries++;
+    return e;
+}
+
+// Forget what is known about key (and the listing of its parent directory)
+// after it was opened for writing. The entry stays in the table.
+static void invalidate(const char *key)
+{
+    struct fscache_entry *e = lookup(key, false);
+    if (e)
+    {
+        e->stat_err = e->lstat_err = ERR_UNKNOWN;
+        for (int m = 0; m < 8; m++)
+        {
+            e->access_err[m] = ERR_UNKNOWN;
+        }
+    }
+
+    // normalize() keeps trailing slashes, so "/a/b/" is listed in "/a",
+    // which may itself have been opened as "/a/".
+    char parent[FSCACHE_PATH_MAX + 1];
+    size_t klen = strlen(key);
+    while (klen > 1 && key[klen - 1] == '/')
+    {
+        klen--;
+    }
+    memcpy(parent, key, klen);
+    parent[klen] = '\0';
+    const char *slash = strrchr(parent, '/');
+    if (!slash || klen == 1)
+    {
+        return;
+    }
+    size_t len = slash == parent ? 1 : (size_t)(slash - parent);
+    for (int spelling = 0; spelling < 2; spelling++)
+    {
+        parent[len] = '\0';
+        if (spelling)
+        {
+            if (len == 1)
+            {
+                break;
+            }
+            parent[len] = '/';
+            parent[len + 1] = '\0';
+        }
+        e = lookup(parent, false);
+        if (e)
+        {
+            // Open streams keep the old listing; it is leaked rather than
+            // tracked, which only happens when a "read-only" directory is not.
+            e->listing = NULL;
+        }
+    }
+}
+
+// A path lstat cannot find is missing for every call, but one stat cannot
+// find may still be a dangling symlink that lstat sees. stat, access, open
+// and opendir follow links and take either; lstat only takes its own.
+static int known_missing(const struct fscache_entry *e)
+{
+    if (e->stat_err == ENOENT || e->stat_err == ENOTDIR)
+    {
+        return e->stat_err;
+    }
+    if (e->lstat_err == ENOENT || e->lstat_err == ENOTDIR)
+    {
+        return e->lstat_err;
+    }
+    return 0;
+}
+
+static int known_missing_link(const struct fscache_entry *e)
+{
+    if (e->lstat_err == ENOENT || e->lstat_err == ENOTDIR)
+    {
+        return e->lstat_err;
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------
+ * stat, lstat, access, open.
+ * ------------------------------------------------------------------------- */
+
+static int cached_stat(const char *path, struct stat *st, bool link)
+{
+    char key[FSCACHE_PATH_MAX];
+    if (!immutable_key(path, key))
+    {
+        return link ? __real_lstat(path, st) : __real_stat(path, st);
+    }
+
+    struct fscache_entry *e = lookup(key, true);
+    if (!e)
+    {
+        return link ? __real_lstat(path, st) : __real_stat(path, st);
+    }
+
+    int *err = link ? &e->lstat_err : &e->stat_err;
+    struct stat *saved = link ? &e->lst : &e->st;
+    int missing = link ? known_missing_link(e) : known_missing(e);
+    if (*err == ERR_UNKNOWN && missing)
+    {
+        *err = missing;
+    }
+    if (*err != ERR_UNKNOWN)
+    {
+        stats.stat_hits++;
+        if (*err)
+        {
+            stats.negative_hits++;
+            errno = *err;
+            return -1;
+        }
+        *st = *saved;
+        return 0;
+    }
+
+    stats.stat_misses++;
+    int rc = link ? __real_lstat(path, saved) : __real_stat(path, saved);
+    *err = rc == 0 ? 0 : errno;
+    if (rc == 0)
+    {
+        *st = *saved;
+    }
+    return rc;
+}
+
+int zeroperl_fscache_stat(const char *path, struct stat *st)
+{
+    ZEROPERL_LOCK(fscache_lock);
+    int rc = cached_stat(path, st, false);
+    ZEROPERL_UNLOCK(fscache_lock);
+    return rc;
+}
+
+int zeroperl_fscache_lstat(const char *path, struct stat *st)
+{
+    ZEROPERL_LOCK(fscache_lock);
+    int rc = cached_stat(path, st, true);
+    ZEROPERL_UNLOCK(fscache_lock);
+    return rc;
+}
+
+static int cached_access(const char *path, int amode)
+{
+    char key[FSCACHE_PATH_MAX];
+    struct fscache_entry *e;
+    if ((amode & ~7) || !immutable_key(path, key) || !(e = lookup(key, true)))
+    {
+        return __real_access(path, amode);
+    }
+
+    int missing = known_missing(e);
+    if (e->access_err[amode] == ERR_UNKNOWN && missing)
+    {
+        e->access_err[amode] = missing;
+    }
+    if (e->access_err[amode] != ERR_UNKNOWN)
+    {
+        stats.access_hits++;
+        if (e->access_err[amode])
+        {
+            errno = e->access_err[amode];
+            return -1;
+        }
+        return 0;
+    }
+
+    stats.access_misses++;
+    int rc = __real_access(path, amode);
+    e->access_err[amode] = rc == 0 ? 0 : errno;
+    return rc;
+}
+
+int zeroperl_fscache_access(const char *path, int amode)
+{
+    ZEROPERL_LOCK(fscache_lock);
+    int rc = cached_access(path, amode);
+    ZEROPERL_UNLOCK(fscache_lock);
+    return rc;
+}
+
+static int cached_open(const char *path, int flags, int mode)
+{
+    char key[FSCACHE_PATH_MAX];
+    if (!immutable_key(path, key))
+    {
+        return __real_open(path, flags, mode);
+    }
+
+    if ((flags & O_ACCMODE) != O_RDONLY || (flags & (O_CREAT | O_TRUNC)))
+    {
+        invalidate(key);
+        stats.open_misses++;
+        return __real_open(path, flags, mode);
+    }
+
+    struct fscache_entry *e = lookup(key, true);
+    int missing = e ? known_missing(e) : 0;
+    if (missing)
+    {
+        stats.open_hits++;
+        errno = missing;
+        return -1;
+    }
+
+    stats.open_misses++;
+    int fd = __real_open(path, flags, mode);
+    if (fd < 0 && e && (errno == ENOENT || errno == ENOTDIR) && e->stat_err == ERR_UNKNOWN)
+    {
+        e->stat_err = errno;
+    }
+    return fd;
+}
+
+int zeroperl_fscache_open(const char *path, int flags, int mode)
+{
+    ZEROPERL_LOCK(fscache_lock);
+    int fd = cached_open(path, flags, mode);
+    ZEROPERL_UNLOCK(fscache_lock);
+    return fd;
+}
+
+/* -------------------------------------------------------------------------
+ * Directory listings.
+ * ------------------------------------------------------------------------- */
+
+static struct fscache_listing *read_listing(DIR *dir)
+{
+    size_t cap = 32, count = 0, names = 0, pool_cap = 1024;
+    struct fscache_dirent *items = malloc(cap * sizeof(*items));
+    char *pool = malloc(pool_cap);
+    struct dirent *d;
+
+    if (!items || !pool)
+    {
+        goto fail;
+    }
+    // Collect entries and names into growing buffers first; names are
+    // recorded as offsets into the pool until it stops moving.
+    while ((d = __real_readdir(dir)))
+    {
+        size_t len = strlen(d->d_name) + 1;
+        if (count == cap)
+        {
+            struct fscache_dirent *more = realloc(items, (cap *= 2) * sizeof(*items));
+            if (!more)
+            {
+                goto fail;
+            }
+            items = more;
+        }
+        while (names + len > pool_cap)
+        {
+            char *more = realloc(pool, pool_cap *= 2);
+            if (!more)
+            {
+                goto fail;
+            }
+            pool = more;
+        }
+        items[count].ino = d->d_ino;
+        items[count].type = d->d_type;
+        items[count].name = (const char *)(uintptr_t)names;
+        memcpy(pool + names, d->d_name, len);
+        names += len;
+        count++;
+    }
+
+    // One block: the listing, the items, then the names.
+    struct fscache_listing *l = malloc(sizeof(*l) + count * sizeof(*items) + names);
+    if (!l)
+    {
+        goto fail;
+    }
+    l->count = count;
+    l->items = (struct fscache_dirent *)(l + 1);
+    char *text = (char *)(l->items + count);
+    memcpy(text, pool, names);
+    for (size_t i = 0; i < count; i++)
+    {
+        l->items[i] = items[i];
+        l->items[i].name = text + (uintptr_t)items[i].name;
+    }
+    free(items);
+    free(pool);
+    return l;
+
+fail:
+    free(items);
+    free(pool);
+    return NULL;
+}
+
+static struct fscache_dir *find_dir(DIR *dir)
+{
+    struct fscache_dir *d;
+    ZEROPERL_LOCK(fscache_lock);
+    for (d = open_dirs; d; d = d->next)
+    {
+        if ((DIR *)d == dir)
+        {
+            break;
+        }
+    }
+    ZEROPERL_UNLOCK(fscache_lock);
+    return d;
+}
+
+static DIR *cached_opendir(const char *path)
+{
+    char key[FSCACHE_PATH_MAX];
+    struct fscache_entry *e;
+    if (!immutable_key(path, key) || !(e = lookup(key, true)))
+    {
+        return __real_opendir(path);
+    }
+
+    int missing = known_missing(e);
+    if (missing)
+    {
+        stats.dir_hits++;
+        errno = missing;
+        return NULL;
+    }
+    if (e->listing)
+    {
+        stats.dir_hits++;
+    }
+    else
+    {
+        stats.dir_misses++;
+        DIR *real = __real_opendir(path);
+        if (!real)
+        {
+            if ((errno == ENOENT || errno == ENOTDIR) && e->stat_err == ERR_UNKNOWN)
+            {
+                e->stat_err = errno;
+            }
+            return NULL;
+        }
+        e->listing = read_listing(real);
+        if (!e->listing)
+        {
+            // Out of memory: hand out the host stream instead.
+            __real_rewinddir(real);
+            return real;
+        }
+        __real_closedir(real);
+    }
+
+    struct fscache_dir *d = calloc(1, sizeof(*d));
+    if (!d)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    d->listing = e->listing;
+    d->next = open_dirs;
+    open_dirs = d;
+    return (DIR *)d;
+}
+
+DIR *__wrap_opendir(const char *path)
+{
+    if (zeroperl_tmpfs_path(path))
+    {
+        return zeroperl_tmpfs_opendir(path);
+    }
+    ZEROPERL_LOCK(fscache_lock);
+    DIR *dir = cached_opendir(path);
+    ZEROPERL_UNLOCK(fscache_lock);
+    return dir;
+}
+
+struct dirent *__wrap_readdir(DIR *dir)
+{
+    if (zeroperl_tmpfs_dir(dir))
+    {
+        return zeroperl_tmpfs_readdir(dir);
+    }
+    struct fscache_dir *d = find_dir(dir);
+    if (!d)
+    {
+        return __real_readdir(dir);
+    }
+    if (d->pos >= d->listing->count)
+    {
+        return NULL;
+    }
+    const struct fscache_dirent *item = &d->listing->items[d->pos++];
+    d->out.ent.d_ino = item->ino;
+    d->out.ent.d_type = item->type;
+    size_t len = strlen(item->name);
+    if (len > NAME_MAX)
+    {
+        len = NAME_MAX;
+    }
+    memcpy(d->out.ent.d_name, item->name, len);
+    d->out.ent.d_name[len] = '\0';
+    return &d->out.ent;
+}
+
+int __wrap_closedir(DIR *dir)
+{
+    if (zeroperl_tmpfs_dir(dir))
+    {
+        return zeroperl_tmpfs_closedir(dir);
+    }
+    struct fscache_dir *d = NULL;
+    ZEROPERL_LOCK(fscache_lock);
+    for (struct fscache_dir **p = &open_dirs; *p; p = &(*p)->next)
+    {
+        if ((DIR *)*p == dir)
+        {
+            d = *p;
+            *p = d->next;
+            break;
+        }
+    }
+    ZEROPERL_UNLOCK(fscache_lock);
+    if (!d)
+    {
+        return __real_closedir(dir);
+    }
+    free(d);
+    return 0;
+}
+
+void __wrap_rewinddir(DIR *dir)
+{
+    if (zeroperl_tmpfs_dir(dir))
+    {
+        zeroperl_tmpfs_seekdir(dir, 0);
+        return;
+    }
+    struct fscache_dir *d = find_dir(dir);
+    if (!d)
+    {
+        __real_rewinddir(dir);
+        return;
+    }
+    d->pos = 0;
+}
+
+long __wrap_telldir(DIR *dir)
+{
+    if (zeroperl_tmpfs_dir(dir))
+    {
+        return zeroperl_tmpfs_telldir(dir);
+    }
+    struct fscache_dir *d = find_dir(dir);
+    return d ? (long)d->pos : __real_telldir(dir);
+}
+
+void __wrap_seekdir(DIR *dir, long loc)
+{
+    if (zeroperl_tmpfs_dir(dir))
+    {
+        zeroperl_tmpfs_seekdir(dir, loc);
+        return;
+    }
+    struct fscache_dir *d = find_dir(dir);
+    if (!d)
+    {
+        __real_seekdir(dir, loc);
+        return;
+    }
+    d->pos = loc < 0 ? 0 : (size_t)loc;
+}
+
+int __wrap_dirfd(DIR *dir)
+{
+    if (zeroperl_tmpfs_dir(dir) || find_dir(dir))
+    {
+        errno = ENOTSUP;
+        return -1;
+    }
+    return __real_dirfd(dir);
+}
+
+/* -------------------------------------------------------------------------
+ * Statistics.
+ * ------------------------------------------------------------------------- */
+
+void zeroperl_fscache_get_stats(struct zeroperl_fscache_stats *out)
+{
+    *out = stats;
+}
+
+void zeroperl_fscache_report(int fd)
+{
+    char line[200];
+    int n;
+    uint32_t avoided = stats.stat_hits + stats.access_hits + stats.open_hits;
+
+    n = snprintf(line, sizeof(line),
+                 "fscache: %u paths, avoided %u host lookups and %u directory listings, %u lookups outside immutable dirs\n",
+                 stats.entries, avoided, stats.dir_hits, stats.passthrough);
+    write(fd, line, (size_t)n);
+    n = snprintf(line, sizeof(line),
+                 "fscache: stat %u hits (%u negative) %u misses, access %u/%u, open %u refused %u passed, opendir %u/%u\n",
+                 stats.stat_hits, stats.negative_hits, stats.stat_misses, stats.access_hits, stats.access_misses,
+                 stats.open_hits, stats.open_misses, stats.dir_hits, stats.dir_misses);
+    write(fd, line, (size_t)n);
+}
+
+static void zeroperl_fscache_report_at_exit(void)
+{
+    zeroperl_fscache_report(STDERR_FILENO);
+}
+
+__attribute__((constructor)) static void zeroperl_fscache_init(void)
+{
+    const char *env = getenv("ZEROPERL_FSCACHE_STATS");
+    if (env && *env && strcmp(env, "0") != 0)
+    {
+        atexit(zeroperl_fscache_report_at_exit);
+    }
+}
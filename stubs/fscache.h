@@ -0,0 +1,38 @@
+#ifndef ZEROPERL_FSCACHE_H
+#define ZEROPERL_FSCACHE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+// Metadata cache for host directories declared immutable through
+// ZEROPERL_IMMUTABLE, see fscache.c. Each function behaves like the libc
+// call it is named after; paths outside the immutable directories go
+// straight to the host.
+int zeroperl_fscache_stat(const char *path, struct stat *st);
+int zeroperl_fscache_lstat(const char *path, struct stat *st);
+int zeroperl_fscache_access(const char *path, int amode);
+int zeroperl_fscache_open(const char *path, int flags, int mode);
+
+struct zeroperl_fscache_stats
+{
+    uint32_t entries;       // paths in the cache
+    uint32_t stat_hits;     // stat/lstat answered from the cache...
+    uint32_t negative_hits; // ...of which the path does not exist
+    uint32_t stat_misses;   // stat/lstat that went to the host to fill it
+    uint32_t access_hits;
+    uint32_t access_misses;
+    uint32_t open_hits;     // open() refused from a cached negative lookup
+    uint32_t open_misses;   // open() on an immutable path passed to the host
+    uint32_t dir_hits;      // opendir() served from a cached listing
+    uint32_t dir_misses;    // listings read from the host
+    uint32_t passthrough;   // calls for paths outside the immutable dirs
+};
+
+// Fill *out with the cache counters.
+void zeroperl_fscache_get_stats(struct zeroperl_fscache_stats *out);
+
+// Write a summary to fd. Also done at exit when ZEROPERL_FSCACHE_STATS is
+// set in the environment.
+void zeroperl_fscache_report(int fd);
+
+#endif
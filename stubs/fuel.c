@@ -0,0 +1,176 @@
+/*
+ Execution budgets.
+
+ A runaway script pins the thread that runs it, and under Node.js that is
+ the event loop. This replaces the runops loop with one that counts ops
+ and, every FUEL_CLOCK_INTERVAL ops, reads the WASI monotonic clock. Code
+ runs in slices: a slice ends after a number of ops, after an amount of
+ wall-clock time, or whichever comes first. The action when it ends is one
+ of:
+
+   die    croak with "Execution budget exhausted", which eval can catch.
+          A grace slice of 1/8 the size follows, so the handler and END
+          blocks get to run; if that runs out too, the interpreter exits
+          with status 255, which eval cannot catch. The next request
+          (zeroperl_fuel_refill) starts with a full slice again.
+   yield  unwind to asyncjmp_rt_start_yieldable with the Asyncify
+          machinery that setjmp/longjmp use. zeroperl_eval() then returns
+          -2 (ASYNCJMP_RT_YIELDED) to the host, which can run something
+          else and continue the request with zeroperl_resume()
+          (tools/snapshot.mjs does this). Under _start there is nobody to
+          return to, so the slice just restarts.
+
+ The per-op cost is one decrement and a branch; without a budget the
+ standard runops loop is kept. The profiler's loop takes precedence, so a
+ budget is ignored under ZEROPERL_PROF.
+
+ Environment:
+   ZEROPERL_FUEL=<ops>            ops per slice
+   ZEROPERL_TIMESLICE_MS=<ms>     wall-clock time per slice
+   ZEROPERL_FUEL_ACTION=yield     yield instead of dying
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "EXTERN.h"
+#include "perl.h"
+#include "asyncify.h"
+#include "setjmp.h"
+#include "fuel.h"
+
+// Ops between clock reads when only a time budget is set.
+#define FUEL_CLOCK_INTERVAL 1024
+// The grace slice after a die is the budget shifted right by this.
+#define FUEL_GRACE_SHIFT 3
+
+enum fuel_action
+{
+    FUEL_DIE = 0,
+    FUEL_YIELD = 1,
+};
+
+static uint32_t fuel_ops;
+static uint32_t fuel_ms;
+static int fuel_action;
+
+// The current slice, per thread in the wasi-threads build.
+static ASYNCJMP_THREAD_LOCAL int64_t fuel_left;
+static ASYNCJMP_THREAD_LOCAL int32_t fuel_chunk;
+static ASYNCJMP_THREAD_LOCAL int32_t fuel_tick;
+static ASYNCJMP_THREAD_LOCAL uint64_t fuel_deadline_ns;
+static ASYNCJMP_THREAD_LOCAL bool fuel_in_grace;
+
+static uint64_t fuel_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Ops until the next check: the rest of the op budget, at most
+// FUEL_CLOCK_INTERVAL when there is a deadline to watch.
+static void fuel_arm(void)
+{
+    int64_t chunk = fuel_ms ? FUEL_CLOCK_INTERVAL : INT32_MAX;
+    if (fuel_ops && fuel_left < chunk)
+    {
+        chunk = fuel_left > 0 ? fuel_left : 1;
+    }
+    fuel_chunk = fuel_tick = (int32_t)chunk;
+}
+
+static void fuel_slice(uint32_t ops, uint32_t ms)
+{
+    fuel_left = ops;
+    fuel_deadline_ns = ms ? fuel_now_ns() + (uint64_t)ms * 1000000u : 0;
+    fuel_arm();
+}
+
+void zeroperl_fuel_refill(void)
+{
+    fuel_in_grace = false;
+    fuel_slice(fuel_ops, fuel_ms);
+}
+
+static void fuel_check(pTHX)
+{
+    bool out;
+
+    fuel_left -= fuel_chunk - fuel_tick;
+    out = (fuel_ops && fuel_left <= 0) || (fuel_deadline_ns && fuel_now_ns() >= fuel_deadline_ns);
+    if (!out)
+    {
+        fuel_arm();
+        return;
+    }
+    if (fuel_action == FUEL_YIELD && asyncjmp_yield() == 0)
+    {
+        // Resumed: time spent suspended does not count.
+        zeroperl_fuel_refill();
+        return;
+    }
+    if (fuel_in_grace)
+    {
+        // The die was caught and the code kept going: stop it for good.
+        PerlIO_printf(PerlIO_stderr(), "Execution budget exhausted, exiting\n");
+        my_exit(255);
+    }
+    fuel_in_grace = true;
+    fuel_slice(fuel_ops ? (fuel_ops >> FUEL_GRACE_SHIFT) | 1 : 0,
+               fuel_ms ? (fuel_ms >> FUEL_GRACE_SHIFT) | 1 : 0);
+    Perl_croak(aTHX_ "Execution budget exhausted");
+}
+
+/* Same as Perl_runops_standard, plus the budget check between ops. */
+static int zeroperl_runops_fuel(pTHX)
+{
+    OP *op = PL_op;
+    while (op)
+    {
+        PL_op = op = op->op_ppaddr(aTHX);
+        if (--fuel_tick <= 0 && op)
+        {
+            fuel_check(aTHX);
+            op = PL_op;
+        }
+    }
+    PERL_ASYNC_CHECK();
+    TAINT_NOT;
+    return 0;
+}
+
+void zeroperl_fuel_init(pTHX)
+{
+    if (!fuel_ops && !fuel_ms)
+    {
+        return;
+    }
+    if (PL_runops == Perl_runops_standard)
+    {
+        PL_runops = zeroperl_runops_fuel;
+    }
+    zeroperl_fuel_refill();
+}
+
+/* Set the budget for interpreters created afterwards (zeroperl_init), and
+ * for the slices of those that already have one. 0 means no limit. */
+__attribute__((export_name("zeroperl_set_budget")))
+void zeroperl_set_budget(uint32_t ops, uint32_t ms, int yield)
+{
+    fuel_ops = ops;
+    fuel_ms = ms;
+    fuel_action = yield ? FUEL_YIELD : FUEL_DIE;
+}
+
+__attribute__((constructor)) static void zeroperl_fuel_env_init(void)
+{
+    const char *ops = getenv("ZEROPERL_FUEL");
+    const char *ms = getenv("ZEROPERL_TIMESLICE_MS");
+    const char *action = getenv("ZEROPERL_FUEL_ACTION");
+
+    zeroperl_set_budget(ops ? (uint32_t)strtoul(ops, NULL, 10) : 0,
+                        ms ? (uint32_t)strtoul(ms, NULL, 10) : 0,
+                        action && strcmp(action, "yield") == 0);
+}
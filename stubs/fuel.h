@@ -0,0 +1,14 @@
+#ifndef ZEROPERL_FUEL_H
+#define ZEROPERL_FUEL_H
+
+// Execution budgets, see fuel.c. Include after perl.h.
+
+// Install the budgeted runops loop if a budget was set through the
+// environment or zeroperl_set_budget(), and start the first slice. Call
+// between perl_construct() and perl_parse(), after zeroperl_prof_init().
+void zeroperl_fuel_init(pTHX);
+
+// Start a new slice, e.g. at the start of each request.
+void zeroperl_fuel_refill(void);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef ZEROPERL_LOCK_H
+#define ZEROPERL_LOCK_H
+
+// Mutexes for the wasi-threads build, where several interpreters share one
+// instance (see zeroperl.c). Every other build runs one thread per
+// instance, and these compile to nothing.
+#ifdef _REENTRANT
+#include <pthread.h>
+#define ZEROPERL_MUTEX(name) static pthread_mutex_t name = PTHREAD_MUTEX_INITIALIZER
+#define ZEROPERL_LOCK(name) pthread_mutex_lock(&(name))
+#define ZEROPERL_UNLOCK(name) pthread_mutex_unlock(&(name))
+#else
+#define ZEROPERL_MUTEX(name) struct zeroperl_unused_##name
+#define ZEROPERL_LOCK(name) ((void)0)
+#define ZEROPERL_UNLOCK(name) ((void)0)
+#endif
+
+#endif
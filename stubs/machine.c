@@ -20,12 +20,12 @@ static void init_asyncify_buf(struct asyncify_buf *buf)
     buf->end = &buf->buffer[WASM_SCAN_STACK_BUFFER_SIZE];
 }
 
-static void *_asyncjmp_active_scan_buf = NULL;
+static ASYNCJMP_THREAD_LOCAL void *_asyncjmp_active_scan_buf = NULL;
 
 void asyncjmp_scan_locals(asyncjmp_scan_func scan)
 {
-    static struct asyncify_buf buf;
-    static int spilling = 0;
+    static ASYNCJMP_THREAD_LOCAL struct asyncify_buf buf;
+    static ASYNCJMP_THREAD_LOCAL int spilling = 0;
     if (!spilling)
     {
         spilling = 1;
@@ -42,7 +42,7 @@ void asyncjmp_scan_locals(asyncjmp_scan_func scan)
     }
 }
 
-static void *asyncjmp_stack_base = NULL;
+static ASYNCJMP_THREAD_LOCAL void *asyncjmp_stack_base = NULL;
 
 __attribute__((constructor)) int asyncjmp_record_stack_base(void)
 {
@@ -11,6 +11,10 @@ void asyncjmp_scan_locals(asyncjmp_scan_func scan);
 // Get base address of userland C-stack memory space in WebAssembly. Used by conservative GC
 void *asyncjmp_stack_get_base(void);
 
+// Record the current stack pointer as the calling thread's stack base. Runs as a
+// constructor on the main thread; threads started later call it first thing
+int asyncjmp_record_stack_base(void);
+
 // Get the current stack pointer
 void *asyncjmp_get_stack_pointer(void);
 
@@ -0,0 +1,738 @@
+/*
+ Size-class slab allocator replacing wasi-libc's dlmalloc.
+
+ Linear memory can only grow, so whatever the allocator fragments is lost
+ for the lifetime of the instance. Perl's allocation pattern is dominated by
+ small, same-sized objects (SV bodies, HEs, ops, short PVs) mixed with a few
+ growing buffers, which is the worst case for a single general heap. This
+ allocator keeps the two apart:
+
+ 1. Small requests (<= 8 KiB) are rounded up to one of 32 size classes (four
+    per power of two) and carved out of 64 KiB slabs that hold a single class
+    each. A slab has a 64 byte header at its start and the page index tells
+    free() which slab a pointer belongs to, so objects carry no per-object
+    header. Slabs that become empty go back to a page pool shared by all
+    classes.
+ 2. Larger requests are served from separate arenas, in 4 KiB units, by a
+    boundary-tag allocator with segregated free lists and immediate
+    coalescing. Each block has a 16 byte header in front of the pointer.
+
+ Both come from 64 KiB aligned page runs obtained through sbrk() (see
+ snapshot.c). There is no locking: zeroperl runs one thread per instance,
+ and the wasi-threads build links wasi-libc's dlmalloc instead.
+
+ Statistics are available through zeroperl_malloc_get_stats(), and are
+ printed to stderr at exit when ZEROPERL_MALLOC_STATS is set.
+ */
+#include "malloc.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PAGE_SHIFT 16
+#define PAGE_SIZE ((size_t)1 << PAGE_SHIFT)
+#define PAGE_COUNT ((size_t)1 << (32 - PAGE_SHIFT))
+#define PAGE_INDEX(p) (((uintptr_t)(p) >> PAGE_SHIFT) & (PAGE_COUNT - 1))
+
+#define MIN_ALIGN 16
+
+#define SLAB_HEADER 64
+#define SLAB_MAGIC 0x5a50534cu /* "ZPSL" */
+#define SMALL_MAX 8192
+
+#define RUN_UNIT 4096
+#define RUN_HEADER 16
+#define RUN_MAGIC 0x5a505255u /* "ZPRU" */
+#define RUN_INUSE 1u
+#define RUN_PREV_INUSE 2u
+#define RUN_EXACT_BINS 32
+#define RUN_NBINS 48
+#define ARENA_MIN_PAGES 16
+
+enum
+{
+    PAGE_NONE = 0,
+    PAGE_SLAB = 1,
+    PAGE_RUN = 2
+};
+
+/* What each 64 KiB page of the 4 GiB address space is used for. */
+static uint8_t page_kind[PAGE_COUNT];
+
+static const uint16_t class_size[ZEROPERL_MALLOC_NCLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256, 320, 384, 448, 512,
+    640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192};
+
+typedef struct slab
+{
+    struct slab *next;
+    struct slab *prev;
+    void *free_list;   /* objects freed back into this slab */
+    uint32_t magic;
+    uint16_t cls;
+    uint16_t capacity;
+    uint16_t used;     /* live objects */
+    uint16_t carved;   /* objects handed out from the untouched tail so far */
+    uint8_t on_partial;
+} slab_t;
+
+typedef struct
+{
+    slab_t *partial;   /* slabs with at least one free object */
+    uint32_t slabs;
+    size_t live;
+} size_class_t;
+
+/* Boundary-tag block. Free blocks also carry free-list links after the
+   header and their size in the last four bytes. */
+typedef struct run
+{
+    uint32_t size;     /* bytes, header included, multiple of RUN_UNIT */
+    uint32_t flags;
+    uint32_t magic;
+    uint32_t offset;   /* pointer - block, read through ptr[-4] */
+    struct run *next_free;
+    struct run *prev_free;
+} run_t;
+
+static size_class_t classes[ZEROPERL_MALLOC_NCLASSES];
+static void *free_pages = NULL;
+static size_t free_page_count = 0;
+
+static run_t *run_bins[RUN_NBINS];
+static uint64_t run_bin_map = 0;
+static char *arena_end = NULL;
+
+static size_t stat_live = 0;
+static size_t stat_peak = 0;
+static size_t stat_committed = 0;
+static size_t stat_large_live = 0;
+static size_t stat_large_free = 0;
+
+static inline void stat_alloc(size_t bytes)
+{
+    stat_live += bytes;
+    if (stat_live > stat_peak)
+    {
+        stat_peak = stat_live;
+    }
+}
+
+/* -------------------------------------------------------------------------
+ * Pages
+ * ------------------------------------------------------------------------- */
+static void *pages_from_sbrk(size_t npages)
+{
+    uintptr_t cur = (uintptr_t)sbrk(0);
+    if (cur == (uintptr_t)-1)
+    {
+        return NULL;
+    }
+    size_t pad = (PAGE_SIZE - (cur & (PAGE_SIZE - 1))) & (PAGE_SIZE - 1);
+    if (npages > (INTPTR_MAX - pad) / PAGE_SIZE)
+    {
+        return NULL;
+    }
+    void *p = sbrk((intptr_t)(pad + npages * PAGE_SIZE));
+    if (p == (void *)-1)
+    {
+        return NULL;
+    }
+    stat_committed += npages * PAGE_SIZE;
+    return (char *)p + pad;
+}
+
+static void mark_pages(void *start, size_t npages, uint8_t kind)
+{
+    size_t first = PAGE_INDEX(start);
+    for (size_t i = 0; i < npages; i++)
+    {
+        page_kind[first + i] = kind;
+    }
+}
+
+/* -------------------------------------------------------------------------
+ * Small objects
+ * ------------------------------------------------------------------------- */
+static inline unsigned size_to_class(size_t size)
+{
+    if (size <= 128)
+    {
+        return size ? (unsigned)((size - 1) >> 4) : 0;
+    }
+    unsigned lg = 31 - (unsigned)__builtin_clz((unsigned)(size - 1));
+    unsigned idx = (unsigned)((size - 1) >> (lg - 2));
+    return 8 + (lg - 7) * 4 + (idx - 4);
+}
+
+static void partial_push(size_class_t *c, slab_t *s)
+{
+    s->prev = NULL;
+    s->next = c->partial;
+    if (c->partial)
+    {
+        c->partial->prev = s;
+    }
+    c->partial = s;
+    s->on_partial = 1;
+}
+
+static void partial_remove(size_class_t *c, slab_t *s)
+{
+    if (s->prev)
+    {
+        s->prev->next = s->next;
+    }
+    else
+    {
+        c->partial = s->next;
+    }
+    if (s->next)
+    {
+        s->next->prev = s->prev;
+    }
+    s->next = s->prev = NULL;
+    s->on_partial = 0;
+}
+
+static slab_t *slab_new(unsigned cls)
+{
+    void *page = free_pages;
+    if (page)
+    {
+        free_pages = *(void **)page;
+        free_page_count--;
+    }
+    else if (!(page = pages_from_sbrk(1)))
+    {
+        return NULL;
+    }
+    mark_pages(page, 1, PAGE_SLAB);
+
+    slab_t *s = page;
+    memset(s, 0, sizeof(*s));
+    s->magic = SLAB_MAGIC;
+    s->cls = (uint16_t)cls;
+    s->capacity = (uint16_t)((PAGE_SIZE - SLAB_HEADER) / class_size[cls]);
+    classes[cls].slabs++;
+    return s;
+}
+
+static void slab_release(size_class_t *c, slab_t *s)
+{
+    partial_remove(c, s);
+    c->slabs--;
+    mark_pages(s, 1, PAGE_NONE);
+    *(void **)s = free_pages;
+    free_pages = s;
+    free_page_count++;
+}
+
+static void *small_alloc(size_t size)
+{
+    unsigned cls = size_to_class(size);
+    size_class_t *c = &classes[cls];
+    slab_t *s = c->partial;
+    if (!s)
+    {
+        if (!(s = slab_new(cls)))
+        {
+            return NULL;
+        }
+        partial_push(c, s);
+    }
+
+    void *p;
+    if (s->free_list)
+    {
+        p = s->free_list;
+        s->free_list = *(void **)p;
+    }
+    else
+    {
+        p = (char *)s + SLAB_HEADER + (size_t)s->carved * class_size[cls];
+        s->carved++;
+    }
+
+    if (++s->used == s->capacity)
+    {
+        partial_remove(c, s);
+    }
+    c->live++;
+    stat_alloc(class_size[cls]);
+    return p;
+}
+
+static void small_free(slab_t *s, void *p)
+{
+    size_class_t *c = &classes[s->cls];
+    *(void **)p = s->free_list;
+    s->free_list = p;
+    s->used--;
+    c->live--;
+    stat_live -= class_size[s->cls];
+
+    if (!s->on_partial)
+    {
+        partial_push(c, s);
+    }
+    /* Keep one empty slab per class to avoid thrashing on alloc/free
+       cycles; give the rest back to the shared page pool. */
+    if (s->used == 0 && (s->next || s->prev))
+    {
+        slab_release(c, s);
+    }
+}
+
+/* -------------------------------------------------------------------------
+ * Large objects
+ * ------------------------------------------------------------------------- */
+static inline unsigned run_bin(size_t size)
+{
+    size_t units = size / RUN_UNIT;
+    if (units <= RUN_EXACT_BINS)
+    {
+        return (unsigned)units - 1;
+    }
+    unsigned bin = RUN_EXACT_BINS + (unsigned)(63 - __builtin_clzll((unsigned long long)(units - 1))) - 5;
+    return bin < RUN_NBINS ? bin : RUN_NBINS - 1;
+}
+
+static inline run_t *run_next(run_t *r)
+{
+    return (run_t *)((char *)r + r->size);
+}
+
+static void run_bin_insert(run_t *r)
+{
+    unsigned bin = run_bin(r->size);
+    r->prev_free = NULL;
+    r->next_free = run_bins[bin];
+    if (run_bins[bin])
+    {
+        run_bins[bin]->prev_free = r;
+    }
+    run_bins[bin] = r;
+    run_bin_map |= (uint64_t)1 << bin;
+    stat_large_free += r->size;
+}
+
+static void run_bin_remove(run_t *r)
+{
+    unsigned bin = run_bin(r->size);
+    if (r->prev_free)
+    {
+        r->prev_free->next_free = r->next_free;
+    }
+    else
+    {
+        run_bins[bin] = r->next_free;
+    }
+    if (r->next_free)
+    {
+        r->next_free->prev_free = r->prev_free;
+    }
+    if (!run_bins[bin])
+    {
+        run_bin_map &= ~((uint64_t)1 << bin);
+    }
+    stat_large_free -= r->size;
+}
+
+/* Turn r into a free block of the given size, merge it with free
+   neighbours and put it on its free list. */
+static void run_make_free(run_t *r, uint32_t size)
+{
+    r->size = size;
+    r->flags &= ~RUN_INUSE;
+    r->magic = RUN_MAGIC;
+
+    run_t *next = run_next(r);
+    if (!(next->flags & RUN_INUSE))
+    {
+        run_bin_remove(next);
+        r->size += next->size;
+        next = run_next(r);
+    }
+    if (!(r->flags & RUN_PREV_INUSE))
+    {
+        uint32_t prev_size = *((uint32_t *)r - 1);
+        run_t *prev = (run_t *)((char *)r - prev_size);
+        run_bin_remove(prev);
+        prev->size += r->size;
+        r = prev;
+    }
+
+    *(uint32_t *)((char *)r + r->size - sizeof(uint32_t)) = r->size;
+    next->flags &= ~RUN_PREV_INUSE;
+    run_bin_insert(r);
+}
+
+/* Shrink an in-use block to size, freeing the tail if it is at least
+   one unit. */
+static void run_trim(run_t *r, uint32_t size)
+{
+    if (r->size - size < RUN_UNIT)
+    {
+        return;
+    }
+    run_t *tail = (run_t *)((char *)r + size);
+    tail->flags = RUN_PREV_INUSE;
+    uint32_t tail_size = r->size - size;
+    r->size = size;
+    run_make_free(tail, tail_size);
+}
+
+/* Add npages of fresh memory to the large-object arenas. An arena ends with
+   a one-unit in-use sentinel so that coalescing never walks past it. When
+   new pages directly follow the previous arena, its sentinel becomes part
+   of the new free block instead. */
+static bool arena_grow(size_t npages)
+{
+    char *mem = pages_from_sbrk(npages);
+    if (!mem)
+    {
+        return false;
+    }
+    mark_pages(mem, npages, PAGE_RUN);
+
+    char *end = mem + npages * PAGE_SIZE;
+    run_t *block;
+    uint32_t flags;
+    if (mem == arena_end)
+    {
+        block = (run_t *)(mem - RUN_UNIT);
+        flags = block->flags & RUN_PREV_INUSE;
+    }
+    else
+    {
+        block = (run_t *)mem;
+        flags = RUN_PREV_INUSE;
+    }
+
+    run_t *sentinel = (run_t *)(end - RUN_UNIT);
+    sentinel->size = RUN_UNIT;
+    sentinel->flags = RUN_INUSE;
+    sentinel->magic = RUN_MAGIC;
+    sentinel->offset = 0;
+    arena_end = end;
+
+    block->flags = flags;
+    run_make_free(block, (uint32_t)((char *)sentinel - (char *)block));
+    return true;
+}
+
+static run_t *run_find(size_t size)
+{
+    for (unsigned bin = run_bin(size); bin < RUN_NBINS; bin++)
+    {
+        uint64_t avail = run_bin_map >> bin;
+        if (!avail)
+        {
+            return NULL;
+        }
+        bin += (unsigned)__builtin_ctzll(avail);
+        for (run_t *r = run_bins[bin]; r; r = r->next_free)
+        {
+            if (r->size >= size)
+            {
+                return r;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void *large_alloc(size_t size, size_t align)
+{
+    size_t extra = align > MIN_ALIGN ? align : 0;
+    if (size > UINT32_MAX - RUN_HEADER - extra - RUN_UNIT)
+    {
+        return NULL;
+    }
+    size_t need = (size + RUN_HEADER + extra + RUN_UNIT - 1) & ~(size_t)(RUN_UNIT - 1);
+
+    run_t *r = run_find(need);
+    if (!r)
+    {
+        size_t npages = (need + RUN_UNIT + PAGE_SIZE - 1) / PAGE_SIZE;
+        if (npages < ARENA_MIN_PAGES)
+        {
+            npages = ARENA_MIN_PAGES;
+        }
+        if (!arena_grow(npages) || !(r = run_find(need)))
+        {
+            return NULL;
+        }
+    }
+
+    run_bin_remove(r);
+    r->flags |= RUN_INUSE;
+    run_next(r)->flags |= RUN_PREV_INUSE;
+    run_trim(r, (uint32_t)need);
+
+    char *p = (char *)r + RUN_HEADER;
+    if (extra)
+    {
+        p = (char *)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+    }
+    r->offset = (uint32_t)(p - (char *)r);
+    *((uint32_t *)p - 1) = r->offset;
+
+    stat_large_live += r->size;
+    stat_alloc(r->size);
+    return p;
+}
+
+static run_t *run_of(void *p)
+{
+    run_t *r = (run_t *)((char *)p - *((uint32_t *)p - 1));
+    if (r->magic != RUN_MAGIC || !(r->flags & RUN_INUSE))
+    {
+        abort();
+    }
+    return r;
+}
+
+static void large_free(void *p)
+{
+    run_t *r = run_of(p);
+    stat_large_live -= r->size;
+    stat_live -= r->size;
+    run_make_free(r, r->size);
+}
+
+/* -------------------------------------------------------------------------
+ * Public interface
+ * ------------------------------------------------------------------------- */
+void *malloc(size_t size)
+{
+    void *p = size <= SMALL_MAX ? small_alloc(size) : large_alloc(size, MIN_ALIGN);
+    if (!p)
+    {
+        errno = ENOMEM;
+    }
+    return p;
+}
+
+void free(void *p)
+{
+    if (!p)
+    {
+        return;
+    }
+    switch (page_kind[PAGE_INDEX(p)])
+    {
+    case PAGE_SLAB:
+    {
+        slab_t *s = (slab_t *)((uintptr_t)p & ~(uintptr_t)(PAGE_SIZE - 1));
+        if (s->magic != SLAB_MAGIC)
+        {
+            abort();
+        }
+        small_free(s, p);
+        break;
+    }
+    case PAGE_RUN:
+        large_free(p);
+        break;
+    default:
+        /* Not a pointer we handed out. */
+        abort();
+    }
+}
+
+size_t malloc_usable_size(void *p)
+{
+    if (!p)
+    {
+        return 0;
+    }
+    if (page_kind[PAGE_INDEX(p)] == PAGE_SLAB)
+    {
+        slab_t *s = (slab_t *)((uintptr_t)p & ~(uintptr_t)(PAGE_SIZE - 1));
+        return class_size[s->cls];
+    }
+    run_t *r = run_of(p);
+    return r->size - ((char *)p - (char *)r);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    if (size && nmemb > SIZE_MAX / size)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    void *p = malloc(nmemb * size);
+    if (p)
+    {
+        memset(p, 0, nmemb * size);
+    }
+    return p;
+}
+
+void *realloc(void *p, size_t size)
+{
+    if (!p)
+    {
+        return malloc(size);
+    }
+    if (size == 0)
+    {
+        free(p);
+        return NULL;
+    }
+
+    if (page_kind[PAGE_INDEX(p)] == PAGE_RUN && size > SMALL_MAX)
+    {
+        run_t *r = run_of(p);
+        if (r->offset == RUN_HEADER && size <= UINT32_MAX - RUN_HEADER - RUN_UNIT)
+        {
+            uint32_t need = (uint32_t)((size + RUN_HEADER + RUN_UNIT - 1) & ~(size_t)(RUN_UNIT - 1));
+            uint32_t old = r->size;
+            run_t *next = run_next(r);
+            if (need > r->size && !(next->flags & RUN_INUSE) && r->size + next->size >= need)
+            {
+                /* Grow in place by absorbing the free block that follows. */
+                run_bin_remove(next);
+                r->size += next->size;
+                run_next(r)->flags |= RUN_PREV_INUSE;
+            }
+            if (need <= r->size)
+            {
+                run_trim(r, need);
+                stat_large_live += r->size;
+                stat_large_live -= old;
+                stat_live -= old;
+                stat_alloc(r->size);
+                return p;
+            }
+        }
+    }
+    else if (page_kind[PAGE_INDEX(p)] == PAGE_SLAB && size <= SMALL_MAX)
+    {
+        slab_t *s = (slab_t *)((uintptr_t)p & ~(uintptr_t)(PAGE_SIZE - 1));
+        if (size_to_class(size) == s->cls)
+        {
+            return p;
+        }
+    }
+
+    void *q = malloc(size);
+    if (!q)
+    {
+        return NULL;
+    }
+    size_t old_size = malloc_usable_size(p);
+    memcpy(q, p, old_size < size ? old_size : size);
+    free(p);
+    return q;
+}
+
+int posix_memalign(void **out, size_t align, size_t size)
+{
+    if (align < sizeof(void *) || (align & (align - 1)) || align > PAGE_SIZE / 2)
+    {
+        return EINVAL;
+    }
+    void *p = align <= MIN_ALIGN ? malloc(size) : large_alloc(size, align);
+    if (!p)
+    {
+        return ENOMEM;
+    }
+    *out = p;
+    return 0;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    void *p = NULL;
+    int rc = posix_memalign(&p, align < sizeof(void *) ? sizeof(void *) : align, size);
+    if (rc)
+    {
+        errno = rc;
+        return NULL;
+    }
+    return p;
+}
+
+void *memalign(size_t align, size_t size)
+{
+    return aligned_alloc(align, size);
+}
+
+/* wasi-libc's musl parts call these internally; defining them here keeps
+   dlmalloc.o out of the link. */
+void *__libc_malloc(size_t size) __attribute__((alias("malloc")));
+void __libc_free(void *p) __attribute__((alias("free")));
+void *__libc_calloc(size_t nmemb, size_t size) __attribute__((alias("calloc")));
+void *__libc_realloc(void *p, size_t size) __attribute__((alias("realloc")));
+
+/* -------------------------------------------------------------------------
+ * Statistics
+ * ------------------------------------------------------------------------- */
+void zeroperl_malloc_get_stats(struct zeroperl_malloc_stats *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->live_bytes = stat_live;
+    out->peak_bytes = stat_peak;
+    out->committed_bytes = stat_committed;
+    out->large_live_bytes = stat_large_live;
+    out->large_free_bytes = stat_large_free;
+    out->slab_bytes = free_page_count * PAGE_SIZE;
+    for (unsigned i = 0; i < ZEROPERL_MALLOC_NCLASSES; i++)
+    {
+        out->classes[i].size = class_size[i];
+        out->classes[i].slabs = classes[i].slabs;
+        out->classes[i].live_objects = classes[i].live;
+        out->classes[i].live_bytes = classes[i].live * class_size[i];
+        out->slab_bytes += (size_t)classes[i].slabs * PAGE_SIZE;
+    }
+    out->fragmentation = stat_committed ? 1.0 - (double)stat_live / (double)stat_committed : 0.0;
+}
+
+void zeroperl_malloc_report(int fd)
+{
+    struct zeroperl_malloc_stats st;
+    char line[160];
+    int n;
+
+    zeroperl_malloc_get_stats(&st);
+    n = snprintf(line, sizeof(line),
+                 "malloc: live %zu peak %zu committed %zu (slabs %zu, large live %zu free %zu) fragmentation %.1f%%\n",
+                 st.live_bytes, st.peak_bytes, st.committed_bytes, st.slab_bytes,
+                 st.large_live_bytes, st.large_free_bytes, st.fragmentation * 100.0);
+    write(fd, line, (size_t)n);
+    for (unsigned i = 0; i < ZEROPERL_MALLOC_NCLASSES; i++)
+    {
+        if (!st.classes[i].slabs)
+        {
+            continue;
+        }
+        n = snprintf(line, sizeof(line), "malloc: class %5u slabs %4u live %8zu objects %10zu bytes\n",
+                     (unsigned)st.classes[i].size, (unsigned)st.classes[i].slabs,
+                     st.classes[i].live_objects, st.classes[i].live_bytes);
+        write(fd, line, (size_t)n);
+    }
+}
+
+static void zeroperl_malloc_report_at_exit(void)
+{
+    zeroperl_malloc_report(STDERR_FILENO);
+}
+
+__attribute__((constructor)) static void zeroperl_malloc_init(void)
+{
+    const char *env = getenv("ZEROPERL_MALLOC_STATS");
+    if (env && *env && strcmp(env, "0") != 0)
+    {
+        atexit(zeroperl_malloc_report_at_exit);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef ZEROPERL_MALLOC_H
+#define ZEROPERL_MALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of small size classes served from slabs, see malloc.c.
+#define ZEROPERL_MALLOC_NCLASSES 32
+
+struct zeroperl_malloc_class_stats
+{
+    uint32_t size;         // object size of this class
+    uint32_t slabs;        // 64 KiB slabs currently owned by the class
+    size_t live_objects;   // objects handed out and not yet freed
+    size_t live_bytes;     // live_objects * size
+};
+
+struct zeroperl_malloc_stats
+{
+    size_t live_bytes;      // bytes in live allocations (rounded to class/run size)
+    size_t peak_bytes;      // high-water mark of live_bytes
+    size_t committed_bytes; // bytes obtained from sbrk, never returned
+    size_t slab_bytes;      // committed bytes held by slabs (including empty cached ones)
+    size_t large_live_bytes;
+    size_t large_free_bytes; // free space inside large-allocation arenas
+    // 1 - live / committed, i.e. how much of the grown memory is not in use.
+    double fragmentation;
+    struct zeroperl_malloc_class_stats classes[ZEROPERL_MALLOC_NCLASSES];
+};
+
+// Fill *out with the allocator's current counters.
+void zeroperl_malloc_get_stats(struct zeroperl_malloc_stats *out);
+
+// Write a human readable summary to fd. Also done at exit when
+// ZEROPERL_MALLOC_STATS is set in the environment.
+void zeroperl_malloc_report(int fd);
+
+#endif
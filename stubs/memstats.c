@@ -0,0 +1,178 @@
+/*
+ Memory accounting.
+
+ An instance is linked with a fixed C stack and initial memory, and grows
+ from there through malloc. This file reports where that memory goes, so
+ instances can be sized to real usage instead of over-provisioned:
+
+   - linear memory size (the high-water mark, as memory never shrinks) and
+     the static part below __heap_base
+   - malloc live and peak bytes (slab allocator only, see malloc.c)
+   - C stack high-water, measured down from asyncjmp_stack_get_base() (the
+     main thread's, in the wasi-threads build)
+   - the most Asyncify has spilled into one setjmp/longjmp buffer, against
+     the WASM_SETJMP_STACK_BUFFER_SIZE every jmp_buf reserves
+   - SFS files open now, at most and in total, and bytes read from them
+   - file data held by the tmpfs (tmpfs.c) now and at most, against its cap
+
+ The stack high-water needs the stack painted with a known byte at startup,
+ which costs a pass over the whole stack, so it is only measured when
+ ZEROPERL_MEMORY_STATS is set. That also prints a summary to stderr at exit.
+ Hosts can read the same figures at any time through the
+ zeroperl_memory_stats export.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "machine.h"
+#include "malloc.h"
+#include "setjmp.h"
+#include "memstats.h"
+#include "tmpfs.h"
+
+#define WASM_PAGE_SIZE 65536
+#define STACK_PAINT 0xa5
+// Left unpainted below the stack pointer at startup, for the frames the
+// painting itself runs in.
+#define STACK_PAINT_MARGIN 1024
+
+// Defined by wasm-ld.
+extern unsigned char __stack_low[];
+extern unsigned char __stack_high[];
+extern unsigned char __heap_base[];
+
+// Not linked into the dlmalloc build.
+extern void zeroperl_malloc_get_stats(struct zeroperl_malloc_stats *out) __attribute__((weak));
+
+static unsigned char *stack_painted_top;
+
+static uint32_t sfs_open;
+static uint32_t sfs_open_peak;
+static uint32_t sfs_opens;
+static uint64_t sfs_bytes_read;
+
+void zeroperl_memory_sfs_open(void)
+{
+    sfs_opens++;
+    if (++sfs_open > sfs_open_peak)
+    {
+        sfs_open_peak = sfs_open;
+    }
+}
+
+void zeroperl_memory_sfs_close(void)
+{
+    if (sfs_open)
+    {
+        sfs_open--;
+    }
+}
+
+void zeroperl_memory_sfs_read(size_t bytes)
+{
+    sfs_bytes_read += bytes;
+}
+
+// Lowest address the stack has reached: the first byte above __stack_low
+// that no longer holds the paint.
+static unsigned char *stack_low_water(void)
+{
+    unsigned char *p = __stack_low;
+    while (p < stack_painted_top && *p == STACK_PAINT)
+    {
+        p++;
+    }
+    return p;
+}
+
+void zeroperl_memory_get_stats(struct zeroperl_memory_stats *out)
+{
+    memset(out, 0, sizeof(*out));
+    // A full 4 GiB wasm32 memory reads as UINT32_MAX.
+    uint64_t memory = (uint64_t)__builtin_wasm_memory_size(0) * WASM_PAGE_SIZE;
+    out->memory_bytes = memory > UINT32_MAX ? UINT32_MAX : (uint32_t)memory;
+    out->static_bytes = (uint32_t)(uintptr_t)__heap_base;
+
+    if (zeroperl_malloc_get_stats)
+    {
+        struct zeroperl_malloc_stats st;
+        zeroperl_malloc_get_stats(&st);
+        out->malloc_live_bytes = (uint32_t)st.live_bytes;
+        out->malloc_peak_bytes = (uint32_t)st.peak_bytes;
+    }
+
+    out->stack_size = (uint32_t)(__stack_high - __stack_low);
+    if (stack_painted_top)
+    {
+        unsigned char *base = asyncjmp_stack_get_base();
+        out->stack_peak_bytes = (uint32_t)((base ? base : __stack_high) - stack_low_water());
+        out->stack_tracked = 1;
+    }
+
+    out->asyncify_peak_bytes = (uint32_t)asyncjmp_spill_high_water();
+    out->asyncify_buffer_size = WASM_SETJMP_STACK_BUFFER_SIZE;
+
+    out->sfs_open = sfs_open;
+    out->sfs_open_peak = sfs_open_peak;
+    out->sfs_opens = sfs_opens;
+    out->sfs_bytes_read = sfs_bytes_read;
+
+    size_t used, peak, limit;
+    zeroperl_tmpfs_usage(&used, &peak, &limit);
+    out->tmpfs_bytes = (uint32_t)used;
+    out->tmpfs_peak_bytes = (uint32_t)peak;
+    out->tmpfs_limit = (uint32_t)limit;
+}
+
+__attribute__((export_name("zeroperl_memory_stats")))
+const struct zeroperl_memory_stats *zeroperl_memory_stats(void)
+{
+    static struct zeroperl_memory_stats st;
+    zeroperl_memory_get_stats(&st);
+    return &st;
+}
+
+void zeroperl_memory_report(int fd)
+{
+    struct zeroperl_memory_stats st;
+    char line[200];
+    int n;
+
+    zeroperl_memory_get_stats(&st);
+    n = snprintf(line, sizeof(line), "memory: linear %u (static %u), malloc live %u peak %u\n",
+                 st.memory_bytes, st.static_bytes, st.malloc_live_bytes, st.malloc_peak_bytes);
+    write(fd, line, (size_t)n);
+    n = snprintf(line, sizeof(line), "memory: C stack peak %u of %u, asyncify spill peak %u of %u per jmp_buf\n",
+                 st.stack_peak_bytes, st.stack_size, st.asyncify_peak_bytes, st.asyncify_buffer_size);
+    write(fd, line, (size_t)n);
+    n = snprintf(line, sizeof(line), "memory: SFS %u open (peak %u), %u opened, %llu bytes read\n",
+                 st.sfs_open, st.sfs_open_peak, st.sfs_opens, (unsigned long long)st.sfs_bytes_read);
+    write(fd, line, (size_t)n);
+    if (st.tmpfs_limit)
+    {
+        n = snprintf(line, sizeof(line), "memory: tmpfs %u bytes (peak %u) of %u\n",
+                     st.tmpfs_bytes, st.tmpfs_peak_bytes, st.tmpfs_limit);
+        write(fd, line, (size_t)n);
+    }
+}
+
+static void zeroperl_memory_report_at_exit(void)
+{
+    zeroperl_memory_report(STDERR_FILENO);
+}
+
+__attribute__((constructor)) static void zeroperl_memory_init(void)
+{
+    const char *env = getenv("ZEROPERL_MEMORY_STATS");
+    if (env && *env && strcmp(env, "0") != 0)
+    {
+        unsigned char *sp = asyncjmp_get_stack_pointer();
+        if (sp - STACK_PAINT_MARGIN > __stack_low)
+        {
+            stack_painted_top = sp - STACK_PAINT_MARGIN;
+            memset(__stack_low, STACK_PAINT, (size_t)(stack_painted_top - __stack_low));
+        }
+        atexit(zeroperl_memory_report_at_exit);
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef ZEROPERL_MEMSTATS_H
+#define ZEROPERL_MEMSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Where an instance's linear memory goes, see memstats.c. The layout is
+// read directly by hosts through the zeroperl_memory_stats export
+// (tools/snapshot.mjs), so only append fields.
+struct zeroperl_memory_stats
+{
+    uint32_t memory_bytes;         // linear memory size; it never shrinks, so also the high-water mark
+    uint32_t static_bytes;         // data and C stack, below __heap_base
+    uint32_t malloc_live_bytes;    // 0 when linked with dlmalloc
+    uint32_t malloc_peak_bytes;
+    uint32_t stack_size;           // the C stack reserved at link time
+    uint32_t stack_peak_bytes;     // deepest C stack use below asyncjmp_stack_get_base(), 0 if not tracked
+    uint32_t asyncify_peak_bytes;  // most Asyncify has spilled into one setjmp/longjmp buffer
+    uint32_t asyncify_buffer_size; // size of that buffer in each jmp_buf
+    uint32_t sfs_open;             // SFS files open now...
+    uint32_t sfs_open_peak;        // ...at most at once...
+    uint32_t sfs_opens;            // ...and opened in total
+    uint32_t stack_tracked;        // 1 if ZEROPERL_MEMORY_STATS painted the stack at startup
+    uint64_t sfs_bytes_read;       // bytes read from SFS files through read()
+    uint32_t tmpfs_bytes;          // file data held by the tmpfs now...
+    uint32_t tmpfs_peak_bytes;     // ...at most...
+    uint32_t tmpfs_limit;          // ...and its ZEROPERL_TMPFS_SIZE, 0 if not mounted
+};
+
+// Fill *out with the current figures.
+void zeroperl_memory_get_stats(struct zeroperl_memory_stats *out);
+
+// Write a summary to fd. Also done at exit when ZEROPERL_MEMORY_STATS is
+// set in the environment.
+void zeroperl_memory_report(int fd);
+
+// SFS accounting, called from zeroperl.c.
+void zeroperl_memory_sfs_open(void);
+void zeroperl_memory_sfs_close(void);
+void zeroperl_memory_sfs_read(size_t bytes);
+
+#endif
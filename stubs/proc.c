@@ -0,0 +1,786 @@
+/*
+ Process emulation.
+
+ WASI has no processes, so system(), exec, backticks, pipe opens, fork,
+ pipe() and wait/waitpid used to fail outright. Here they ask the host to
+ start a child instead. The Node runner (tools/proc.mjs) answers by running
+ another zeroperl instance on a worker thread, so children run in parallel
+ with their parent, and hands back ring buffers wired to the child's stdin
+ or stdout as ordinary descriptors.
+
+ The host side is a single function, `request` in the "zeroperl_proc"
+ import module. It is not imported by this module: a host that has it puts
+ it in the exported function table and passes its index, with the protocol
+ version it speaks, to zeroperl_proc_attach() before running anything.
+ That is the feature check. Every WASI host still instantiates the module
+ unchanged, and on one that never attaches everything fails with ENOSYS as
+ before.
+
+ Requests are NUL-terminated fields, replies space-separated numbers, and a
+ negative first number is a negated errno:
+
+   spawn <inherit|pipe> <inherit|pipe> <argc> <arg>... <envc> <env>...
+       -> <pid> <stdin fd or -1> <stdout fd or -1>
+   fork <inherit|pipe> <inherit|pipe>
+       -> <pid> <stdin fd or -1> <stdout fd or -1>
+   pipe
+       -> <read fd> <write fd>
+   wait <pid or -1> <flags>
+       -> <pid or 0 for WNOHANG> <exit code>
+
+ fork is sent from an asyncjmp_rt_checkpoint(): main's stack has been
+ unwound into linear memory, and the host copies that memory into a fresh
+ instance and calls zeroperl_fork_child() there, which rewinds the same
+ stack. Both return from proc_fork(), the parent with the pid and the child
+ with 0. The child gets copies of the parent's pipes (from pipe(), pipe
+ opens and its own stdio), not of descriptors the parent opened on files.
+
+ Spawning only runs zeroperl itself (argv[0] of perl, zeroperl or $^X).
+ Commands with shell metacharacters are passed to /bin/sh, which it refuses.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "EXTERN.h"
+#include "perl.h"
+#include "lock.h"
+#include "setjmp.h"
+
+// Must match PROC_VERSION in tools/proc.mjs.
+#define ZEROPERL_PROC_VERSION 2
+#define PROC_REPLY_SIZE 64
+#define PROC_SHELL "/bin/sh"
+#define PROC_SHELL_METACHARS "$&*(){}[]'\";\\|?<>~`\n"
+
+#ifndef WNOHANG
+#define WNOHANG 1
+#endif
+// WNOHANG as the host knows it.
+#define PROC_WNOHANG 1
+
+extern char **environ;
+
+extern I32 __real_Perl_my_pclose(pTHX_ PerlIO *ptr);
+extern pid_t __real_getpid(void);
+
+// zeroperl_proc.request: writes at most `cap` bytes of reply and returns
+// their count, or a negated errno.
+typedef int (*proc_request_fn)(const char *req, size_t len, char *reply, size_t cap);
+
+// Set by zeroperl_proc_attach, NULL on hosts without process support.
+static proc_request_fn proc_request;
+
+// This instance's pid once it is a forked child, 0 before.
+static pid_t proc_self_pid;
+
+// Guards proc_pipes only. Requests to the host can block for as long as a
+// child runs (wait), so they are made without it.
+ZEROPERL_MUTEX(proc_lock);
+
+// Pipe opens waiting for my_pclose, by descriptor.
+static struct proc_pipe
+{
+    int fd;
+    int pid;
+} *proc_pipes;
+static int proc_npipes;
+static int proc_pipes_cap;
+
+// -----------------------------------------------------------------------------
+// Request buffer
+
+struct proc_req
+{
+    char *buf;
+    size_t len;
+    size_t cap;
+    bool failed;
+};
+
+static void req_add(struct proc_req *req, const char *field)
+{
+    size_t n = strlen(field) + 1;
+    if (req->failed)
+    {
+        return;
+    }
+    if (req->len + n > req->cap)
+    {
+        size_t cap = req->cap ? req->cap * 2 : 256;
+        char *buf;
+        while (cap < req->len + n)
+        {
+            cap *= 2;
+        }
+        buf = realloc(req->buf, cap);
+        if (!buf)
+        {
+            req->failed = true;
+            return;
+        }
+        req->buf = buf;
+        req->cap = cap;
+    }
+    memcpy(req->buf + req->len, field, n);
+    req->len += n;
+}
+
+static void req_add_int(struct proc_req *req, long value)
+{
+    char num[24];
+    snprintf(num, sizeof(num), "%ld", value);
+    req_add(req, num);
+}
+
+// Send a request and parse up to `max` numbers from the reply. Returns the
+// count parsed, or -1 with errno set.
+static int proc_call(const char *req, size_t len, long *out, int max)
+{
+    char reply[PROC_REPLY_SIZE];
+    char *p = reply;
+    int count = 0;
+    int n;
+
+    if (!proc_request)
+    {
+        // Not a host that runs children.
+        errno = ENOSYS;
+        return -1;
+    }
+    n = proc_request(req, len, reply, sizeof(reply) - 1);
+    if (n < 0)
+    {
+        errno = -n;
+        return -1;
+    }
+
+    reply[n] = '\0';
+    while (count < max && *p)
+    {
+        char *end;
+        out[count] = strtol(p, &end, 10);
+        if (end == p)
+        {
+            break;
+        }
+        count++;
+        p = end;
+    }
+    if (!count)
+    {
+        errno = EIO;
+        return -1;
+    }
+    if (out[0] < 0)
+    {
+        errno = (int)-out[0];
+        return -1;
+    }
+    return count;
+}
+
+// proc_call with a built request, which it frees.
+static int proc_exchange(struct proc_req *req, long *out, int max)
+{
+    int count;
+    int err;
+
+    if (req->failed)
+    {
+        free(req->buf);
+        errno = ENOMEM;
+        return -1;
+    }
+    count = proc_call(req->buf, req->len, out, max);
+    err = errno;
+    free(req->buf);
+    errno = err;
+    return count;
+}
+
+__attribute__((export_name("zeroperl_proc_attach")))
+int zeroperl_proc_attach(int version, uint32_t index)
+{
+    // A function pointer is its index in the function table.
+    if (version == ZEROPERL_PROC_VERSION)
+    {
+        proc_request = (proc_request_fn)(uintptr_t)index;
+    }
+    return ZEROPERL_PROC_VERSION;
+}
+
+// -----------------------------------------------------------------------------
+// spawn and wait
+
+// Start argv[0] (or `program`, if given) with argv. stdin_fd/stdout_fd,
+// when not NULL, ask for a pipe on that side and receive our end of it.
+static int proc_spawn(const char *program, int argc, const char *const *argv, int *stdin_fd, int *stdout_fd)
+{
+    struct proc_req req = {0};
+    long reply[3];
+    int envc = 0;
+
+    if (!program)
+    {
+        program = argv[0];
+    }
+    if (!argc || !program)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+    req_add(&req, "spawn");
+    req_add(&req, stdin_fd ? "pipe" : "inherit");
+    req_add(&req, stdout_fd ? "pipe" : "inherit");
+    req_add_int(&req, argc);
+    req_add(&req, program);
+    for (int i = 1; i < argc; i++)
+    {
+        req_add(&req, argv[i]);
+    }
+    while (environ && environ[envc])
+    {
+        envc++;
+    }
+    req_add_int(&req, envc);
+    for (int i = 0; i < envc; i++)
+    {
+        req_add(&req, environ[i]);
+    }
+
+    if (proc_exchange(&req, reply, 3) < 3)
+    {
+        return -1;
+    }
+    if (stdin_fd)
+    {
+        *stdin_fd = (int)reply[1];
+    }
+    if (stdout_fd)
+    {
+        *stdout_fd = (int)reply[2];
+    }
+    return (int)reply[0];
+}
+
+// Returns the pid reaped (0 if WNOHANG found none) and stores the exit code.
+static int proc_wait(int pid, int flags, int *code)
+{
+    struct proc_req req = {0};
+    long reply[2];
+
+    req_add(&req, "wait");
+    req_add_int(&req, pid);
+    req_add_int(&req, (flags & WNOHANG) ? PROC_WNOHANG : 0);
+    if (proc_exchange(&req, reply, 2) < 2)
+    {
+        return -1;
+    }
+    *code = (int)reply[1];
+    return (int)reply[0];
+}
+
+// Spawn with our stdio and wait. Returns a wait status.
+static int proc_run(const char *program, int argc, const char *const *argv)
+{
+    int code = 0;
+    int pid = proc_spawn(program, argc, argv, NULL, NULL);
+    if (pid < 0 || proc_wait(pid, 0, &code) < 0)
+    {
+        return -1;
+    }
+    return (code & 0xff) << 8;
+}
+
+// -----------------------------------------------------------------------------
+// fork and pipe
+
+// The fork in progress. Filled in before the checkpoint and by its reply, so
+// the copy the child starts from has only the request.
+static struct
+{
+    bool stdin_pipe;
+    bool stdout_pipe;
+    long reply[3];
+    int count;
+    int err;
+} proc_forking;
+
+// Runs with main unwound. Nothing may be locked here: the child would
+// start with the lock held.
+static void proc_fork_checkpoint(void)
+{
+    char req[32];
+    int len = snprintf(req, sizeof(req), "fork%c%s%c%s%c", 0, proc_forking.stdin_pipe ? "pipe" : "inherit", 0,
+                       proc_forking.stdout_pipe ? "pipe" : "inherit", 0);
+
+    proc_forking.count = proc_call(req, (size_t)len, proc_forking.reply, 3);
+    proc_forking.err = errno;
+}
+
+// Returns the child's pid in the parent and 0 in the child. stdin_fd and
+// stdout_fd work as in proc_spawn, for the parent.
+static int proc_fork(int *stdin_fd, int *stdout_fd)
+{
+    if (!proc_request)
+    {
+        errno = ENOSYS;
+        return -1;
+    }
+    proc_forking.stdin_pipe = stdin_fd != NULL;
+    proc_forking.stdout_pipe = stdout_fd != NULL;
+    proc_forking.count = 0;
+    proc_forking.err = EIO;
+    if (asyncjmp_rt_checkpoint(proc_fork_checkpoint) < 0)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (proc_forking.count == 1 && proc_forking.reply[0] == 0)
+    {
+        // zeroperl_fork_child() set this up.
+        return 0;
+    }
+    if (proc_forking.count < 3)
+    {
+        errno = proc_forking.err;
+        return -1;
+    }
+    if (stdin_fd)
+    {
+        *stdin_fd = (int)proc_forking.reply[1];
+    }
+    if (stdout_fd)
+    {
+        *stdout_fd = (int)proc_forking.reply[2];
+    }
+    return (int)proc_forking.reply[0];
+}
+
+// Entry point of a forked child, called by the host instead of _start once
+// it has copied in the parent's memory and attached. Finishes the parent's
+// main from its proc_fork() and exits as _start would.
+__attribute__((export_name("zeroperl_fork_child")))
+void zeroperl_fork_child(int pid)
+{
+    int status;
+
+    proc_self_pid = pid;
+    proc_forking.reply[0] = 0;
+    proc_forking.count = 1;
+    status = asyncjmp_rt_resume();
+    while (status == ASYNCJMP_RT_YIELDED)
+    {
+        status = asyncjmp_rt_resume();
+    }
+    exit(status);
+}
+
+pid_t __wrap_getpid(void)
+{
+    return proc_self_pid ? proc_self_pid : __real_getpid();
+}
+
+// Both ends are close-on-exec anyway: spawned children never inherit
+// descriptors, forked ones always do.
+int PerlProc_pipe_cloexec(int fds[2])
+{
+    long reply[2];
+    int count;
+
+    count = proc_call("pipe", sizeof("pipe"), reply, 2);
+    if (count < 2)
+    {
+        return -1;
+    }
+    fds[0] = (int)reply[0];
+    fds[1] = (int)reply[1];
+    return 0;
+}
+
+// What pp_fork does in a new child: $$ and the children to wait for are
+// the child's own.
+static void proc_forked(pTHX)
+{
+    GV *tmpgv = gv_fetchpvs("$", GV_ADD | GV_NOTQUAL, SVt_PV);
+    if (tmpgv)
+    {
+        SvREADONLY_off(GvSV(tmpgv));
+        sv_setiv(GvSV(tmpgv), (IV)getpid());
+        SvREADONLY_on(GvSV(tmpgv));
+    }
+#ifdef PERL_USES_PL_PIDSTATUS
+    hv_clear(PL_pidstatus);
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// Command strings
+
+// Split cmd into words the way Perl does without a shell, or hand it to
+// PROC_SHELL if it needs one. The words point into the copy returned in
+// *copy, which the caller frees along with *argv.
+static int proc_split(const char *cmd, char **copy, const char ***argv)
+{
+    int argc = 0;
+    char *s;
+
+    *copy = strdup(cmd);
+    *argv = calloc(strlen(cmd) / 2 + 4, sizeof(char *));
+    if (!*copy || !*argv)
+    {
+        free(*copy);
+        free(*argv);
+        errno = ENOMEM;
+        return -1;
+    }
+    if (strpbrk(cmd, PROC_SHELL_METACHARS))
+    {
+        (*argv)[argc++] = PROC_SHELL;
+        (*argv)[argc++] = "-c";
+        (*argv)[argc++] = *copy;
+        return argc;
+    }
+    for (s = *copy; *s;)
+    {
+        while (*s == ' ' || *s == '\t')
+        {
+            *s++ = '\0';
+        }
+        if (!*s)
+        {
+            break;
+        }
+        (*argv)[argc++] = s;
+        while (*s && *s != ' ' && *s != '\t')
+        {
+            s++;
+        }
+    }
+    return argc;
+}
+
+// -----------------------------------------------------------------------------
+// Entry points. With fork undefined, pp_system calls do_aspawn/do_spawn
+// (without a context argument) and pp_exec ends up in execvp. pp_fork and
+// pp_pipe_op die as unsupported, so they are wrapped instead.
+
+int do_aspawn(SV *really, SV **mark, SV **sp)
+{
+    dTHX;
+    const char **argv;
+    int argc = 0;
+    int status;
+
+    argv = calloc((size_t)(sp - mark) + 1, sizeof(char *));
+    if (!argv)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    while (++mark <= sp)
+    {
+        argv[argc++] = *mark ? SvPV_nolen(*mark) : "";
+    }
+    status = proc_run(really ? SvPV_nolen(really) : NULL, argc, argv);
+    free(argv);
+    return status;
+}
+
+int do_spawn(char *cmd)
+{
+    char *copy;
+    const char **argv;
+    int argc = proc_split(cmd, &copy, &argv);
+    int status;
+
+    if (argc < 0)
+    {
+        return -1;
+    }
+    status = proc_run(NULL, argc, argv);
+    free(copy);
+    free(argv);
+    return status;
+}
+
+// There is no replacing the running instance, so run the program and exit
+// with its status, which is what the caller observes either way.
+int execv(const char *path, char *const argv[])
+{
+    int argc = 0;
+    int status;
+
+    while (argv[argc])
+    {
+        argc++;
+    }
+    status = proc_run(path, argc, (const char *const *)argv);
+    if (status < 0)
+    {
+        return -1;
+    }
+    _Exit(status >> 8);
+}
+
+int execvp(const char *file, char *const argv[])
+{
+    return execv(file, argv);
+}
+
+OP *__wrap_Perl_pp_fork(pTHX)
+{
+    dSP;
+    dTARGET;
+    int pid;
+
+    EXTEND(SP, 1);
+    PERL_FLUSHALL_FOR_CHILD;
+    pid = proc_fork(NULL, NULL);
+    if (pid < 0)
+    {
+        RETPUSHUNDEF;
+    }
+    if (pid == 0)
+    {
+        proc_forked(aTHX);
+    }
+    PUSHi(pid);
+    RETURN;
+}
+
+OP *__wrap_Perl_pp_pipe_op(pTHX)
+{
+    dSP;
+    int fds[2];
+    GV *const wgv = MUTABLE_GV(POPs);
+    GV *const rgv = MUTABLE_GV(POPs);
+    IO *const rstio = GvIOn(rgv);
+    IO *const wstio = GvIOn(wgv);
+
+    if (IoIFP(rstio))
+    {
+        do_close(rgv, FALSE);
+    }
+    if (IoIFP(wstio))
+    {
+        do_close(wgv, FALSE);
+    }
+    if (PerlProc_pipe_cloexec(fds) < 0)
+    {
+        RETPUSHUNDEF;
+    }
+    IoIFP(rstio) = PerlIO_fdopen(fds[0], "r");
+    IoOFP(wstio) = PerlIO_fdopen(fds[1], "w");
+    IoOFP(rstio) = IoIFP(rstio);
+    IoIFP(wstio) = IoOFP(wstio);
+    IoTYPE(rstio) = IoTYPE_RDONLY;
+    IoTYPE(wstio) = IoTYPE_WRONLY;
+    if (!IoIFP(rstio) || !IoOFP(wstio))
+    {
+        if (IoIFP(rstio))
+        {
+            PerlIO_close(IoIFP(rstio));
+        }
+        else
+        {
+            close(fds[0]);
+        }
+        if (IoOFP(wstio))
+        {
+            PerlIO_close(IoOFP(wstio));
+        }
+        else
+        {
+            close(fds[1]);
+        }
+        RETPUSHUNDEF;
+    }
+    RETPUSHYES;
+}
+
+// -----------------------------------------------------------------------------
+// Pipe opens
+
+// Remember the pipe open on `fd` for my_pclose. Returns false with errno
+// set if the table cannot grow.
+static bool proc_pipes_add(int fd, int pid)
+{
+    bool added = true;
+
+    ZEROPERL_LOCK(proc_lock);
+    if (proc_npipes == proc_pipes_cap)
+    {
+        int cap = proc_pipes_cap ? proc_pipes_cap * 2 : 8;
+        struct proc_pipe *pipes = realloc(proc_pipes, (size_t)cap * sizeof(*pipes));
+        if (pipes)
+        {
+            proc_pipes = pipes;
+            proc_pipes_cap = cap;
+        }
+        else
+        {
+            added = false;
+        }
+    }
+    if (added)
+    {
+        proc_pipes[proc_npipes].fd = fd;
+        proc_pipes[proc_npipes].pid = pid;
+        proc_npipes++;
+    }
+    ZEROPERL_UNLOCK(proc_lock);
+    if (!added)
+    {
+        errno = ENOMEM;
+    }
+    return added;
+}
+
+// Open our end of a pipe to child `pid` and remember it for my_pclose.
+static PerlIO *proc_track(pTHX_ int fd, int pid, const char *mode)
+{
+    PerlIO *f = PerlIO_fdopen(fd, mode);
+    int code;
+    int err;
+
+    if (!f)
+    {
+        err = errno;
+        close(fd);
+        proc_wait(pid, 0, &code);
+        errno = err;
+        return NULL;
+    }
+    if (!proc_pipes_add(fd, pid))
+    {
+        // Untracked, my_pclose could not wait for the child: undo the open.
+        PerlIO_close(f);
+        proc_wait(pid, 0, &code);
+        errno = ENOMEM;
+        return NULL;
+    }
+    PL_forkprocess = pid;
+    return f;
+}
+
+static PerlIO *proc_popen(pTHX_ const char *mode, int argc, const char *const *argv)
+{
+    bool reading = *mode == 'r';
+    int fd = -1;
+    int pid;
+
+    if (argc == 1 && strEQ(argv[0], "-"))
+    {
+        // Implicit fork: the child's end is already its stdout (or stdin).
+        PerlIO_flush((PerlIO *)NULL);
+        pid = proc_fork(reading ? NULL : &fd, reading ? &fd : NULL);
+        if (pid == 0)
+        {
+            proc_forked(aTHX);
+            PL_forkprocess = 0;
+            return NULL;
+        }
+    }
+    else
+    {
+        PerlIO_flush((PerlIO *)NULL);
+        pid = proc_spawn(NULL, argc, argv, reading ? NULL : &fd, reading ? &fd : NULL);
+    }
+    if (pid < 0)
+    {
+        return NULL;
+    }
+    return proc_track(aTHX_ fd, pid, mode);
+}
+
+PerlIO *__wrap_Perl_my_popen(pTHX_ const char *cmd, const char *mode)
+{
+    char *copy;
+    const char **argv;
+    int argc;
+    PerlIO *f;
+
+    argc = proc_split(cmd, &copy, &argv);
+    if (argc < 0)
+    {
+        return NULL;
+    }
+    f = proc_popen(aTHX_ mode, argc, argv);
+    free(copy);
+    free(argv);
+    return f;
+}
+
+PerlIO *__wrap_Perl_my_popen_list(pTHX_ const char *mode, int n, SV **args)
+{
+    const char **argv = calloc((size_t)n + 1, sizeof(char *));
+    PerlIO *f;
+
+    if (!argv)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        argv[i] = SvPV_nolen(args[i]);
+    }
+    f = proc_popen(aTHX_ mode, n, argv);
+    free(argv);
+    return f;
+}
+
+I32 __wrap_Perl_my_pclose(pTHX_ PerlIO *ptr)
+{
+    int fd = PerlIO_fileno(ptr);
+    int pid = -1;
+    int code = 0;
+
+    ZEROPERL_LOCK(proc_lock);
+    for (int i = 0; i < proc_npipes; i++)
+    {
+        if (proc_pipes[i].fd == fd)
+        {
+            pid = proc_pipes[i].pid;
+            proc_pipes[i] = proc_pipes[--proc_npipes];
+            break;
+        }
+    }
+    ZEROPERL_UNLOCK(proc_lock);
+    if (pid < 0)
+    {
+        return __real_Perl_my_pclose(aTHX_ ptr);
+    }
+
+    // Closing our end first lets a child blocked on the pipe finish.
+    PerlIO_close(ptr);
+    if (proc_wait(pid, 0, &code) < 0)
+    {
+        return -1;
+    }
+    return (code & 0xff) << 8;
+}
+
+I32 __wrap_Perl_wait4pid(pTHX_ Pid_t pid, int *statusp, int flags)
+{
+    int code = 0;
+    int reaped;
+
+    PERL_UNUSED_CONTEXT;
+    if (pid == 0 || pid < -1)
+    {
+        // No process groups.
+        errno = EINVAL;
+        return -1;
+    }
+    reaped = proc_wait(pid, flags, &code);
+    if (reaped > 0)
+    {
+        *statusp = (code & 0xff) << 8;
+    }
+    return reaped;
+}
@@ -0,0 +1,346 @@
+/*
+ Sampling op-level profiler.
+
+ zeroperl has no perf, no Devel::NYTProf and no symbols, so this replaces the
+ runops loop with one that keeps an exact count per op type and, every
+ ZEROPERL_PROF_PERIOD ops, takes a sample: the Perl call stack (subs, string
+ evals and requires), the current file:line and the op about to run. The
+ wall time since the previous sample, read from the WASI monotonic clock, is
+ attributed to that stack. The per-op cost is one increment and one
+ decrement, and the clock is only read when a sample is taken, so the mode
+ is cheap enough to enable for a sampled fraction of production runs.
+
+ Environment:
+   ZEROPERL_PROF=<path>          enable, write collapsed stacks to <path>
+                                 ("-" for stderr) and op counts to <path>.ops
+   ZEROPERL_PROF_PERIOD=<ops>    ops between samples (default 1009)
+
+ The stacks file uses the collapsed format understood by flamegraph.pl and
+ speedscope: "frame;frame;frame <microseconds>" per line.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "EXTERN.h"
+#include "perl.h"
+#include "profile.h"
+
+#ifndef ZEROPERL_PROF_DEFAULT_PERIOD
+#define ZEROPERL_PROF_DEFAULT_PERIOD 1009
+#endif
+
+#ifndef ZEROPERL_PROF_MAX_STACK
+#define ZEROPERL_PROF_MAX_STACK 2048
+#endif
+
+typedef struct
+{
+    uint32_t hash;
+    uint32_t samples;
+    uint64_t usec;
+    char *key;
+} prof_entry;
+
+static const char *prof_path = NULL;
+static uint32_t prof_period = ZEROPERL_PROF_DEFAULT_PERIOD;
+static uint32_t prof_countdown = ZEROPERL_PROF_DEFAULT_PERIOD;
+static uint64_t prof_last_ns = 0;
+
+static uint64_t prof_op_count[OP_max];
+static uint64_t prof_op_usec[OP_max];
+
+static prof_entry *prof_table = NULL;
+static size_t prof_table_cap = 0;
+static size_t prof_table_used = 0;
+
+static uint64_t prof_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/* FNV-1a, good enough to spread stack strings over the table. */
+static uint32_t prof_hash(const char *s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+static bool prof_table_grow(void)
+{
+    size_t cap = prof_table_cap ? prof_table_cap * 2 : 1024;
+    prof_entry *table = calloc(cap, sizeof(prof_entry));
+    if (!table)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < prof_table_cap; i++)
+    {
+        prof_entry *e = &prof_table[i];
+        if (!e->key)
+        {
+            continue;
+        }
+        size_t j = e->hash & (cap - 1);
+        while (table[j].key)
+        {
+            j = (j + 1) & (cap - 1);
+        }
+        table[j] = *e;
+    }
+    free(prof_table);
+    prof_table = table;
+    prof_table_cap = cap;
+    return true;
+}
+
+static void prof_record(const char *key, size_t len, uint64_t usec)
+{
+    if (prof_table_used * 10 >= prof_table_cap * 7 && !prof_table_grow())
+    {
+        return;
+    }
+
+    uint32_t h = prof_hash(key, len);
+    size_t j = h & (prof_table_cap - 1);
+    while (prof_table[j].key)
+    {
+        prof_entry *e = &prof_table[j];
+        if (e->hash == h && strncmp(e->key, key, len) == 0 && e->key[len] == '\0')
+        {
+            e->samples++;
+            e->usec += usec;
+            return;
+        }
+        j = (j + 1) & (prof_table_cap - 1);
+    }
+
+    char *copy = malloc(len + 1);
+    if (!copy)
+    {
+        return;
+    }
+    memcpy(copy, key, len);
+    copy[len] = '\0';
+    prof_table[j].hash = h;
+    prof_table[j].samples = 1;
+    prof_table[j].usec = usec;
+    prof_table[j].key = copy;
+    prof_table_used++;
+}
+
+/* Append a frame to the stack buffer. ';' and ' ' are the separators of the
+   collapsed format, so they are replaced inside frame names. */
+static size_t prof_append(char *buf, size_t pos, const char *s, size_t len)
+{
+    if (pos > 0 && pos < ZEROPERL_PROF_MAX_STACK - 1)
+    {
+        buf[pos++] = ';';
+    }
+    for (size_t i = 0; i < len && pos < ZEROPERL_PROF_MAX_STACK - 1; i++)
+    {
+        char c = s[i];
+        buf[pos++] = (c == ';' || c == ' ' || c == '\n') ? '_' : c;
+    }
+    return pos;
+}
+
+static size_t prof_append_cx(pTHX_ char *buf, size_t pos, const PERL_CONTEXT *cx)
+{
+    char frame[256];
+    int n;
+
+    switch (CxTYPE(cx))
+    {
+    case CXt_SUB:
+    case CXt_FORMAT:
+    {
+        const GV *gv = CvGV(cx->blk_sub.cv);
+        const HV *stash = gv ? GvSTASH(gv) : NULL;
+        const char *pkg = stash ? HvNAME(stash) : NULL;
+        n = snprintf(frame, sizeof(frame), "%s::%s", pkg ? pkg : "main", gv ? GvNAME(gv) : "__ANON__");
+        break;
+    }
+    case CXt_EVAL:
+        if (CxTRYBLOCK(cx))
+        {
+            return pos; /* eval {} blocks are not interesting frames */
+        }
+        if (CxOLD_OP_TYPE(cx) == OP_REQUIRE && cx->blk_eval.old_namesv)
+        {
+            n = snprintf(frame, sizeof(frame), "require %s", SvPV_nolen(cx->blk_eval.old_namesv));
+        }
+        else
+        {
+            n = snprintf(frame, sizeof(frame), "(eval)");
+        }
+        break;
+    default:
+        return pos;
+    }
+
+    if (n < 0)
+    {
+        return pos;
+    }
+    return prof_append(buf, pos, frame, (size_t)n < sizeof(frame) ? (size_t)n : sizeof(frame) - 1);
+}
+
+static void prof_sample(pTHX_ const OP *op)
+{
+    char buf[ZEROPERL_PROF_MAX_STACK];
+    char frame[256];
+    const PERL_SI *chain[64];
+    int depth = 0;
+    size_t pos = 0;
+    int n;
+
+    uint64_t now = prof_now_ns();
+    uint64_t usec = (now - prof_last_ns) / 1000;
+    prof_last_ns = now;
+    if (usec == 0)
+    {
+        usec = 1;
+    }
+    prof_op_usec[op->op_type] += usec;
+
+    /* Nested stackinfos (sort blocks, tie and overload callbacks, DESTROY)
+       each have their own context stack; walk them oldest first. */
+    for (const PERL_SI *si = PL_curstackinfo; si && depth < 64; si = si->si_prev)
+    {
+        chain[depth++] = si;
+    }
+
+    pos = prof_append(buf, pos, "main", 4);
+    while (depth-- > 0)
+    {
+        const PERL_SI *si = chain[depth];
+        for (I32 i = 0; i <= si->si_cxix; i++)
+        {
+            pos = prof_append_cx(aTHX_ buf, pos, &si->si_cxstack[i]);
+        }
+    }
+
+    if (PL_curcop)
+    {
+        const char *file = CopFILE(PL_curcop);
+        n = snprintf(frame, sizeof(frame), "%s:%u", file ? file : "-", (unsigned)CopLINE(PL_curcop));
+        if (n > 0)
+        {
+            pos = prof_append(buf, pos, frame, (size_t)n < sizeof(frame) ? (size_t)n : sizeof(frame) - 1);
+        }
+    }
+
+    n = snprintf(frame, sizeof(frame), "[%s]", PL_op_name[op->op_type]);
+    if (n > 0)
+    {
+        pos = prof_append(buf, pos, frame, (size_t)n < sizeof(frame) ? (size_t)n : sizeof(frame) - 1);
+    }
+
+    prof_record(buf, pos, usec);
+}
+
+/* Same as Perl_runops_standard, plus the op counter and the sample check. */
+static int zeroperl_runops_prof(pTHX)
+{
+    OP *op = PL_op;
+    while (op)
+    {
+        prof_op_count[op->op_type]++;
+        if (--prof_countdown == 0)
+        {
+            prof_countdown = prof_period;
+            prof_sample(aTHX_ op);
+        }
+        PL_op = op = op->op_ppaddr(aTHX);
+    }
+    PERL_ASYNC_CHECK();
+    TAINT_NOT;
+    return 0;
+}
+
+void zeroperl_prof_init(pTHX)
+{
+    const char *path = getenv("ZEROPERL_PROF");
+    if (!path || !*path)
+    {
+        return;
+    }
+
+    const char *period = getenv("ZEROPERL_PROF_PERIOD");
+    if (period && atoi(period) > 0)
+    {
+        prof_period = (uint32_t)atoi(period);
+    }
+    prof_countdown = prof_period;
+    prof_path = path;
+    prof_last_ns = prof_now_ns();
+    PL_runops = zeroperl_runops_prof;
+}
+
+void zeroperl_prof_finish(pTHX)
+{
+    if (!prof_path)
+    {
+        return;
+    }
+    PL_runops = Perl_runops_standard;
+
+    bool to_stderr = strcmp(prof_path, "-") == 0;
+    FILE *fp = to_stderr ? stderr : fopen(prof_path, "w");
+    if (fp)
+    {
+        for (size_t i = 0; i < prof_table_cap; i++)
+        {
+            if (prof_table[i].key)
+            {
+                fprintf(fp, "%s %llu\n", prof_table[i].key, (unsigned long long)prof_table[i].usec);
+            }
+        }
+        if (!to_stderr)
+        {
+            fclose(fp);
+        }
+    }
+
+    /* Exact op counts and sampled time per op type. */
+    FILE *ops = to_stderr ? stderr : NULL;
+    if (!to_stderr)
+    {
+        char path[512];
+        snprintf(path, sizeof(path), "%s.ops", prof_path);
+        ops = fopen(path, "w");
+    }
+    if (ops)
+    {
+        for (int i = 0; i < OP_max; i++)
+        {
+            if (prof_op_count[i])
+            {
+                fprintf(ops, "%s\t%llu\t%llu\n", PL_op_name[i],
+                        (unsigned long long)prof_op_count[i],
+                        (unsigned long long)prof_op_usec[i]);
+            }
+        }
+        if (!to_stderr)
+        {
+            fclose(ops);
+        }
+    }
+
+    for (size_t i = 0; i < prof_table_cap; i++)
+    {
+        free(prof_table[i].key);
+    }
+    free(prof_table);
+    prof_table = NULL;
+    prof_table_cap = prof_table_used = 0;
+    prof_path = NULL;
+}
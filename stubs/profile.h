@@ -0,0 +1,15 @@
+#ifndef ZEROPERL_PROFILE_H
+#define ZEROPERL_PROFILE_H
+
+// Sampling op-level profiler, see profile.c. Include after perl.h.
+
+// Install the profiling runops loop if ZEROPERL_PROF is set in the
+// environment. Call between perl_construct() and perl_parse() so that BEGIN
+// blocks and module loading are profiled too.
+void zeroperl_prof_init(pTHX);
+
+// Write the collected collapsed stacks and op counts. Call after perl_run()
+// and before perl_destruct(). Does nothing if profiling is not enabled.
+void zeroperl_prof_finish(pTHX);
+
+#endif
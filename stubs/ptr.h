@@ -0,0 +1,12 @@
+#ifndef ASYNCJMP_SUPPORT_PTR_H
+#define ASYNCJMP_SUPPORT_PTR_H
+
+// The wasm value type of a pointer, for the hand-written .S files: i64
+// under memory64 (wasm64), where __stack_pointer is an i64 global too.
+#ifdef __wasm64__
+#define PTR i64
+#else
+#define PTR i32
+#endif
+
+#endif
@@ -0,0 +1,532 @@
+/*
+ Read-ahead block cache for host files.
+
+ Outside the SFS and the tmpfs, every read() and lseek() is a WASI host
+ call, and with an asynchronous fd_read every read is an Asyncify unwind
+ and rewind as well. PerlIO drops its buffer on every seek, so code that
+ seeks around a file and reads a few bytes at each stop, as ExifTool does
+ in image files, pays for two host calls per stop.
+
+ With ZEROPERL_READAHEAD set, host files opened read-only get a small cache
+ of fixed-size blocks per descriptor:
+   - lseek() only moves an offset kept here. SEEK_END asks the host for the
+     size with fstat(), SEEK_DATA and SEEK_HOLE go to the host.
+   - read() copies from cached blocks and fills missing ones with a single
+     preadv(), which leaves the host's own offset alone.
+   - A miss on the block right after the previous fill is sequential
+     access, and that fill reads twice as many blocks as the one before,
+     up to half the cache. Any other miss reads one block.
+   - A read of a block or more that starts on an uncached block goes
+     straight into the caller's buffer.
+   - The block holding the end of the file is read again once a read
+     starts past the bytes it had, so a file that grows is seen growing.
+ read() and lseek() return what the host would for a file that nobody else
+ writes to. dup(), dup2() and fcntl(F_DUPFD) give a descriptor that shares
+ the host's offset, so once one succeeds that offset is moved to where the
+ cache's is and the original is no longer cached. A write, pwrite, ftruncate or truncate of a host file through
+ the wrappers drops every cached block; a change made by another process
+ is only seen once the block is filled again. A descriptor that turns out
+ not to be a regular file is dropped on its first read or seek, before
+ anything has been answered for it.
+
+ Fills use fd_pread, which is not an Asyncify import: a host that answers
+ file reads asynchronously should leave ZEROPERL_READAHEAD unset.
+
+ ZEROPERL_READAHEAD is the block size, with k and m suffixes; 1 means the
+ default of 64k. ZEROPERL_READAHEAD_BLOCKS is the number of blocks per
+ file (default 8), and ZEROPERL_READAHEAD_STATS=1 prints the counters to
+ stderr at exit.
+ */
+#include "readahead.h"
+#include "lock.h"
+#include "size.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define RA_DEFAULT_BLOCK (64 * 1024)
+#define RA_MIN_BLOCK 512
+#define RA_MAX_BLOCK (16 * 1024 * 1024)
+#define RA_DEFAULT_BLOCKS 8
+#define RA_MAX_BLOCKS 64
+
+extern int __real_fstat(int fd, struct stat *st);
+extern off_t __real_lseek(int fd, off_t offset, int whence);
+
+struct ra_block
+{
+    off_t index;   // block number in the file, -1 if empty
+    size_t len;    // bytes held, short only for the block at end of file
+    uint64_t used; // last use, for LRU replacement
+    char *data;    // block_size bytes, allocated on first fill
+};
+
+struct ra_file
+{
+    off_t pos;
+    bool checked;        // fstat() said it is a regular file
+    uint32_t generation; // of the cached blocks
+    off_t next_index;    // the block after the last fill
+    size_t window;       // blocks the last fill read
+    struct ra_block blocks[];
+};
+
+bool zeroperl_readahead_on;
+
+static size_t block_size = RA_DEFAULT_BLOCK;
+static size_t nblocks = RA_DEFAULT_BLOCKS;
+static struct ra_file *files[ZEROPERL_READAHEAD_FDS];
+static uint32_t generation;
+static uint64_t tick;
+static struct zeroperl_readahead_stats stats;
+
+ZEROPERL_MUTEX(readahead_lock);
+
+static void drop_blocks(struct ra_file *f)
+{
+    for (size_t i = 0; i < nblocks; i++)
+    {
+        f->blocks[i].index = -1;
+    }
+    f->next_index = -1;
+    f->window = 0;
+    f->generation = generation;
+}
+
+static void release(int fd)
+{
+    struct ra_file *f = files[fd];
+    files[fd] = NULL;
+    for (size_t i = 0; i < nblocks; i++)
+    {
+        free(f->blocks[i].data);
+    }
+    free(f);
+}
+
+void zeroperl_readahead_open(int fd)
+{
+    if (!zeroperl_readahead_on || fd < 0 || fd >= ZEROPERL_READAHEAD_FDS)
+    {
+        return;
+    }
+    ZEROPERL_LOCK(readahead_lock);
+    if (files[fd])
+    {
+        // Closed behind our back, e.g. by libc.
+        release(fd);
+    }
+    struct ra_file *f = calloc(1, sizeof(*f) + nblocks * sizeof(struct ra_block));
+    if (f)
+    {
+        drop_blocks(f);
+        files[fd] = f;
+        stats.files++;
+    }
+    ZEROPERL_UNLOCK(readahead_lock);
+}
+
+void zeroperl_readahead_close(int fd)
+{
+    if (!zeroperl_readahead_on || fd < 0 || fd >= ZEROPERL_READAHEAD_FDS)
+    {
+        return;
+    }
+    ZEROPERL_LOCK(readahead_lock);
+    if (files[fd])
+    {
+        release(fd);
+    }
+    ZEROPERL_UNLOCK(readahead_lock);
+}
+
+void zeroperl_readahead_shared(int fd)
+{
+    if (!zeroperl_readahead_on || fd < 0 || fd >= ZEROPERL_READAHEAD_FDS)
+    {
+        return;
+    }
+    ZEROPERL_LOCK(readahead_lock);
+    struct ra_file *f = files[fd];
+    if (f)
+    {
+        // Unchecked means nothing was answered here, and the host's offset
+        // is already right.
+        if (f->checked)
+        {
+            __real_lseek(fd, f->pos, SEEK_SET);
+            stats.shared++;
+        }
+        release(fd);
+    }
+    ZEROPERL_UNLOCK(readahead_lock);
+}
+
+void zeroperl_readahead_invalidate(void)
+{
+    if (!zeroperl_readahead_on)
+    {
+        return;
+    }
+    ZEROPERL_LOCK(readahead_lock);
+    generation++;
+    stats.invalidations++;
+    ZEROPERL_UNLOCK(readahead_lock);
+}
+
+// The cache for fd, or NULL if the call should go to the host. Called with
+// the lock held.
+static struct ra_file *acquire(int fd)
+{
+    struct ra_file *f = fd >= 0 && fd < ZEROPERL_READAHEAD_FDS ? files[fd] : NULL;
+    if (!f)
+    {
+        return NULL;
+    }
+    if (!f->checked)
+    {
+        // Nothing has been answered here yet, so the host's offset is
+        // still the right one if fd is handed back.
+        struct stat st;
+        if (__real_fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            stats.checks++;
+            stats.rejected++;
+            release(fd);
+            return NULL;
+        }
+        stats.checks++;
+        f->checked = true;
+    }
+    if (f->generation != generation)
+    {
+        drop_blocks(f);
+    }
+    return f;
+}
+
+static struct ra_block *find(struct ra_file *f, off_t index)
+{
+    for (size_t i = 0; i < nblocks; i++)
+    {
+        if (f->blocks[i].index == index)
+        {
+            f->blocks[i].used = ++tick;
+            return &f->blocks[i];
+        }
+    }
+    return NULL;
+}
+
+// The least recently used block that is not in taken[0..n).
+static struct ra_block *victim(struct ra_file *f, struct ra_block **taken, size_t n)
+{
+    struct ra_block *best = NULL;
+    for (size_t i = 0; i < nblocks; i++)
+    {
+        struct ra_block *b = &f->blocks[i];
+        bool skip = false;
+        for (size_t j = 0; j < n && !skip; j++)
+        {
+            skip = taken[j] == b;
+        }
+        if (!skip && (!best || b->index < 0 || (best->index >= 0 && b->used < best->used)))
+        {
+            best = b;
+            if (b->index < 0)
+            {
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+// Read block index and, for sequential access, the ones after it, in one
+// host call. Returns the block for index, or NULL with errno set.
+static struct ra_block *fill(struct ra_file *f, int fd, off_t index)
+{
+    struct ra_block *taken[RA_MAX_BLOCKS];
+    struct iovec iov[RA_MAX_BLOCKS];
+    size_t want = 1;
+    size_t n = 0;
+
+    if (index == f->next_index)
+    {
+        want = f->window * 2;
+        if (want > nblocks / 2)
+        {
+            want = nblocks / 2 ? nblocks / 2 : 1;
+        }
+    }
+    // The block for index itself may be cached but short; it is reused.
+    struct ra_block *first = find(f, index);
+    while (n < want)
+    {
+        struct ra_block *b = n == 0 && first ? first : victim(f, taken, n);
+        if (n > 0 && find(f, index + (off_t)n))
+        {
+            break; // already cached from here on
+        }
+        if (!b->data && !(b->data = malloc(block_size)))
+        {
+            if (n == 0)
+            {
+                errno = ENOMEM;
+                return NULL;
+            }
+            break;
+        }
+        b->index = -1;
+        taken[n] = b;
+        iov[n].iov_base = b->data;
+        iov[n].iov_len = block_size;
+        n++;
+    }
+
+    ssize_t r = preadv(fd, iov, (int)n, index * (off_t)block_size);
+    if (r < 0)
+    {
+        return NULL;
+    }
+    stats.fills++;
+    stats.fill_blocks += (uint32_t)n;
+    stats.bytes_filled += (uint64_t)r;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t off = i * block_size;
+        size_t len = (size_t)r > off ? (size_t)r - off : 0;
+        if (len > block_size)
+        {
+            len = block_size;
+        }
+        // Past the end of the file only the first block is kept, empty.
+        if (i > 0 && len == 0)
+        {
+            break;
+        }
+        taken[i]->index = index + (off_t)i;
+        taken[i]->len = len;
+        taken[i]->used = ++tick;
+    }
+    f->next_index = index + (off_t)n;
+    f->window = n;
+    return taken[0];
+}
+
+enum zeroperl_readahead_result zeroperl_readahead_read(int fd, void *buf, size_t count, ssize_t *out)
+{
+    if (!zeroperl_readahead_on)
+    {
+        return ZEROPERL_READAHEAD_NOT_OURS;
+    }
+    ZEROPERL_LOCK(readahead_lock);
+    struct ra_file *f = acquire(fd);
+    if (!f)
+    {
+        ZEROPERL_UNLOCK(readahead_lock);
+        return ZEROPERL_READAHEAD_NOT_OURS;
+    }
+    stats.reads++;
+
+    bool host = false;
+    size_t done = 0;
+    int saved_errno = errno;
+    while (done < count)
+    {
+        off_t index = f->pos / (off_t)block_size;
+        size_t at = (size_t)(f->pos % (off_t)block_size);
+        struct ra_block *b = find(f, index);
+
+        if (!b && count - done >= block_size)
+        {
+            ssize_t r = pread(fd, (char *)buf + done, count - done, f->pos);
+            host = true;
+            stats.direct_reads++;
+            if (r < 0)
+            {
+                if (done == 0)
+                {
+                    *out = -1;
+                    goto out;
+                }
+                break;
+            }
+            f->pos += r;
+            done += (size_t)r;
+            break;
+        }
+        if (!b || (at >= b->len && b->len < block_size))
+        {
+            host = true;
+            if (!(b = fill(f, fd, index)))
+            {
+                if (done == 0)
+                {
+                    *out = -1;
+                    goto out;
+                }
+                break;
+            }
+            if (at >= b->len)
+            {
+                break; // end of file
+            }
+        }
+
+        size_t n = b->len - at;
+        if (n > count - done)
+        {
+            n = count - done;
+        }
+        memcpy((char *)buf + done, b->data + at, n);
+        done += n;
+        f->pos += (off_t)n;
+        if (b->len < block_size && at + n == b->len)
+        {
+            break; // end of file as of the last fill
+        }
+    }
+    errno = saved_errno;
+    *out = (ssize_t)done;
+    stats.bytes_read += done;
+    if (!host)
+    {
+        stats.read_hits++;
+    }
+out:
+    ZEROPERL_UNLOCK(readahead_lock);
+    return host ? ZEROPERL_READAHEAD_MISS : ZEROPERL_READAHEAD_HIT;
+}
+
+enum zeroperl_readahead_result zeroperl_readahead_lseek(int fd, off_t offset, int whence, off_t *out)
+{
+    if (!zeroperl_readahead_on)
+    {
+        return ZEROPERL_READAHEAD_NOT_OURS;
+    }
+    ZEROPERL_LOCK(readahead_lock);
+    struct ra_file *f = acquire(fd);
+    if (!f)
+    {
+        ZEROPERL_UNLOCK(readahead_lock);
+        return ZEROPERL_READAHEAD_NOT_OURS;
+    }
+    stats.seeks++;
+
+    bool host = false;
+    off_t base;
+    struct stat st;
+    switch (whence)
+    {
+    case SEEK_SET:
+        base = 0;
+        break;
+    case SEEK_CUR:
+        base = f->pos;
+        break;
+    case SEEK_END:
+        host = true;
+        if (__real_fstat(fd, &st) != 0)
+        {
+            *out = -1;
+            goto out;
+        }
+        base = st.st_size;
+        break;
+    default:
+        // SEEK_DATA and SEEK_HOLE need the host's view of the file.
+        host = true;
+        *out = __real_lseek(fd, offset, whence);
+        if (*out >= 0)
+        {
+            f->pos = *out;
+        }
+        goto out;
+    }
+    if ((offset > 0 && base > INT64_MAX - offset) || base + offset < 0)
+    {
+        errno = (offset > 0 && base > INT64_MAX - offset) ? EOVERFLOW : EINVAL;
+        *out = -1;
+        goto out;
+    }
+    f->pos = base + offset;
+    *out = f->pos;
+    if (!host)
+    {
+        stats.seek_hits++;
+    }
+out:
+    ZEROPERL_UNLOCK(readahead_lock);
+    return host ? ZEROPERL_READAHEAD_MISS : ZEROPERL_READAHEAD_HIT;
+}
+
+/* -------------------------------------------------------------------------
+ * Statistics.
+ * ------------------------------------------------------------------------- */
+
+void zeroperl_readahead_get_stats(struct zeroperl_readahead_stats *out)
+{
+    ZEROPERL_LOCK(readahead_lock);
+    *out = stats;
+    ZEROPERL_UNLOCK(readahead_lock);
+}
+
+void zeroperl_readahead_report(int fd)
+{
+    char line[200];
+    int n;
+    struct zeroperl_readahead_stats s;
+
+    zeroperl_readahead_get_stats(&s);
+    // The fstat() checks, the fills, the direct reads, the seeks that
+    // needed the host and the offset updates for duplicated descriptors.
+    uint32_t host_calls = s.checks + s.fills + s.direct_reads + (s.seeks - s.seek_hits) + s.shared;
+    n = snprintf(line, sizeof(line),
+                 "readahead: %u host calls for %u reads and %u seeks on %u files (%u not regular)\n",
+                 host_calls, s.reads, s.seeks, s.files, s.rejected);
+    write(fd, line, (size_t)n);
+    n = snprintf(line, sizeof(line),
+                 "readahead: reads %u from cache %u direct, seeks %u without the host, "
+                 "%u fills of %u blocks, %llu bytes read %llu filled, %u invalidations, %u duplicated\n",
+                 s.read_hits, s.direct_reads, s.seek_hits, s.fills, s.fill_blocks,
+                 (unsigned long long)s.bytes_read, (unsigned long long)s.bytes_filled, s.invalidations, s.shared);
+    write(fd, line, (size_t)n);
+}
+
+static void zeroperl_readahead_report_at_exit(void)
+{
+    zeroperl_readahead_report(STDERR_FILENO);
+}
+
+__attribute__((constructor)) static void zeroperl_readahead_init(void)
+{
+    const char *env = getenv("ZEROPERL_READAHEAD");
+    const char *blocks = getenv("ZEROPERL_READAHEAD_BLOCKS");
+    const char *report = getenv("ZEROPERL_READAHEAD_STATS");
+
+    if (!env || !*env || strcmp(env, "0") == 0)
+    {
+        return;
+    }
+    size_t size = zeroperl_parse_size(env);
+    if (size > 1)
+    {
+        block_size = size < RA_MIN_BLOCK ? RA_MIN_BLOCK : size > RA_MAX_BLOCK ? RA_MAX_BLOCK : size;
+    }
+    if (blocks && *blocks)
+    {
+        unsigned long n = strtoul(blocks, NULL, 10);
+        nblocks = n < 1 ? 1 : n > RA_MAX_BLOCKS ? RA_MAX_BLOCKS : n;
+    }
+    zeroperl_readahead_on = true;
+    if (report && *report && strcmp(report, "0") != 0)
+    {
+        atexit(zeroperl_readahead_report_at_exit);
+    }
+}
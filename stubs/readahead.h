@@ -0,0 +1,63 @@
+#ifndef ZEROPERL_READAHEAD_H
+#define ZEROPERL_READAHEAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Block cache with read-ahead for host files opened read-only, enabled by
+// ZEROPERL_READAHEAD, see readahead.c.
+#ifndef ZEROPERL_READAHEAD_FDS
+#define ZEROPERL_READAHEAD_FDS 256
+#endif
+
+extern bool zeroperl_readahead_on;
+
+enum zeroperl_readahead_result
+{
+    ZEROPERL_READAHEAD_NOT_OURS, // fd is not cached: make the host call
+    ZEROPERL_READAHEAD_HIT,      // answered without a host call
+    ZEROPERL_READAHEAD_MISS,     // answered, with at least one host call
+};
+
+// A host open() returned fd. Only read-only opens are worth passing.
+void zeroperl_readahead_open(int fd);
+// fd is about to be closed.
+void zeroperl_readahead_close(int fd);
+// fd was duplicated: move the host's offset, which the copy shares, to
+// where reads and seeks on fd left it, and stop caching fd.
+void zeroperl_readahead_shared(int fd);
+
+// read() and lseek() for a cached fd, with the result in *out.
+enum zeroperl_readahead_result zeroperl_readahead_read(int fd, void *buf, size_t count, ssize_t *out);
+enum zeroperl_readahead_result zeroperl_readahead_lseek(int fd, off_t offset, int whence, off_t *out);
+
+// Host file contents may have changed (a write through another fd): drop
+// every cached block.
+void zeroperl_readahead_invalidate(void);
+
+struct zeroperl_readahead_stats
+{
+    uint32_t files;        // read-only opens cached
+    uint32_t checks;       // ...asked the host with fstat() whether they are regular files
+    uint32_t rejected;     // ...and were not
+    uint32_t reads;        // read() calls on cached fds
+    uint32_t read_hits;    // ...answered from cached blocks alone
+    uint32_t direct_reads; // ...of a block or more, read straight into the caller's buffer
+    uint32_t seeks;        // lseek() calls on cached fds
+    uint32_t seek_hits;    // ...answered without a host call
+    uint32_t fills;        // host reads filling blocks
+    uint32_t fill_blocks;  // blocks those reads filled
+    uint32_t invalidations;
+    uint32_t shared;       // cached fds duplicated, their host offset updated
+    uint64_t bytes_read;     // bytes returned by read()
+    uint64_t bytes_filled;   // bytes the host returned into blocks
+};
+
+void zeroperl_readahead_get_stats(struct zeroperl_readahead_stats *out);
+
+// Write a summary to fd. Also done at exit when ZEROPERL_READAHEAD_STATS is
+// set in the environment.
+void zeroperl_readahead_report(int fd);
+
+#endif
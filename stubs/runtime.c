@@ -3,16 +3,47 @@
 #include "setjmp.h"
 #include <stdlib.h>
 
-int asyncjmp_rt_start(int(main)(int argc, char **argv), int argc, char **argv)
+// A main suspended by asyncjmp_yield under asyncjmp_rt_start_yieldable.
+static ASYNCJMP_THREAD_LOCAL struct
+{
+    int (*main)(int argc, char **argv);
+    int argc;
+    char **argv;
+    void *rewind_buf;
+    // The stack pointer main was first called with, and the one it had
+    // unwound from. Its frames stay in linear memory in between.
+    void *entry_sp;
+    void *sp;
+    bool yieldable;
+} rt_suspended;
+
+// Set by asyncjmp_rt_checkpoint for the yield it starts.
+static ASYNCJMP_THREAD_LOCAL void (*rt_checkpoint_fn)(void);
+
+static int rt_run(int(main)(int argc, char **argv), int argc, char **argv, void *rewind_buf, bool yieldable)
 {
     int result;
     void *asyncify_buf;
+    void *entry_sp = asyncjmp_get_stack_pointer();
+
+    if (rewind_buf)
+    {
+        // This frame must sit no deeper than the one main started under,
+        // or it would overwrite main's frames.
+        if ((char *)entry_sp < (char *)rt_suspended.entry_sp)
+        {
+            abort();
+        }
+        entry_sp = rt_suspended.entry_sp;
+        asyncjmp_set_stack_pointer(rt_suspended.sp);
+        asyncify_start_rewind(rewind_buf);
+    }
 
     while (1)
     {
         result = main(argc, argv);
 
-         extern void *pl_asyncify_unwind_buf;
+         extern ASYNCJMP_THREAD_LOCAL void *pl_asyncify_unwind_buf;
         // Exit Asyncify loop if there is no unwound buffer, which
         // means that main function has returned normally.
         if (pl_asyncify_unwind_buf == NULL) {
@@ -34,8 +65,72 @@ int asyncjmp_rt_start(int(main)(int argc, char **argv), int argc, char **argv)
             asyncify_start_rewind(asyncify_buf);
             continue;
         }
+        if ((asyncify_buf = asyncjmp_handle_yield_unwind()) != NULL)
+        {
+            if (yieldable || rt_checkpoint_fn)
+            {
+                rt_suspended.main = main;
+                rt_suspended.argc = argc;
+                rt_suspended.argv = argv;
+                rt_suspended.rewind_buf = asyncify_buf;
+                rt_suspended.entry_sp = entry_sp;
+                rt_suspended.sp = asyncjmp_get_stack_pointer();
+                rt_suspended.yieldable = yieldable;
+            }
+            if (rt_checkpoint_fn)
+            {
+                // Memory now holds everything asyncjmp_rt_resume needs.
+                void (*fn)(void) = rt_checkpoint_fn;
+                rt_checkpoint_fn = NULL;
+                fn();
+                rt_suspended.rewind_buf = NULL;
+                asyncify_start_rewind(asyncify_buf);
+                continue;
+            }
+            if (yieldable)
+            {
+                return ASYNCJMP_RT_YIELDED;
+            }
+            asyncify_start_rewind(asyncify_buf);
+            continue;
+        }
 
         break;
     }
     return result;
 }
+
+int asyncjmp_rt_start(int(main)(int argc, char **argv), int argc, char **argv)
+{
+    return rt_run(main, argc, argv, NULL, false);
+}
+
+int asyncjmp_rt_start_yieldable(int(main)(int argc, char **argv), int argc, char **argv)
+{
+    return rt_run(main, argc, argv, NULL, true);
+}
+
+int asyncjmp_rt_resume(void)
+{
+    void *buf = rt_suspended.rewind_buf;
+    if (!buf)
+    {
+        return -1;
+    }
+    rt_suspended.rewind_buf = NULL;
+    return rt_run(rt_suspended.main, rt_suspended.argc, rt_suspended.argv, buf, rt_suspended.yieldable);
+}
+
+int asyncjmp_rt_checkpoint(void (*fn)(void))
+{
+    int ret;
+    rt_checkpoint_fn = fn;
+    ret = asyncjmp_yield();
+    rt_checkpoint_fn = NULL;
+    return ret;
+}
+
+bool asyncjmp_rt_suspended(void)
+{
+    return rt_suspended.rewind_buf != NULL;
+}
@@ -80,9 +80,26 @@ void async_buf_init(struct __asyncjmp_asyncify_jmp_buf *buf)
     buf->end = &buf->buffer[WASM_SETJMP_STACK_BUFFER_SIZE];
 }
 
-// Global unwinding/rewinding jmpbuf state
-static asyncjmp_jmp_buf *_asyncjmp_active_jmpbuf;
-void *pl_asyncify_unwind_buf;
+// Unwinding/rewinding jmpbuf state, one per thread
+static ASYNCJMP_THREAD_LOCAL asyncjmp_jmp_buf *_asyncjmp_active_jmpbuf;
+ASYNCJMP_THREAD_LOCAL void *pl_asyncify_unwind_buf;
+
+// Deepest spill seen once an unwind has finished, for memory accounting.
+// Shared by all threads, so it is raised with a compare-and-swap.
+static size_t _asyncjmp_spill_high_water;
+
+static void note_spill(const struct __asyncjmp_asyncify_jmp_buf *buf)
+{
+    size_t used = (size_t)((const char *)buf->top - buf->buffer);
+    size_t seen = __atomic_load_n(&_asyncjmp_spill_high_water, __ATOMIC_RELAXED);
+    while (used > seen &&
+           !__atomic_compare_exchange_n(&_asyncjmp_spill_high_water, &seen, used, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+}
+
+size_t asyncjmp_spill_high_water(void) { return __atomic_load_n(&_asyncjmp_spill_high_water, __ATOMIC_RELAXED); }
 
 __attribute__((noinline)) int _asyncjmp_setjmp_internal(asyncjmp_jmp_buf *env)
 {
@@ -113,7 +130,8 @@ __attribute__((noinline)) int _asyncjmp_setjmp_internal(asyncjmp_jmp_buf *env)
         asyncify_stop_rewind();
         ASYNCJMP_DEBUG_LOG("  JMP_BUF_STATE_RETURNING");
         env->state = JMP_BUF_STATE_CAPTURED;
-        free(env->longjmp_buf_ptr);
+        // longjmp_buf_ptr is the static tmp_longjmp_buf, not heap memory.
+        env->longjmp_buf_ptr = NULL;
         _asyncjmp_active_jmpbuf = NULL;
         return env->payload;
     }
@@ -131,8 +149,8 @@ void _asyncjmp_longjmp(asyncjmp_jmp_buf *env, int value)
     env->state = JMP_BUF_STATE_RETURNING;
     env->payload = value;
     // Asyncify buffer built during unwinding for longjmp will not
-    // be used to rewind, so re-use static-variable.
-    static struct __asyncjmp_asyncify_jmp_buf tmp_longjmp_buf;
+    // be used to rewind, so re-use static-variable (one per thread).
+    static ASYNCJMP_THREAD_LOCAL struct __asyncjmp_asyncify_jmp_buf tmp_longjmp_buf;
     env->longjmp_buf_ptr = &tmp_longjmp_buf;
     _asyncjmp_active_jmpbuf = env;
     async_buf_init(env->longjmp_buf_ptr);
@@ -160,8 +178,8 @@ void asyncjmp_try_catch_init(struct asyncjmp_try_catch *try_catch,
 void asyncjmp_try_catch_loop_run(struct asyncjmp_try_catch *try_catch,
                                  asyncjmp_jmp_buf *target)
 {
-    extern void *pl_asyncify_unwind_buf;
-    extern asyncjmp_jmp_buf *_asyncjmp_active_jmpbuf;
+    extern ASYNCJMP_THREAD_LOCAL void *pl_asyncify_unwind_buf;
+    extern ASYNCJMP_THREAD_LOCAL asyncjmp_jmp_buf *_asyncjmp_active_jmpbuf;
 
     target->state = JMP_BUF_STATE_CAPTURED;
 
@@ -186,6 +204,7 @@ void asyncjmp_try_catch_loop_run(struct asyncjmp_try_catch *try_catch,
         {
             // do similar steps setjmp does when JMP_BUF_STATE_RETURNING
 
+            note_spill(target->longjmp_buf_ptr);
             // stop unwinding
             // (but call stop_rewind to update the asyncify state to "normal" from
             // "unwind")
@@ -217,12 +236,14 @@ void *asyncjmp_handle_jmp_unwind(void)
     {
     case JMP_BUF_STATE_CAPTURING:
         ASYNCJMP_DEBUG_LOG("  JMP_BUF_STATE_CAPTURING");
+        note_spill(&_asyncjmp_active_jmpbuf->setjmp_buf);
         // save the captured Asyncify stack top
         _asyncjmp_active_jmpbuf->dst_buf_top =
             _asyncjmp_active_jmpbuf->setjmp_buf.top;
         break;
     case JMP_BUF_STATE_RETURNING:
         ASYNCJMP_DEBUG_LOG("  JMP_BUF_STATE_RETURNING");
+        note_spill(_asyncjmp_active_jmpbuf->longjmp_buf_ptr);
         // restore the saved Asyncify stack top
         _asyncjmp_active_jmpbuf->setjmp_buf.top =
             _asyncjmp_active_jmpbuf->dst_buf_top;
@@ -232,3 +253,69 @@ void *asyncjmp_handle_jmp_unwind(void)
     }
     return &_asyncjmp_active_jmpbuf->setjmp_buf;
 }
+
+// Cooperative yield: unwind the whole stack to asyncjmp_rt_start with no
+// setjmp involved, and rewind it later. The buffer is allocated on first
+// use and sized for deep Perl stacks, well above a jmp_buf's.
+#ifndef ASYNCJMP_YIELD_BUFFER_SIZE
+#define ASYNCJMP_YIELD_BUFFER_SIZE (256 * 1024)
+#endif
+
+enum asyncjmp_yield_state
+{
+    YIELD_STATE_NONE = 0,
+    YIELD_STATE_UNWINDING = 1,
+    YIELD_STATE_REWINDING = 2,
+};
+
+struct asyncjmp_yield_buf
+{
+    void *top;
+    void *end;
+    char buffer[];
+};
+
+static ASYNCJMP_THREAD_LOCAL struct asyncjmp_yield_buf *_asyncjmp_yield_buf;
+static ASYNCJMP_THREAD_LOCAL int _asyncjmp_yield_state;
+
+__attribute__((noinline)) int asyncjmp_yield(void)
+{
+    ASYNCJMP_DEBUG_LOG("enter asyncjmp_yield");
+    switch (_asyncjmp_yield_state)
+    {
+    case YIELD_STATE_NONE:
+        if (!_asyncjmp_yield_buf)
+        {
+            _asyncjmp_yield_buf = malloc(sizeof(*_asyncjmp_yield_buf) + ASYNCJMP_YIELD_BUFFER_SIZE);
+            if (!_asyncjmp_yield_buf)
+            {
+                return -1;
+            }
+        }
+        _asyncjmp_yield_buf->top = &_asyncjmp_yield_buf->buffer[0];
+        _asyncjmp_yield_buf->end = &_asyncjmp_yield_buf->buffer[ASYNCJMP_YIELD_BUFFER_SIZE];
+        _asyncjmp_yield_state = YIELD_STATE_UNWINDING;
+        asyncify_start_unwind(_asyncjmp_yield_buf);
+        return 0; // a dummy value, as in setjmp
+    case YIELD_STATE_REWINDING:
+        asyncify_stop_rewind();
+        ASYNCJMP_DEBUG_LOG("  YIELD_STATE_REWINDING");
+        _asyncjmp_yield_state = YIELD_STATE_NONE;
+        return 0;
+    default:
+        assert(0 && "unexpected state");
+    }
+    return -1;
+}
+
+void *asyncjmp_handle_yield_unwind(void)
+{
+    ASYNCJMP_DEBUG_LOG("enter asyncjmp_handle_yield_unwind");
+    if (_asyncjmp_yield_state != YIELD_STATE_UNWINDING)
+    {
+        return NULL;
+    }
+    _asyncjmp_yield_state = YIELD_STATE_REWINDING;
+    // Rewinding pops the buffer from where unwinding left `top`.
+    return _asyncjmp_yield_buf;
+}
@@ -2,6 +2,7 @@
 #define ASYNCJMP_SUPPORT_SETJMP_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifndef WASM_SETJMP_STACK_BUFFER_SIZE
 #define WASM_SETJMP_STACK_BUFFER_SIZE 32768
@@ -49,6 +50,10 @@ __attribute__((noinline)) void _asyncjmp_longjmp(asyncjmp_jmp_buf *env, int payl
 // Used by the top level Asyncify handling in wasm/runtime.c
 void *asyncjmp_handle_jmp_unwind(void);
 
+// The most bytes Asyncify has spilled into one buffer while unwinding for
+// setjmp or longjmp, against WASM_SETJMP_STACK_BUFFER_SIZE. See memstats.c.
+size_t asyncjmp_spill_high_water(void);
+
 //
 // POSIX-compatible declarations
 //
@@ -90,10 +95,44 @@ void asyncjmp_try_catch_init(struct asyncjmp_try_catch *try_catch,
 //
 void asyncjmp_try_catch_loop_run(struct asyncjmp_try_catch *try_catch, asyncjmp_jmp_buf *target);
 
+//
+// Cooperative yield
+//
+
+// Unwind the whole stack to the asyncjmp_rt_* loop that is running it.
+// asyncjmp_rt_start rewinds straight back; asyncjmp_rt_start_yieldable
+// returns ASYNCJMP_RT_YIELDED to its caller instead, and execution carries
+// on from here at the next asyncjmp_rt_resume. Returns 0 once resumed, or
+// -1 without yielding if no buffer could be allocated.
+__attribute__((noinline)) int asyncjmp_yield(void);
+
+// Returns the Asyncify buffer of next rewinding if unwound by asyncjmp_yield.
+// Used by the top level Asyncify handling in wasm/runtime.c
+void *asyncjmp_handle_yield_unwind(void);
+
 //
 // Main function startup wrapper
 //
 
+#define ASYNCJMP_RT_YIELDED (-2)
+
 int asyncjmp_rt_start(int(main)(int argc, char **argv), int argc, char **argv);
 
+// Like asyncjmp_rt_start, but returns ASYNCJMP_RT_YIELDED when main yields.
+// The stack below the caller must then be left alone until
+// asyncjmp_rt_resume, which continues main and returns like this function.
+int asyncjmp_rt_start_yieldable(int(main)(int argc, char **argv), int argc, char **argv);
+int asyncjmp_rt_resume(void);
+
+// True between a yield and the resume that continues it.
+bool asyncjmp_rt_suspended(void);
+
+// Yield, call fn from the asyncjmp_rt_* loop while main's whole stack is
+// saved in linear memory, and rewind straight back. A copy of linear memory
+// taken inside fn (and the stack pointer, which the copy records) can be
+// continued in a fresh instance of the module with asyncjmp_rt_resume,
+// which returns there as it would have in the original. Returns 0 once
+// rewound, or -1 as asyncjmp_yield.
+int asyncjmp_rt_checkpoint(void (*fn)(void));
+
 #endif
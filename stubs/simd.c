@@ -0,0 +1,145 @@
+/*
+ SIMD128 versions of the libc string primitives Perl spends most time in.
+
+ Only linked into the SIMD build (the `simd` workflow input, which compiles
+ everything with -msimd128). The prebuilt wasi-libc sysroot is scalar, and
+ these definitions take precedence over its memchr.o, memrchr.o, strlen.o
+ and memcmp.o because they are already defined when libc.a is searched.
+
+ Perl reaches them from index/rindex (ninstr, rninstr), split on a single
+ character, readline record separators, regex literal and anchored-substring
+ prefilters, and the PerlIO buffer scans.
+
+ Scanning loads are 16 byte aligned. An aligned block that holds at least
+ one byte of the string cannot cross the end of linear memory, whose size
+ is a multiple of 64 KiB, so reading a whole block past the terminator is
+ safe even though the bytes themselves are ignored.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <wasm_simd128.h>
+
+#define BLOCK 16
+
+static inline uint32_t match_mask(const unsigned char *p, v128_t needle)
+{
+    return wasm_i8x16_bitmask(wasm_i8x16_eq(wasm_v128_load(p), needle));
+}
+
+void *memchr(const void *src, int c, size_t n)
+{
+    const unsigned char *s = src;
+    if (n == 0)
+    {
+        return NULL;
+    }
+
+    const v128_t needle = wasm_i8x16_splat((int8_t)c);
+    size_t head = (uintptr_t)s & (BLOCK - 1);
+    const unsigned char *p = (const unsigned char *)((uintptr_t)s - head);
+
+    /* First block: drop the bits of the bytes before s. */
+    uint32_t mask = match_mask(p, needle) >> head;
+    size_t off = 0;
+    size_t seen = BLOCK - head;
+    for (;;)
+    {
+        if (mask)
+        {
+            size_t i = off + (size_t)__builtin_ctz(mask);
+            return i < n ? (void *)(s + i) : NULL;
+        }
+        if (seen >= n)
+        {
+            return NULL;
+        }
+        p += BLOCK;
+        off = seen;
+        seen += BLOCK;
+        mask = match_mask(p, needle);
+    }
+}
+
+void *memrchr(const void *src, int c, size_t n)
+{
+    const unsigned char *s = src;
+    if (n == 0)
+    {
+        return NULL;
+    }
+
+    const v128_t needle = wasm_i8x16_splat((int8_t)c);
+    const unsigned char *end = s + n;
+    size_t tail = (uintptr_t)end & (BLOCK - 1);
+    const unsigned char *p = end - tail;
+
+    /* Last, partial block: keep only the bytes before end. */
+    uint32_t mask = tail ? match_mask(p, needle) & ((1u << tail) - 1) : 0;
+    for (;;)
+    {
+        if (mask)
+        {
+            const unsigned char *hit = p + 31 - __builtin_clz(mask);
+            return hit >= s ? (void *)hit : NULL;
+        }
+        if (p <= s)
+        {
+            return NULL;
+        }
+        p -= BLOCK;
+        mask = match_mask(p, needle);
+    }
+}
+
+size_t strlen(const char *str)
+{
+    const unsigned char *s = (const unsigned char *)str;
+    const v128_t zero = wasm_i8x16_splat(0);
+    size_t head = (uintptr_t)s & (BLOCK - 1);
+    const unsigned char *p = s - head;
+
+    uint32_t mask = match_mask(p, zero) >> head;
+    if (mask)
+    {
+        return (size_t)__builtin_ctz(mask);
+    }
+    for (;;)
+    {
+        p += BLOCK;
+        mask = match_mask(p, zero);
+        if (mask)
+        {
+            return (size_t)(p - s) + (size_t)__builtin_ctz(mask);
+        }
+    }
+}
+
+int memcmp(const void *left, const void *right, size_t n)
+{
+    const unsigned char *l = left;
+    const unsigned char *r = right;
+
+    /* The two sides are rarely aligned alike, so use unaligned loads and
+       only for whole blocks inside both buffers. */
+    while (n >= BLOCK)
+    {
+        uint32_t diff = wasm_i8x16_bitmask(wasm_i8x16_eq(wasm_v128_load(l), wasm_v128_load(r))) ^ 0xffff;
+        if (diff)
+        {
+            size_t i = (size_t)__builtin_ctz(diff);
+            return l[i] - r[i];
+        }
+        l += BLOCK;
+        r += BLOCK;
+        n -= BLOCK;
+    }
+    for (; n; n--, l++, r++)
+    {
+        if (*l != *r)
+        {
+            return *l - *r;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef ZEROPERL_SIZE_H
+#define ZEROPERL_SIZE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// A byte count from the environment, such as ZEROPERL_TMPFS_SIZE=256m:
+// decimal digits with an optional k, m or g suffix (powers of 1024, either
+// case). Anything after the suffix is ignored. Values that do not fit,
+// before or after the suffix, are clamped to SIZE_MAX.
+static inline size_t zeroperl_parse_size(const char *s)
+{
+    char *end;
+    unsigned long long n = strtoull(s, &end, 10);
+    unsigned shift = 0;
+
+    switch (*end)
+    {
+    case 'g':
+    case 'G':
+        shift = 30;
+        break;
+    case 'm':
+    case 'M':
+        shift = 20;
+        break;
+    case 'k':
+    case 'K':
+        shift = 10;
+        break;
+    }
+    if (n > (SIZE_MAX >> shift))
+    {
+        return SIZE_MAX;
+    }
+    return (size_t)n << shift;
+}
+
+#endif
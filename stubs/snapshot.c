@@ -0,0 +1,96 @@
+/*
+ Guest side of the linear-memory snapshot support used by tools/snapshot.mjs.
+
+ The host captures a copy of linear memory once zeroperl_init() has returned,
+ and after every request copies back the pages that changed. For that to be
+ equivalent to a fresh instance, everything the module needs must live either
+ in linear memory or in a global the host can read and write:
+
+ 1. __stack_pointer is the only mutable global clang emits for a single
+    threaded module, so it is exposed through the two accessors below.
+ 2. Asyncify's own globals are only non-zero while unwinding or rewinding,
+    and the host never snapshots or restores in that state.
+ 3. wasi-libc's sbrk() treats memory.size as the break, so after a restore
+    dlmalloc would believe its top chunk ends at the old break while the
+    memory is already larger, and every request would grow memory again.
+    The sbrk() below keeps the break in linear memory instead, so a restore
+    rewinds it and the already-grown pages are reused.
+
+ The memory size is computed in 64 bits: a wasm32 memory grown to its full
+ 65536 pages is 2^32 bytes, which does not fit in a uintptr_t.
+ */
+#include "machine.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define WASM_PAGE_SIZE 65536
+
+// Current program break. Zero until the first call, then lives in linear
+// memory like any other libc state, so it is captured by the snapshot.
+static uintptr_t zeroperl_brk = 0;
+
+void *sbrk(intptr_t increment)
+{
+    uint64_t limit = (uint64_t)__builtin_wasm_memory_size(0) * WASM_PAGE_SIZE;
+    if (zeroperl_brk == 0)
+    {
+        zeroperl_brk = (uintptr_t)limit;
+    }
+
+    uintptr_t old = zeroperl_brk;
+    if (increment < 0)
+    {
+        if ((uintptr_t)-increment > old)
+        {
+            errno = ENOMEM;
+            return (void *)-1;
+        }
+        zeroperl_brk = old + increment;
+        return (void *)old;
+    }
+
+    if ((uintptr_t)increment > UINTPTR_MAX - old)
+    {
+        errno = ENOMEM;
+        return (void *)-1;
+    }
+
+    uintptr_t new_brk = old + (uintptr_t)increment;
+    if (new_brk > limit)
+    {
+        size_t pages = (size_t)((new_brk - limit + WASM_PAGE_SIZE - 1) / WASM_PAGE_SIZE);
+        if (__builtin_wasm_memory_grow(0, pages) == (size_t)-1)
+        {
+            errno = ENOMEM;
+            return (void *)-1;
+        }
+    }
+    zeroperl_brk = new_brk;
+    return (void *)old;
+}
+
+__attribute__((export_name("zeroperl_get_stack_pointer")))
+void *zeroperl_get_stack_pointer(void)
+{
+    return asyncjmp_get_stack_pointer();
+}
+
+__attribute__((export_name("zeroperl_set_stack_pointer")))
+void zeroperl_set_stack_pointer(void *sp)
+{
+    asyncjmp_set_stack_pointer(sp);
+}
+
+// Used by the host to pass argv and request source into the module.
+__attribute__((export_name("zeroperl_malloc")))
+void *zeroperl_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+__attribute__((export_name("zeroperl_free")))
+void zeroperl_free(void *ptr)
+{
+    free(ptr);
+}
@@ -1,5 +1,7 @@
 #include <unistd.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
 
 // Define mode_t as unsigned int if not already defined
 typedef unsigned int mode_t;
@@ -17,26 +19,27 @@ int setgid(int gid) { return 0; }
 // Process signaling
 int kill(pid_t pid, int sig) { return 0; }
 
-// File descriptor duplication
-int dup(int oldfd) { return -1; }
+// File descriptor duplication, through fcntl() so the read-ahead cache
+// sees it. WASI preview 1 itself has no way to duplicate a descriptor.
+int dup(int oldfd) {
+#ifdef F_DUPFD
+    return fcntl(oldfd, F_DUPFD, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
 
 // File mode creation mask
 mode_t umask(mode_t mask) { return 0; }
 
-// Program execution
-int execvp(const char *file, char *const argv[]) { return -1; }
+// Program execution (execv, execvp and spawning are in proc.c)
 int execl(const char *path, const char *arg1, const char *arg2, const char *arg3, const char *arg4) { 
     // Stub implementation: Return -1 to indicate failure
     return -1; 
 }
-int execv(const char *path, char *const argv[]) { return -1; }
-
-// Process creation
-int do_aspawn(int arg1, int arg2, int arg3) { return -1; } // Adjusted signature
-int do_spawn(int arg1) { return -1; } // Adjusted signature
 
-// Pipe and wait
-int PerlProc_pipe_cloexec(int fds[2]) { return -1; }
+// Wait (pipes, pipe opens, fork and waitpid go through proc.c)
 int wait(int *status) { return -1; }
 
 // Timezone functions
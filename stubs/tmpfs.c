@@ -0,0 +1,1313 @@
+/*
+ Writable in-memory file system.
+
+ Scripts that write temporary files (File::Temp, Archive::Zip, ExifTool's
+ -o, sort runs spilled to disk) make a WASI call for every open, write,
+ seek, stat and unlink, and some hosts have no writable directory to give
+ them at all. ZEROPERL_TMPFS=<dir> (typically /tmp) mounts an empty file
+ system at <dir> inside the module instead. Paths at or below it never
+ reach the host: open (O_CREAT, O_EXCL, O_TRUNC, O_APPEND), fopen, read,
+ write, pwrite, lseek, ftruncate, truncate, stat, lstat, fstat, access,
+ rename, unlink, mkdir, rmdir, opendir/readdir, chdir and getcwd are all
+ answered from linear memory. The file system lives and dies with the instance; under
+ tools/snapshot.mjs it is reset with the rest of memory after each request.
+
+ File data is kept in 64 KiB chunks, allocated on first write, so growing
+ a file never copies what is already there and holes cost nothing. A
+ chunk starts at 256 bytes and doubles as it fills, so small files stay
+ small. ZEROPERL_TMPFS_SIZE caps the bytes held by chunks (default 64M,
+ with an optional k, m or g suffix); writes past it fail with ENOSPC.
+ A file unlinked while open stays readable until its last descriptor or
+ directory stream is closed.
+
+ The host never learns about a chdir() into the tmpfs (File::Path does one
+ into every directory it removes), so while the cwd is inside, chdir()
+ hands the host absolute paths; other calls that leave the tmpfs through
+ "../" are resolved by the host against its own, older cwd. There are no
+ symlinks, hard links or permission checks (the instance runs as uid 0),
+ atime is not updated and rename() to or from the host fails with EXDEV.
+ Directory entries are kept in an array and searched linearly. One lock
+ covers everything in the wasi-threads build.
+ */
+#include "tmpfs.h"
+#include "lock.h"
+#include "size.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef NAME_MAX
+#define NAME_MAX 255
+#endif
+
+#define TMPFS_PATH_MAX 1024
+#define TMPFS_CHUNK_SHIFT 16
+#define TMPFS_CHUNK_SIZE ((size_t)1 << TMPFS_CHUNK_SHIFT)
+#define TMPFS_MIN_CHUNK 256
+#define TMPFS_DEFAULT_SIZE ((size_t)64 << 20)
+// Offsets must fit a size_t, with room to add a count.
+#define TMPFS_MAX_FILE ((off_t)(SIZE_MAX / 2))
+#define TMPFS_DEV 0x7a70 // "zp"
+
+extern int __real_chdir(const char *path);
+
+struct tmpfs_chunk
+{
+    unsigned char *data; // NULL until written; bytes past cap read as zero
+    size_t cap;
+};
+
+struct tmpfs_node
+{
+    struct tmpfs_node *parent; // NULL once unlinked (and for the root)
+    char *name;
+    uint32_t hash;
+    ino_t ino;
+    mode_t mode;
+    unsigned refs; // open descriptors and directory streams
+    time_t mtime, ctime, atime;
+    // Regular files.
+    off_t size;
+    size_t bytes; // sum of the chunks' cap
+    struct tmpfs_chunk *chunks;
+    size_t nchunks;
+    // Directories.
+    struct tmpfs_node **entries;
+    size_t count, cap;
+};
+
+struct tmpfs_file
+{
+    struct tmpfs_node *node; // NULL if the slot is free
+    off_t pos;
+    int flags;
+};
+
+// A directory stream, handed out as DIR *. Position 0 is ".", 1 is "..",
+// and n is entries[n - 2].
+struct tmpfs_dir
+{
+    struct tmpfs_dir *next;
+    struct tmpfs_node *node;
+    size_t pos;
+    union
+    {
+        struct dirent ent;
+        char buf[sizeof(struct dirent) + NAME_MAX + 1];
+    } out;
+};
+
+// A path resolved against the tree. node is NULL if the last component
+// does not exist yet; parent is NULL for the root.
+struct tmpfs_lookup
+{
+    char abs[TMPFS_PATH_MAX];
+    struct tmpfs_node *parent;
+    struct tmpfs_node *node;
+    const char *name;
+    uint32_t hash;
+    bool slash; // path ended in '/'
+};
+
+bool zeroperl_tmpfs_mounted;
+
+static char mount_point[TMPFS_PATH_MAX];
+static size_t mount_len;
+static struct tmpfs_node root;
+static ino_t next_ino = 2;
+static struct tmpfs_file files[ZEROPERL_TMPFS_MAX_OPEN];
+static struct tmpfs_dir *open_dirs;
+static size_t used, peak, limit;
+// Set by a chdir() into the tmpfs, cleared by one back to the host.
+static char cwd[TMPFS_PATH_MAX];
+static bool cwd_inside;
+
+ZEROPERL_MUTEX(tmpfs_lock);
+
+/* -------------------------------------------------------------------------
+ * Paths.
+ * ------------------------------------------------------------------------- */
+
+// Make path absolute (wasi-libc keeps the cwd itself, so getcwd() is not a
+// host call) and resolve empty, "." and ".." components.
+static bool normalize(char *dst, const char *path, bool *slash)
+{
+    char tmp[TMPFS_PATH_MAX];
+    size_t plen = strlen(path);
+    size_t n = 0;
+    const char *p = path;
+
+    if (path[0] != '/')
+    {
+        if (cwd_inside)
+        {
+            strcpy(tmp, cwd);
+        }
+        else if (!getcwd(tmp, sizeof(tmp)))
+        {
+            return false;
+        }
+        size_t len = strlen(tmp);
+        if (len + 1 + plen >= sizeof(tmp))
+        {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        tmp[len] = '/';
+        memcpy(tmp + len + 1, path, plen + 1);
+        p = tmp;
+    }
+    else if (plen >= TMPFS_PATH_MAX)
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    *slash = plen > 0 && path[plen - 1] == '/';
+
+    while (*p)
+    {
+        while (*p == '/')
+        {
+            p++;
+        }
+        const char *c = p;
+        while (*p && *p != '/')
+        {
+            p++;
+        }
+        size_t clen = (size_t)(p - c);
+        if (clen == 0 || (clen == 1 && c[0] == '.'))
+        {
+            continue;
+        }
+        if (clen == 2 && c[0] == '.' && c[1] == '.')
+        {
+            while (n > 0 && dst[--n] != '/')
+            {
+            }
+            continue;
+        }
+        dst[n++] = '/';
+        memcpy(dst + n, c, clen);
+        n += clen;
+    }
+    if (n == 0)
+    {
+        dst[n++] = '/';
+    }
+    dst[n] = '\0';
+    return true;
+}
+
+// The part of an absolute path below the mount point ("" for the mount
+// point itself), or NULL if it is outside.
+static char *below_mount(char *abs)
+{
+    if (mount_len == 1)
+    {
+        return abs + 1;
+    }
+    if (strncmp(abs, mount_point, mount_len) != 0 || (abs[mount_len] != '\0' && abs[mount_len] != '/'))
+    {
+        return NULL;
+    }
+    return abs[mount_len] ? abs + mount_len + 1 : abs + mount_len;
+}
+
+static uint32_t hash_name(const char *s)
+{
+    uint32_t h = 2166136261u;
+    while (*s)
+    {
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    }
+    return h;
+}
+
+static struct tmpfs_node *find(const struct tmpfs_node *dir, const char *name, uint32_t hash)
+{
+    for (size_t i = 0; i < dir->count; i++)
+    {
+        struct tmpfs_node *e = dir->entries[i];
+        if (e->hash == hash && strcmp(e->name, name) == 0)
+        {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// Resolve path. Fails, setting errno, only if it is not in the tmpfs or a
+// directory on the way is missing.
+static bool lookup(const char *path, struct tmpfs_lookup *l)
+{
+    char *rel;
+    struct tmpfs_node *dir = &root;
+
+    if (!normalize(l->abs, path, &l->slash))
+    {
+        return false;
+    }
+    if (!(rel = below_mount(l->abs)))
+    {
+        errno = EXDEV;
+        return false;
+    }
+    l->parent = NULL;
+    l->node = &root;
+    l->name = "";
+    l->hash = 0;
+    while (*rel)
+    {
+        char *end = strchr(rel, '/');
+        if (end)
+        {
+            *end = '\0';
+        }
+        if (!dir)
+        {
+            errno = ENOENT;
+            return false;
+        }
+        if (!S_ISDIR(dir->mode))
+        {
+            errno = ENOTDIR;
+            return false;
+        }
+        if (strlen(rel) > NAME_MAX)
+        {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        l->parent = dir;
+        l->name = rel;
+        l->hash = hash_name(rel);
+        l->node = dir = find(dir, rel, l->hash);
+        if (!end)
+        {
+            break;
+        }
+        rel = end + 1;
+    }
+    if (l->node && l->slash && !S_ISDIR(l->node->mode))
+    {
+        errno = ENOTDIR;
+        return false;
+    }
+    return true;
+}
+
+// lookup() for a path that must exist.
+static struct tmpfs_node *existing(const char *path, struct tmpfs_lookup *l)
+{
+    if (!lookup(path, l))
+    {
+        return NULL;
+    }
+    if (!l->node)
+    {
+        errno = ENOENT;
+    }
+    return l->node;
+}
+
+/* -------------------------------------------------------------------------
+ * Nodes.
+ * ------------------------------------------------------------------------- */
+
+static bool reserve_entries(struct tmpfs_node *dir)
+{
+    if (dir->count < dir->cap)
+    {
+        return true;
+    }
+    size_t cap = dir->cap ? dir->cap * 2 : 8;
+    struct tmpfs_node **more = realloc(dir->entries, cap * sizeof(*more));
+    if (!more)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+    dir->entries = more;
+    dir->cap = cap;
+    return true;
+}
+
+static void attach(struct tmpfs_node *dir, struct tmpfs_node *n)
+{
+    time_t now = time(NULL);
+    n->parent = dir;
+    dir->entries[dir->count++] = n;
+    dir->mtime = dir->ctime = now;
+}
+
+static struct tmpfs_node *create(struct tmpfs_node *dir, const char *name, uint32_t hash, mode_t mode)
+{
+    struct tmpfs_node *n;
+
+    if (!reserve_entries(dir))
+    {
+        return NULL;
+    }
+    if (!(n = calloc(1, sizeof(*n))) || !(n->name = strdup(name)))
+    {
+        free(n);
+        errno = ENOMEM;
+        return NULL;
+    }
+    n->hash = hash;
+    n->ino = next_ino++;
+    n->mode = mode;
+    n->mtime = n->ctime = n->atime = time(NULL);
+    attach(dir, n);
+    return n;
+}
+
+// Take n out of its directory. Streams reading that directory keep their
+// place in it.
+static void detach(struct tmpfs_node *n)
+{
+    struct tmpfs_node *dir = n->parent;
+    size_t i = 0;
+
+    while (dir->entries[i] != n)
+    {
+        i++;
+    }
+    memmove(&dir->entries[i], &dir->entries[i + 1], (dir->count - i - 1) * sizeof(*dir->entries));
+    dir->count--;
+    for (struct tmpfs_dir *d = open_dirs; d; d = d->next)
+    {
+        if (d->node == dir && d->pos > i + 2)
+        {
+            d->pos--;
+        }
+    }
+    dir->mtime = dir->ctime = time(NULL);
+    n->parent = NULL;
+}
+
+static void free_chunks(struct tmpfs_node *n, size_t from)
+{
+    for (size_t i = from; i < n->nchunks; i++)
+    {
+        used -= n->chunks[i].cap;
+        n->bytes -= n->chunks[i].cap;
+        free(n->chunks[i].data);
+        n->chunks[i].data = NULL;
+        n->chunks[i].cap = 0;
+    }
+}
+
+// Free n if it is unlinked and nothing has it open.
+static void release(struct tmpfs_node *n)
+{
+    if (n == &root || n->parent || n->refs)
+    {
+        return;
+    }
+    free_chunks(n, 0);
+    free(n->chunks);
+    free(n->entries);
+    free(n->name);
+    free(n);
+}
+
+/* -------------------------------------------------------------------------
+ * File data.
+ * ------------------------------------------------------------------------- */
+
+static bool reserve_chunks(struct tmpfs_node *n, size_t count)
+{
+    if (count <= n->nchunks)
+    {
+        return true;
+    }
+    size_t cap = n->nchunks ? n->nchunks : 4;
+    while (cap < count)
+    {
+        cap *= 2;
+    }
+    struct tmpfs_chunk *more = realloc(n->chunks, cap * sizeof(*more));
+    if (!more)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+    memset(more + n->nchunks, 0, (cap - n->nchunks) * sizeof(*more));
+    n->chunks = more;
+    n->nchunks = cap;
+    return true;
+}
+
+// Grow chunk c of n to hold at least end bytes, within the size cap.
+static bool reserve(struct tmpfs_node *n, struct tmpfs_chunk *c, size_t end)
+{
+    if (end <= c->cap)
+    {
+        return true;
+    }
+    size_t cap = c->cap ? c->cap : TMPFS_MIN_CHUNK;
+    while (cap < end)
+    {
+        cap *= 2;
+    }
+    if (cap - c->cap > limit - used)
+    {
+        errno = ENOSPC;
+        return false;
+    }
+    unsigned char *data = realloc(c->data, cap);
+    if (!data)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+    memset(data + c->cap, 0, cap - c->cap);
+    used += cap - c->cap;
+    n->bytes += cap - c->cap;
+    if (used > peak)
+    {
+        peak = used;
+    }
+    c->data = data;
+    c->cap = cap;
+    return true;
+}
+
+static ssize_t write_at(struct tmpfs_node *n, const unsigned char *buf, size_t count, off_t off)
+{
+    size_t done = 0;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (off > TMPFS_MAX_FILE - (off_t)count)
+    {
+        errno = EFBIG;
+        return -1;
+    }
+    if (!reserve_chunks(n, (((size_t)off + count - 1) >> TMPFS_CHUNK_SHIFT) + 1))
+    {
+        return -1;
+    }
+    while (done < count)
+    {
+        size_t at = (size_t)off + done;
+        size_t in = at & (TMPFS_CHUNK_SIZE - 1);
+        size_t len = TMPFS_CHUNK_SIZE - in;
+        struct tmpfs_chunk *c = &n->chunks[at >> TMPFS_CHUNK_SHIFT];
+        if (len > count - done)
+        {
+            len = count - done;
+        }
+        if (!reserve(n, c, in + len))
+        {
+            break;
+        }
+        memcpy(c->data + in, buf + done, len);
+        done += len;
+    }
+    if (done == 0)
+    {
+        return -1;
+    }
+    if (off + (off_t)done > n->size)
+    {
+        n->size = off + (off_t)done;
+    }
+    n->mtime = n->ctime = time(NULL);
+    return (ssize_t)done;
+}
+
+static ssize_t read_at(const struct tmpfs_node *n, unsigned char *buf, size_t count, off_t off)
+{
+    size_t done = 0;
+
+    if (off >= n->size)
+    {
+        return 0;
+    }
+    if ((off_t)count > n->size - off)
+    {
+        count = (size_t)(n->size - off);
+    }
+    while (done < count)
+    {
+        size_t at = (size_t)off + done;
+        size_t idx = at >> TMPFS_CHUNK_SHIFT;
+        size_t in = at & (TMPFS_CHUNK_SIZE - 1);
+        size_t len = TMPFS_CHUNK_SIZE - in;
+        size_t have = 0;
+        if (len > count - done)
+        {
+            len = count - done;
+        }
+        if (idx < n->nchunks && in < n->chunks[idx].cap)
+        {
+            have = n->chunks[idx].cap - in;
+            if (have > len)
+            {
+                have = len;
+            }
+            memcpy(buf + done, n->chunks[idx].data + in, have);
+        }
+        memset(buf + done + have, 0, len - have);
+        done += len;
+    }
+    return (ssize_t)done;
+}
+
+static int truncate_node(struct tmpfs_node *n, off_t length)
+{
+    if (S_ISDIR(n->mode))
+    {
+        errno = EISDIR;
+        return -1;
+    }
+    if (length < 0 || length > TMPFS_MAX_FILE)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (length < n->size)
+    {
+        // Bytes past the end must read as zero if the file grows again.
+        size_t keep = ((size_t)length + TMPFS_CHUNK_SIZE - 1) >> TMPFS_CHUNK_SHIFT;
+        size_t in = (size_t)length & (TMPFS_CHUNK_SIZE - 1);
+        free_chunks(n, keep);
+        if (in && keep - 1 < n->nchunks && in < n->chunks[keep - 1].cap)
+        {
+            memset(n->chunks[keep - 1].data + in, 0, n->chunks[keep - 1].cap - in);
+        }
+    }
+    n->size = length;
+    n->mtime = n->ctime = time(NULL);
+    return 0;
+}
+
+static void fill_stat(const struct tmpfs_node *n, struct stat *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->st_dev = TMPFS_DEV;
+    st->st_ino = n->ino;
+    st->st_mode = n->mode;
+    st->st_nlink = S_ISDIR(n->mode) ? 2 : (n->parent ? 1 : 0);
+    st->st_size = n->size;
+    st->st_blksize = 4096;
+    st->st_blocks = (blkcnt_t)(n->bytes / 512);
+    st->st_atim.tv_sec = n->atime;
+    st->st_mtim.tv_sec = n->mtime;
+    st->st_ctim.tv_sec = n->ctime;
+}
+
+/* -------------------------------------------------------------------------
+ * Descriptors.
+ * ------------------------------------------------------------------------- */
+
+static bool readable(int flags)
+{
+    return (flags & O_ACCMODE) == O_RDONLY || (flags & O_ACCMODE) == O_RDWR;
+}
+
+static bool writable(int flags)
+{
+    return (flags & O_ACCMODE) == O_WRONLY || (flags & O_ACCMODE) == O_RDWR;
+}
+
+static struct tmpfs_file *file_for(int fd)
+{
+    struct tmpfs_file *f = NULL;
+    if (fd >= ZEROPERL_TMPFS_FD_BASE && fd < ZEROPERL_TMPFS_FD_BASE + ZEROPERL_TMPFS_MAX_OPEN)
+    {
+        f = &files[fd - ZEROPERL_TMPFS_FD_BASE];
+    }
+    if (!f || !f->node)
+    {
+        errno = EBADF;
+        return NULL;
+    }
+    return f;
+}
+
+bool zeroperl_tmpfs_path(const char *path)
+{
+    char abs[TMPFS_PATH_MAX];
+    bool slash;
+    int saved_errno = errno;
+    bool ours = zeroperl_tmpfs_mounted && path && normalize(abs, path, &slash) && below_mount(abs);
+    errno = saved_errno;
+    return ours;
+}
+
+int zeroperl_tmpfs_open(const char *path, int flags, int mode)
+{
+    struct tmpfs_lookup l;
+    struct tmpfs_node *n;
+    int fd = -1;
+
+    ZEROPERL_LOCK(tmpfs_lock);
+    if (!lookup(path, &l))
+    {
+        goto out;
+    }
+    n = l.node;
+    if (!n)
+    {
+        if (!(flags & O_CREAT))
+        {
+            errno = ENOENT;
+            goto out;
+        }
+        if (l.slash)
+        {
+            errno = EISDIR;
+            goto out;
+        }
+        if (!(n = create(l.parent, l.name, l.hash, S_IFREG | (mode & 07777))))
+        {
+            goto out;
+        }
+    }
+    else if ((flags & O_CREAT) && (flags & O_EXCL))
+    {
+        errno = EEXIST;
+        goto out;
+    }
+    else if (S_ISDIR(n->mode) && writable(flags))
+    {
+        errno = EISDIR;
+        goto out;
+    }
+    else if (!S_ISDIR(n->mode) && (flags & O_DIRECTORY))
+    {
+        errno = ENOTDIR;
+        goto out;
+    }
+
+    for (int i = 0; i < ZEROPERL_TMPFS_MAX_OPEN; i++)
+    {
+        if (!files[i].node)
+        {
+            if ((flags & O_TRUNC) && writable(flags) && n->size)
+            {
+                truncate_node(n, 0);
+            }
+            files[i].node = n;
+            files[i].pos = 0;
+            files[i].flags = flags;
+            n->refs++;
+            fd = ZEROPERL_TMPFS_FD_BASE + i;
+            goto out;
+        }
+    }
+    errno = EMFILE;
+out:
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return fd;
+}
+
+int zeroperl_tmpfs_close(int fd)
+{
+    int r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    struct tmpfs_file *f = file_for(fd);
+    if (f)
+    {
+        struct tmpfs_node *n = f->node;
+        f->node = NULL;
+        n->refs--;
+        release(n);
+        r = 0;
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+ssize_t zeroperl_tmpfs_read(int fd, void *buf, size_t count)
+{
+    ssize_t r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    struct tmpfs_file *f = file_for(fd);
+    if (f && S_ISDIR(f->node->mode))
+    {
+        errno = EISDIR;
+    }
+    else if (f && !readable(f->flags))
+    {
+        errno = EBADF;
+    }
+    else if (f)
+    {
+        r = read_at(f->node, buf, count, f->pos);
+        f->pos += r;
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+ssize_t zeroperl_tmpfs_write(int fd, const void *buf, size_t count)
+{
+    ssize_t r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    struct tmpfs_file *f = file_for(fd);
+    if (f && !writable(f->flags))
+    {
+        errno = EBADF;
+    }
+    else if (f)
+    {
+        if (f->flags & O_APPEND)
+        {
+            f->pos = f->node->size;
+        }
+        r = write_at(f->node, buf, count, f->pos);
+        if (r > 0)
+        {
+            f->pos += r;
+        }
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+ssize_t zeroperl_tmpfs_pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+    ssize_t r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    struct tmpfs_file *f = file_for(fd);
+    if (f && !writable(f->flags))
+    {
+        errno = EBADF;
+    }
+    else if (f && offset < 0)
+    {
+        errno = EINVAL;
+    }
+    else if (f)
+    {
+        r = write_at(f->node, buf, count, offset);
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+off_t zeroperl_tmpfs_lseek(int fd, off_t offset, int whence)
+{
+    off_t pos = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    struct tmpfs_file *f = file_for(fd);
+    if (f)
+    {
+        off_t base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? f->pos : whence == SEEK_END ? f->node->size : -1;
+        if (base < 0 || offset < -base || offset > TMPFS_MAX_FILE - base)
+        {
+            errno = EINVAL;
+        }
+        else
+        {
+            pos = f->pos = base + offset;
+        }
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return pos;
+}
+
+int zeroperl_tmpfs_ftruncate(int fd, off_t length)
+{
+    int r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    struct tmpfs_file *f = file_for(fd);
+    if (f && !writable(f->flags))
+    {
+        errno = EINVAL;
+    }
+    else if (f)
+    {
+        r = truncate_node(f->node, length);
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+int zeroperl_tmpfs_fstat(int fd, struct stat *st)
+{
+    int r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    struct tmpfs_file *f = file_for(fd);
+    if (f)
+    {
+        fill_stat(f->node, st);
+        r = 0;
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+/* -------------------------------------------------------------------------
+ * Paths.
+ * ------------------------------------------------------------------------- */
+
+int zeroperl_tmpfs_stat(const char *path, struct stat *st)
+{
+    struct tmpfs_lookup l;
+    struct tmpfs_node *n;
+    int r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    if ((n = existing(path, &l)))
+    {
+        fill_stat(n, st);
+        r = 0;
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+int zeroperl_tmpfs_access(const char *path, int amode)
+{
+    struct tmpfs_lookup l;
+    struct tmpfs_node *n;
+    int r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    n = existing(path, &l);
+    if (n && (amode & X_OK) && !S_ISDIR(n->mode) && !(n->mode & 0111))
+    {
+        errno = EACCES;
+    }
+    else if (n)
+    {
+        r = 0;
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+int zeroperl_tmpfs_truncate(const char *path, off_t length)
+{
+    struct tmpfs_lookup l;
+    struct tmpfs_node *n;
+    int r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    if ((n = existing(path, &l)))
+    {
+        r = truncate_node(n, length);
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+int zeroperl_tmpfs_mkdir(const char *path, mode_t mode)
+{
+    struct tmpfs_lookup l;
+    int r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    bool found = lookup(path, &l);
+    if (found && l.node)
+    {
+        errno = EEXIST;
+    }
+    else if (found && create(l.parent, l.name, l.hash, S_IFDIR | (mode & 07777)))
+    {
+        r = 0;
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+int zeroperl_tmpfs_unlink(const char *path)
+{
+    struct tmpfs_lookup l;
+    struct tmpfs_node *n;
+    int r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    n = existing(path, &l);
+    if (n && S_ISDIR(n->mode))
+    {
+        errno = EISDIR;
+    }
+    else if (n)
+    {
+        detach(n);
+        release(n);
+        r = 0;
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+int zeroperl_tmpfs_rmdir(const char *path)
+{
+    struct tmpfs_lookup l;
+    struct tmpfs_node *n;
+    int r = -1;
+    ZEROPERL_LOCK(tmpfs_lock);
+    n = existing(path, &l);
+    if (n && !S_ISDIR(n->mode))
+    {
+        errno = ENOTDIR;
+    }
+    else if (n == &root)
+    {
+        errno = EBUSY;
+    }
+    else if (n && n->count)
+    {
+        errno = ENOTEMPTY;
+    }
+    else if (n)
+    {
+        detach(n);
+        release(n);
+        r = 0;
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+int zeroperl_tmpfs_rename(const char *from, const char *to)
+{
+    struct tmpfs_lookup src, dst;
+    struct tmpfs_node *n, *old;
+    char *name = NULL;
+    int r = -1;
+
+    ZEROPERL_LOCK(tmpfs_lock);
+    if (!lookup(from, &src) || !lookup(to, &dst))
+    {
+        goto out;
+    }
+    n = src.node;
+    old = dst.node;
+    if (!n)
+    {
+        errno = ENOENT;
+        goto out;
+    }
+    if (n == &root || old == &root)
+    {
+        errno = EBUSY;
+        goto out;
+    }
+    if (old == n)
+    {
+        r = 0;
+        goto out;
+    }
+    if (S_ISDIR(n->mode))
+    {
+        // Not into itself or below.
+        for (struct tmpfs_node *p = dst.parent; p; p = p->parent)
+        {
+            if (p == n)
+            {
+                errno = EINVAL;
+                goto out;
+            }
+        }
+        if (old && !S_ISDIR(old->mode))
+        {
+            errno = ENOTDIR;
+            goto out;
+        }
+        if (old && old->count)
+        {
+            errno = ENOTEMPTY;
+            goto out;
+        }
+    }
+    else if (old && S_ISDIR(old->mode))
+    {
+        errno = EISDIR;
+        goto out;
+    }
+    else if (dst.slash)
+    {
+        errno = ENOTDIR;
+        goto out;
+    }
+    if (!(name = strdup(dst.name)) || !reserve_entries(dst.parent))
+    {
+        free(name);
+        errno = ENOMEM;
+        goto out;
+    }
+
+    if (old)
+    {
+        detach(old);
+        release(old);
+    }
+    detach(n);
+    free(n->name);
+    n->name = name;
+    n->hash = dst.hash;
+    n->ctime = time(NULL);
+    attach(dst.parent, n);
+    r = 0;
+out:
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+int zeroperl_tmpfs_chdir(const char *path)
+{
+    struct tmpfs_lookup l;
+    struct tmpfs_node *n;
+    bool slash;
+    int r = -1;
+
+    if (!zeroperl_tmpfs_path(path))
+    {
+        // Back to the host, which would resolve a relative path against
+        // the cwd it had before the tmpfs.
+        if (cwd_inside && !normalize(l.abs, path, &slash))
+        {
+            return -1;
+        }
+        r = __real_chdir(cwd_inside ? l.abs : path);
+        if (r == 0)
+        {
+            cwd_inside = false;
+        }
+        return r;
+    }
+    ZEROPERL_LOCK(tmpfs_lock);
+    n = existing(path, &l);
+    if (n && !S_ISDIR(n->mode))
+    {
+        errno = ENOTDIR;
+    }
+    else if (n && normalize(cwd, path, &slash))
+    {
+        cwd_inside = true;
+        r = 0;
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return r;
+}
+
+const char *zeroperl_tmpfs_cwd(void)
+{
+    return cwd_inside ? cwd : NULL;
+}
+
+/* -------------------------------------------------------------------------
+ * Directory streams.
+ * ------------------------------------------------------------------------- */
+
+DIR *zeroperl_tmpfs_opendir(const char *path)
+{
+    struct tmpfs_lookup l;
+    struct tmpfs_node *n;
+    struct tmpfs_dir *d = NULL;
+    ZEROPERL_LOCK(tmpfs_lock);
+    n = existing(path, &l);
+    if (n && !S_ISDIR(n->mode))
+    {
+        errno = ENOTDIR;
+    }
+    else if (n && !(d = calloc(1, sizeof(*d))))
+    {
+        errno = ENOMEM;
+    }
+    else if (n)
+    {
+        d->node = n;
+        n->refs++;
+        d->next = open_dirs;
+        open_dirs = d;
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return (DIR *)d;
+}
+
+bool zeroperl_tmpfs_dir(DIR *dir)
+{
+    struct tmpfs_dir *d = NULL;
+    if (!zeroperl_tmpfs_mounted)
+    {
+        return false;
+    }
+    ZEROPERL_LOCK(tmpfs_lock);
+    for (d = open_dirs; d; d = d->next)
+    {
+        if ((DIR *)d == dir)
+        {
+            break;
+        }
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return d != NULL;
+}
+
+struct dirent *zeroperl_tmpfs_readdir(DIR *dir)
+{
+    struct tmpfs_dir *d = (struct tmpfs_dir *)dir;
+    struct dirent *ent = NULL;
+    const struct tmpfs_node *n = NULL;
+    const char *name = NULL;
+
+    ZEROPERL_LOCK(tmpfs_lock);
+    if (d->pos == 0)
+    {
+        n = d->node;
+        name = ".";
+    }
+    else if (d->pos == 1)
+    {
+        n = d->node->parent ? d->node->parent : d->node;
+        name = "..";
+    }
+    else if (d->pos - 2 < d->node->count)
+    {
+        n = d->node->entries[d->pos - 2];
+        name = n->name;
+    }
+    if (n)
+    {
+        d->pos++;
+        d->out.ent.d_ino = n->ino;
+        d->out.ent.d_type = S_ISDIR(n->mode) ? DT_DIR : DT_REG;
+        strcpy(d->out.ent.d_name, name);
+        ent = &d->out.ent;
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return ent;
+}
+
+int zeroperl_tmpfs_closedir(DIR *dir)
+{
+    ZEROPERL_LOCK(tmpfs_lock);
+    for (struct tmpfs_dir **p = &open_dirs; *p; p = &(*p)->next)
+    {
+        if ((DIR *)*p == dir)
+        {
+            struct tmpfs_dir *d = *p;
+            *p = d->next;
+            d->node->refs--;
+            release(d->node);
+            free(d);
+            break;
+        }
+    }
+    ZEROPERL_UNLOCK(tmpfs_lock);
+    return 0;
+}
+
+long zeroperl_tmpfs_telldir(DIR *dir)
+{
+    return (long)((struct tmpfs_dir *)dir)->pos;
+}
+
+void zeroperl_tmpfs_seekdir(DIR *dir, long loc)
+{
+    ZEROPERL_LOCK(tmpfs_lock);
+    ((struct tmpfs_dir *)dir)->pos = loc < 0 ? 0 : (size_t)loc;
+    ZEROPERL_UNLOCK(tmpfs_lock);
+}
+
+/* -------------------------------------------------------------------------
+ * fopen(), through a stdio cookie over a tmpfs descriptor.
+ * ------------------------------------------------------------------------- */
+
+static ssize_t cookie_read(void *cookie, char *buf, size_t size)
+{
+    return zeroperl_tmpfs_read((int)(intptr_t)cookie, buf, size);
+}
+
+static ssize_t cookie_write(void *cookie, const char *buf, size_t size)
+{
+    ssize_t r = zeroperl_tmpfs_write((int)(intptr_t)cookie, buf, size);
+    return r < 0 ? 0 : r;
+}
+
+static int cookie_seek(void *cookie, off_t *offset, int whence)
+{
+    off_t pos = zeroperl_tmpfs_lseek((int)(intptr_t)cookie, *offset, whence);
+    if (pos < 0)
+    {
+        return -1;
+    }
+    *offset = pos;
+    return 0;
+}
+
+static int cookie_close(void *cookie)
+{
+    return zeroperl_tmpfs_close((int)(intptr_t)cookie);
+}
+
+FILE *zeroperl_tmpfs_fopen(const char *path, const char *mode)
+{
+    static const cookie_io_functions_t io = {cookie_read, cookie_write, cookie_seek, cookie_close};
+    bool plus = strchr(mode, '+') != NULL;
+    int flags;
+    int fd;
+    FILE *fp;
+
+    switch (mode[0])
+    {
+    case 'r':
+        flags = plus ? O_RDWR : O_RDONLY;
+        break;
+    case 'w':
+        flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+        break;
+    case 'a':
+        flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+        break;
+    default:
+        errno = EINVAL;
+        return NULL;
+    }
+    if (strchr(mode, 'x'))
+    {
+        flags |= O_EXCL;
+    }
+    if ((fd = zeroperl_tmpfs_open(path, flags, 0666)) < 0)
+    {
+        return NULL;
+    }
+    if (!(fp = fopencookie((void *)(intptr_t)fd, mode, io)))
+    {
+        zeroperl_tmpfs_close(fd);
+    }
+    return fp;
+}
+
+/* -------------------------------------------------------------------------
+ * Setup.
+ * ------------------------------------------------------------------------- */
+
+void zeroperl_tmpfs_usage(size_t *used_out, size_t *peak_out, size_t *limit_out)
+{
+    ZEROPERL_LOCK(tmpfs_lock);
+    *used_out = used;
+    *peak_out = peak;
+    *limit_out = zeroperl_tmpfs_mounted ? limit : 0;
+    ZEROPERL_UNLOCK(tmpfs_lock);
+}
+
+__attribute__((constructor)) static void zeroperl_tmpfs_init(void)
+{
+    const char *dir = getenv("ZEROPERL_TMPFS");
+    const char *size = getenv("ZEROPERL_TMPFS_SIZE");
+    bool slash;
+
+    if (!dir || !*dir || !normalize(mount_point, dir, &slash))
+    {
+        return;
+    }
+    mount_len = strlen(mount_point);
+    limit = size && *size ? zeroperl_parse_size(size) : TMPFS_DEFAULT_SIZE;
+    root.ino = 1;
+    root.mode = S_IFDIR | 01777;
+    root.mtime = root.ctime = root.atime = time(NULL);
+    zeroperl_tmpfs_mounted = true;
+}
@@ -0,0 +1,70 @@
+#ifndef ZEROPERL_TMPFS_H
+#define ZEROPERL_TMPFS_H
+
+#include <dirent.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// Writable in-memory file system mounted at ZEROPERL_TMPFS, see tmpfs.c.
+// Its descriptors are numbered from ZEROPERL_TMPFS_FD_BASE, well above the
+// ones the host hands out and below the pipes of tools/proc.mjs (1024).
+#ifndef ZEROPERL_TMPFS_FD_BASE
+#define ZEROPERL_TMPFS_FD_BASE 768
+#endif
+#ifndef ZEROPERL_TMPFS_MAX_OPEN
+#define ZEROPERL_TMPFS_MAX_OPEN 256
+#endif
+
+extern bool zeroperl_tmpfs_mounted;
+
+// True if fd is in the tmpfs range, whether or not it is open.
+static inline bool zeroperl_tmpfs_fd(int fd)
+{
+    return zeroperl_tmpfs_mounted && fd >= ZEROPERL_TMPFS_FD_BASE &&
+           fd < ZEROPERL_TMPFS_FD_BASE + ZEROPERL_TMPFS_MAX_OPEN;
+}
+
+// True if path, made absolute, is the mount point or below it.
+bool zeroperl_tmpfs_path(const char *path);
+
+// Each function behaves like the libc call it is named after, for paths
+// accepted by zeroperl_tmpfs_path() and descriptors it returned.
+int zeroperl_tmpfs_open(const char *path, int flags, int mode);
+FILE *zeroperl_tmpfs_fopen(const char *path, const char *mode);
+int zeroperl_tmpfs_close(int fd);
+ssize_t zeroperl_tmpfs_read(int fd, void *buf, size_t count);
+ssize_t zeroperl_tmpfs_write(int fd, const void *buf, size_t count);
+ssize_t zeroperl_tmpfs_pwrite(int fd, const void *buf, size_t count, off_t offset);
+off_t zeroperl_tmpfs_lseek(int fd, off_t offset, int whence);
+int zeroperl_tmpfs_ftruncate(int fd, off_t length);
+int zeroperl_tmpfs_fstat(int fd, struct stat *st);
+int zeroperl_tmpfs_stat(const char *path, struct stat *st);
+int zeroperl_tmpfs_access(const char *path, int amode);
+int zeroperl_tmpfs_truncate(const char *path, off_t length);
+int zeroperl_tmpfs_rename(const char *from, const char *to);
+int zeroperl_tmpfs_unlink(const char *path);
+int zeroperl_tmpfs_mkdir(const char *path, mode_t mode);
+int zeroperl_tmpfs_rmdir(const char *path);
+
+// chdir() for any path while the tmpfs is mounted: the host only sees the
+// ones outside it. zeroperl_tmpfs_cwd() is the tmpfs directory chdir() last
+// went to, or NULL if the cwd is on the host.
+int zeroperl_tmpfs_chdir(const char *path);
+const char *zeroperl_tmpfs_cwd(void);
+
+// Directory streams. zeroperl_tmpfs_dir() tells whether dir came from
+// zeroperl_tmpfs_opendir(); the others only accept such streams.
+DIR *zeroperl_tmpfs_opendir(const char *path);
+bool zeroperl_tmpfs_dir(DIR *dir);
+struct dirent *zeroperl_tmpfs_readdir(DIR *dir);
+int zeroperl_tmpfs_closedir(DIR *dir);
+long zeroperl_tmpfs_telldir(DIR *dir);
+void zeroperl_tmpfs_seekdir(DIR *dir, long loc);
+
+// Bytes held by file data now and at most, and the ZEROPERL_TMPFS_SIZE cap.
+void zeroperl_tmpfs_usage(size_t *used, size_t *peak, size_t *limit);
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ I/O call tracing.
+
+ Every open, fopen, close, read, lseek, stat, lstat, fstat and access made
+ through the wrappers in zeroperl.c can be recorded, with its path or fd,
+ whether the SFS, the tmpfs, the read-ahead cache or the host answered it,
+ its argument (flags, byte count, whence or mode), its result and errno, and
+ how long it took.
+ This is meant for finding redundant opens, tiny reads and storms of
+ failing lookups in real scripts, without a rebuild.
+
+ Records are 64 bytes (struct zeroperl_trace_record) and go into a ring in
+ linear memory. Hosts can drain it directly: zeroperl_trace_start(capacity)
+ turns tracing on and returns the ring header, zeroperl_trace_stop() turns
+ it off again. tools/trace.mjs decodes the records and reports on them.
+
+ From the command line, ZEROPERL_TRACE=1 traces from startup and prints a
+ summary to stderr at exit, and ZEROPERL_TRACE_FILE=<path> additionally
+ writes every record to that file whenever the ring fills up, and at exit.
+ ZEROPERL_TRACE_RECORDS sets the ring size (default 4096 records).
+
+ When tracing is off, each wrapped call costs one load and a branch.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "lock.h"
+#include "trace.h"
+
+#define TRACE_DEFAULT_RECORDS 4096
+// Reads that return less than this are counted as tiny in the summary.
+#define TRACE_TINY_READ 512
+
+// The trace file bypasses the wrappers, so it is neither traced nor
+// looked up in the SFS.
+extern int __real_open(const char *path, int flags, ...);
+extern int __real_close(int fd);
+
+volatile int zeroperl_trace_on;
+
+static struct zeroperl_trace_ring trace_ring;
+static struct zeroperl_trace_record *trace_records;
+static int trace_file = -1;
+
+// Totals for the summary, kept for every call whether or not its record
+// survives in the ring.
+static struct
+{
+    uint32_t calls[ZEROPERL_TRACE_OPS][ZEROPERL_TRACE_ROUTES];
+    uint32_t failed[ZEROPERL_TRACE_OPS];
+    uint32_t missing[ZEROPERL_TRACE_OPS]; // failed with ENOENT
+    uint64_t ns[ZEROPERL_TRACE_OPS];
+    uint64_t read_bytes;
+    uint32_t tiny_reads;
+} trace_totals;
+
+static const char *const trace_op_names[ZEROPERL_TRACE_OPS] = {
+    [ZEROPERL_TRACE_OPEN] = "open",
+    [ZEROPERL_TRACE_FOPEN] = "fopen",
+    [ZEROPERL_TRACE_CLOSE] = "close",
+    [ZEROPERL_TRACE_READ] = "read",
+    [ZEROPERL_TRACE_LSEEK] = "lseek",
+    [ZEROPERL_TRACE_STAT] = "stat",
+    [ZEROPERL_TRACE_LSTAT] = "lstat",
+    [ZEROPERL_TRACE_FSTAT] = "fstat",
+    [ZEROPERL_TRACE_ACCESS] = "access",
+};
+
+ZEROPERL_MUTEX(trace_lock);
+
+uint64_t zeroperl_trace_now(void)
+{
+    struct timespec ts;
+    uint64_t ns;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ns = (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+    // 0 means "not traced" to zeroperl_trace().
+    return ns ? ns : 1;
+}
+
+static uint32_t trace_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+    while (*s)
+    {
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    }
+    return h;
+}
+
+// Write records [read, written) to the trace file. Called with the lock held.
+static void trace_flush(void)
+{
+    while (trace_file >= 0 && trace_ring.read < trace_ring.written)
+    {
+        uint32_t at = (uint32_t)(trace_ring.read % trace_ring.capacity);
+        uint64_t n = trace_ring.written - trace_ring.read;
+        if (n > trace_ring.capacity - at)
+        {
+            n = trace_ring.capacity - at;
+        }
+        if (write(trace_file, &trace_records[at], (size_t)n * sizeof(*trace_records)) < 0)
+        {
+            __real_close(trace_file);
+            trace_file = -1;
+            return;
+        }
+        trace_ring.read += n;
+    }
+}
+
+void zeroperl_trace_record(int op, int route, const char *path, int fd, uint32_t arg, int64_t result, uint64_t start)
+{
+    int saved_errno = errno;
+    uint64_t elapsed = zeroperl_trace_now() - start;
+    struct zeroperl_trace_record *r;
+
+    ZEROPERL_LOCK(trace_lock);
+    if (!trace_records)
+    {
+        ZEROPERL_UNLOCK(trace_lock);
+        return;
+    }
+    trace_totals.calls[op][route]++;
+    trace_totals.ns[op] += elapsed;
+    if (result < 0)
+    {
+        trace_totals.failed[op]++;
+        if (saved_errno == ENOENT)
+        {
+            trace_totals.missing[op]++;
+        }
+    }
+    else if (op == ZEROPERL_TRACE_READ)
+    {
+        trace_totals.read_bytes += (uint64_t)result;
+        if (result < TRACE_TINY_READ)
+        {
+            trace_totals.tiny_reads++;
+        }
+    }
+
+    if (trace_ring.written - trace_ring.read == trace_ring.capacity)
+    {
+        trace_flush();
+        if (trace_ring.written - trace_ring.read == trace_ring.capacity)
+        {
+            trace_ring.read++;
+            trace_ring.dropped++;
+        }
+    }
+    r = &trace_records[trace_ring.written % trace_ring.capacity];
+    memset(r, 0, sizeof(*r));
+    r->start_ns = start;
+    r->result = result;
+    r->elapsed_ns = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+    r->arg = arg;
+    r->fd = fd;
+    r->error = result < 0 ? (uint16_t)saved_errno : 0;
+    r->op = (uint8_t)op;
+    r->route = (uint8_t)route;
+    if (path)
+    {
+        size_t len = strlen(path);
+        size_t tail = len < sizeof(r->path) - 1 ? len : sizeof(r->path) - 1;
+        r->path_hash = trace_hash(path);
+        memcpy(r->path, path + len - tail, tail);
+    }
+    trace_ring.written++;
+    ZEROPERL_UNLOCK(trace_lock);
+    errno = saved_errno;
+}
+
+__attribute__((export_name("zeroperl_trace_start")))
+const struct zeroperl_trace_ring *zeroperl_trace_start(uint32_t capacity)
+{
+    ZEROPERL_LOCK(trace_lock);
+    if (!trace_records)
+    {
+        trace_ring.capacity = capacity ? capacity : TRACE_DEFAULT_RECORDS;
+        trace_records = calloc(trace_ring.capacity, sizeof(*trace_records));
+        if (!trace_records)
+        {
+            ZEROPERL_UNLOCK(trace_lock);
+            return NULL;
+        }
+        trace_ring.magic = ZEROPERL_TRACE_MAGIC;
+        trace_ring.version = ZEROPERL_TRACE_VERSION;
+        trace_ring.record_size = sizeof(*trace_records);
+        trace_ring.records = (uint32_t)(uintptr_t)trace_records;
+    }
+    zeroperl_trace_on = 1;
+    ZEROPERL_UNLOCK(trace_lock);
+    return &trace_ring;
+}
+
+__attribute__((export_name("zeroperl_trace_stop")))
+void zeroperl_trace_stop(void)
+{
+    zeroperl_trace_on = 0;
+}
+
+void zeroperl_trace_report(int fd)
+{
+    char line[200];
+    int n;
+
+    ZEROPERL_LOCK(trace_lock);
+    for (int op = 1; op < ZEROPERL_TRACE_OPS; op++)
+    {
+        uint32_t sfs = trace_totals.calls[op][ZEROPERL_TRACE_SFS];
+        uint32_t host = trace_totals.calls[op][ZEROPERL_TRACE_HOST];
+        uint32_t tmpfs = trace_totals.calls[op][ZEROPERL_TRACE_TMPFS];
+        uint32_t cache = trace_totals.calls[op][ZEROPERL_TRACE_CACHE];
+        if (!sfs && !host && !tmpfs && !cache)
+        {
+            continue;
+        }
+        n = snprintf(line, sizeof(line), "trace: %-6s sfs %u tmpfs %u cache %u host %u, failed %u (ENOENT %u), %.3f ms\n",
+                     trace_op_names[op], sfs, tmpfs, cache, host, trace_totals.failed[op], trace_totals.missing[op],
+                     trace_totals.ns[op] / 1e6);
+        write(fd, line, (size_t)n);
+    }
+    n = snprintf(line, sizeof(line), "trace: read %llu bytes, %u reads under %d bytes\n",
+                 (unsigned long long)trace_totals.read_bytes, trace_totals.tiny_reads, TRACE_TINY_READ);
+    write(fd, line, (size_t)n);
+    n = snprintf(line, sizeof(line), "trace: %llu records, %llu dropped\n",
+                 (unsigned long long)trace_ring.written, (unsigned long long)trace_ring.dropped);
+    write(fd, line, (size_t)n);
+    ZEROPERL_UNLOCK(trace_lock);
+}
+
+static void zeroperl_trace_at_exit(void)
+{
+    zeroperl_trace_on = 0;
+    ZEROPERL_LOCK(trace_lock);
+    trace_flush();
+    ZEROPERL_UNLOCK(trace_lock);
+    zeroperl_trace_report(STDERR_FILENO);
+}
+
+__attribute__((constructor)) static void zeroperl_trace_init(void)
+{
+    const char *env = getenv("ZEROPERL_TRACE");
+    const char *file = getenv("ZEROPERL_TRACE_FILE");
+    const char *records = getenv("ZEROPERL_TRACE_RECORDS");
+
+    if (!(env && *env && strcmp(env, "0") != 0) && !(file && *file))
+    {
+        return;
+    }
+    if (file && *file)
+    {
+        // The header, so the file can be read without the module.
+        trace_file = __real_open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (trace_file >= 0)
+        {
+            struct zeroperl_trace_ring header = {
+                .magic = ZEROPERL_TRACE_MAGIC,
+                .version = ZEROPERL_TRACE_VERSION,
+                .record_size = sizeof(struct zeroperl_trace_record),
+            };
+            write(trace_file, &header, sizeof(header));
+        }
+    }
+    if (zeroperl_trace_start(records ? (uint32_t)strtoul(records, NULL, 10) : 0))
+    {
+        atexit(zeroperl_trace_at_exit);
+    }
+}
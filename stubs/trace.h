@@ -0,0 +1,90 @@
+#ifndef ZEROPERL_TRACE_H
+#define ZEROPERL_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Tracing of the wrapped I/O calls in zeroperl.c, see trace.c. Records and
+// the ring header are read directly by hosts (tools/trace.mjs), so only
+// append fields and bump ZEROPERL_TRACE_VERSION when the layout changes.
+#define ZEROPERL_TRACE_MAGIC 0x5254505a // "ZPTR"
+#define ZEROPERL_TRACE_VERSION 1
+#define ZEROPERL_TRACE_PATH_TAIL 28
+
+enum zeroperl_trace_op
+{
+    ZEROPERL_TRACE_OPEN = 1,
+    ZEROPERL_TRACE_FOPEN,
+    ZEROPERL_TRACE_CLOSE,
+    ZEROPERL_TRACE_READ,
+    ZEROPERL_TRACE_LSEEK,
+    ZEROPERL_TRACE_STAT,
+    ZEROPERL_TRACE_LSTAT,
+    ZEROPERL_TRACE_FSTAT,
+    ZEROPERL_TRACE_ACCESS,
+    ZEROPERL_TRACE_OPS
+};
+
+enum zeroperl_trace_route
+{
+    ZEROPERL_TRACE_SFS = 0,   // answered from the embedded file system
+    ZEROPERL_TRACE_HOST = 1,  // passed to WASI (possibly through fscache.c)
+    ZEROPERL_TRACE_TMPFS = 2, // answered from the in-memory tmpfs
+    ZEROPERL_TRACE_CACHE = 3, // host fd answered from the read-ahead cache
+    ZEROPERL_TRACE_ROUTES
+};
+
+// One call, 64 bytes.
+struct zeroperl_trace_record
+{
+    uint64_t start_ns;   // CLOCK_MONOTONIC at entry
+    int64_t result;      // return value: fd, bytes, offset, or 0/-1
+    uint32_t elapsed_ns;
+    uint32_t arg;        // open flags, read count, lseek whence or access mode
+    int32_t fd;          // the fd operated on, or opened; -1 if none
+    uint32_t path_hash;  // FNV-1a of the whole path, 0 for fd calls
+    uint16_t error;      // errno when result < 0
+    uint8_t op;          // enum zeroperl_trace_op
+    uint8_t route;       // enum zeroperl_trace_route
+    char path[ZEROPERL_TRACE_PATH_TAIL]; // last bytes of the path, NUL-terminated
+};
+
+// Header of the record ring. Record n is at records + (n % capacity). The
+// guest advances `written`; a host that drains the ring advances `read` to
+// it. When the ring is full the oldest record is dropped.
+struct zeroperl_trace_ring
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t capacity; // records
+    uint32_t records;  // address of the first record
+    uint64_t written;  // records ever written
+    uint64_t read;     // records consumed by the host or the trace file
+    uint64_t dropped;  // records overwritten before they were consumed
+};
+
+extern volatile int zeroperl_trace_on;
+
+uint64_t zeroperl_trace_now(void);
+void zeroperl_trace_record(int op, int route, const char *path, int fd, uint32_t arg, int64_t result, uint64_t start);
+
+// Zero when tracing is off, so a disabled trace costs one load per call.
+static inline uint64_t zeroperl_trace_begin(void)
+{
+    return zeroperl_trace_on ? zeroperl_trace_now() : 0;
+}
+
+static inline void zeroperl_trace(int op, int route, const char *path, int fd, uint32_t arg, int64_t result, uint64_t start)
+{
+    if (start)
+    {
+        zeroperl_trace_record(op, route, path, fd, arg, result, start);
+    }
+}
+
+// Write a summary of all calls traced so far to fd. Also done at exit when
+// ZEROPERL_TRACE is set in the environment.
+void zeroperl_trace_report(int fd);
+
+#endif
@@ -13,9 +13,18 @@
 #include <stdbool.h>
 #include "setjmp.h"
 #include "asyncify.h"
+#include "machine.h"
 #include "EXTERN.h"
 #include "perl.h"
 #include "XSUB.h"
+#include "profile.h"
+#include "fuel.h"
+#include "fscache.h"
+#include "memstats.h"
+#include "tmpfs.h"
+#include "readahead.h"
+#include "trace.h"
+#include "lock.h"
 #include "zeroperl.h" /* Must define SFS_BUILTIN_PREFIX, e.g. "builtin:" */
 
 #define STRINGIZE_HELPER(x) #x
@@ -67,6 +76,18 @@ extern off_t __real_lseek(int fd, off_t offset, int whence);
 extern int __real_access(const char *path, int flags);
 extern int __real_stat(const char *restrict path, struct stat *restrict statbuf);
 extern int __real_fstat(int fd, struct stat *statbuf);
+extern ssize_t __real_write(int fd, const void *buf, size_t count);
+extern ssize_t __real_pwrite(int fd, const void *buf, size_t count, off_t offset);
+extern int __real_ftruncate(int fd, off_t length);
+extern int __real_truncate(const char *path, off_t length);
+extern int __real_dup2(int oldfd, int newfd);
+extern int __real_fcntl(int fd, int cmd, ...);
+extern int __real_rename(const char *from, const char *to);
+extern int __real_unlink(const char *path);
+extern int __real_mkdir(const char *path, mode_t mode);
+extern int __real_rmdir(const char *path);
+extern int __real_chdir(const char *path);
+extern char *__real_getcwd(char *buf, size_t size);
 
 /* -------------------------------------------------------------------------
  * Compile-time configuration for file descriptor tracking.
@@ -82,8 +103,11 @@ extern int __real_fstat(int fd, struct stat *statbuf);
 /* We'll track usage of FDs in the range [0..FD_MAX_TRACK-1]. */
 static bool g_fd_in_use[FD_MAX_TRACK] = {false};
 
-/* Inline helpers to mark, free, or check FD usage.
-   (No concurrency locking, so not thread-safe.) */
+/* The FD map and the SFS table are shared by every interpreter in the
+   wasi-threads build; sfs_lock guards both. Elsewhere it is a no-op. */
+ZEROPERL_MUTEX(sfs_lock);
+
+/* Inline helpers to mark, free, or check FD usage. Callers hold sfs_lock. */
 static inline void fd_mark_in_use(int fd)
 {
     if (fd >= 0 && fd < FD_MAX_TRACK)
@@ -271,6 +295,7 @@ static int sfs_open(const char *path, FILE **outfp)
     }
 
     /* Find free slot in sfs_table. */
+    ZEROPERL_LOCK(sfs_lock);
     for (int i = 0; i < SFS_MAX_OPEN_FILES; i++)
     {
         if (!sfs_table[i].used)
@@ -280,11 +305,14 @@ static int sfs_open(const char *path, FILE **outfp)
             sfs_table[i].fd = newfd;
             sfs_table[i].fp = fp;
             sfs_table[i].size = size;
+            zeroperl_memory_sfs_open();
+            ZEROPERL_UNLOCK(sfs_lock);
             if (outfp)
                 *outfp = fp;
             return newfd;
         }
     }
+    ZEROPERL_UNLOCK(sfs_lock);
 
     /* If table is full => fail. */
     fclose(fp);
@@ -300,23 +328,29 @@ static int sfs_open(const char *path, FILE **outfp)
  * ------------------------------------------------------------------------- */
 static SFS_Result sfs_close(int fd)
 {
+    SFS_Result rc = SFS_OK;
+    ZEROPERL_LOCK(sfs_lock);
     SFS_Entry *e = sfs_find_by_fd(fd);
     if (!e)
     {
-        return SFS_NOT_OURS; /* not ours => fallback. */
+        rc = SFS_NOT_OURS; /* not ours => fallback. */
     }
-    if (!e->fp)
+    else if (!e->fp)
     {
-        return SFS_ERR;
+        rc = SFS_ERR;
     }
-
-    fclose(e->fp);
-    e->fp = NULL;
-    fd_mark_free(e->fd);
-    e->used = false;
-    e->fd = -1;
-    e->size = 0;
-    return SFS_OK;
+    else
+    {
+        fclose(e->fp);
+        e->fp = NULL;
+        fd_mark_free(e->fd);
+        e->used = false;
+        e->fd = -1;
+        e->size = 0;
+        zeroperl_memory_sfs_close();
+    }
+    ZEROPERL_UNLOCK(sfs_lock);
+    return rc;
 }
 
 /* -------------------------------------------------------------------------
@@ -324,12 +358,17 @@ static SFS_Result sfs_close(int fd)
  * ------------------------------------------------------------------------- */
 __attribute__((noinline)) static ssize_t sfs_read(int fd, void *buf, size_t count)
 {
+    ssize_t r = -1;
+    ZEROPERL_LOCK(sfs_lock);
     SFS_Entry *e = sfs_find_by_fd(fd);
-    if (!e || !e->fp)
+    if (e && e->fp)
     {
-        return -1;
+        size_t n = fread(buf, 1, count, e->fp);
+        zeroperl_memory_sfs_read(n);
+        r = (ssize_t)n;
     }
-    return (ssize_t)fread(buf, 1, count, e->fp);
+    ZEROPERL_UNLOCK(sfs_lock);
+    return r;
 }
 
 /* -------------------------------------------------------------------------
@@ -337,21 +376,15 @@ __attribute__((noinline)) static ssize_t sfs_read(int fd, void *buf, size_t coun
  * ------------------------------------------------------------------------- */
 static off_t sfs_lseek(int fd, off_t offset, int whence)
 {
+    long pos = -1;
+    ZEROPERL_LOCK(sfs_lock);
     SFS_Entry *e = sfs_find_by_fd(fd);
-    if (!e || !e->fp)
-    {
-        return (off_t)-1;
-    }
-    if (fseek(e->fp, (long)offset, whence) != 0)
-    {
-        return (off_t)-1;
-    }
-    long pos = ftell(e->fp);
-    if (pos < 0)
+    if (e && e->fp && fseek(e->fp, (long)offset, whence) == 0)
     {
-        return (off_t)-1;
+        pos = ftell(e->fp);
     }
-    return (off_t)pos;
+    ZEROPERL_UNLOCK(sfs_lock);
+    return pos < 0 ? (off_t)-1 : (off_t)pos;
 }
 
 /* -------------------------------------------------------------------------
@@ -407,32 +440,37 @@ static SFS_Stat_Result sfs_stat(const char *path, int fd, struct stat *stbuf)
     else
     {
         /* FD-based => check if FD is ours. */
+        ZEROPERL_LOCK(sfs_lock);
         SFS_Entry *e = sfs_find_by_fd(fd);
+        size_t size = e ? e->size : 0;
+        ZEROPERL_UNLOCK(sfs_lock);
         if (!e)
         {
             return SFS_STAT_NOT_OURS; /* not ours => fallback. */
         }
         /* It's ours => fill stbuf. */
         memset(stbuf, 0, sizeof(*stbuf));
-        stbuf->st_size = (off_t)e->size;
+        stbuf->st_size = (off_t)size;
         stbuf->st_mode = S_IFREG;
         return SFS_STAT_OURS;
     }
 }
 
 /* =========================================================================
- * Wrappers that always try SFS first, then fallback to real if that fails.
+ * Wrappers that always try SFS first, then the tmpfs, then fallback to real.
  * ========================================================================= */
 
 /* __wrap_fopen */
 __attribute__((noinline))
 FILE *__wrap_fopen(const char *path, const char *mode)
 {
+    uint64_t t0 = zeroperl_trace_begin();
     if (sfs_has_prefix(path))
     {
         /* Attempt SFS. */
         FILE *fp = NULL;
         int sfd = sfs_open(path, &fp);
+        zeroperl_trace(ZEROPERL_TRACE_FOPEN, ZEROPERL_TRACE_SFS, path, sfd, 0, sfd, t0);
         if (sfd >= 0)
         {
             /* SFS success => return that. */
@@ -441,17 +479,27 @@ FILE *__wrap_fopen(const char *path, const char *mode)
         /* No fallback => return NULL on failure. */
         return NULL;
     }
+    if (zeroperl_tmpfs_path(path))
+    {
+        FILE *fp = zeroperl_tmpfs_fopen(path, mode);
+        zeroperl_trace(ZEROPERL_TRACE_FOPEN, ZEROPERL_TRACE_TMPFS, path, -1, 0, fp ? 0 : -1, t0);
+        return fp;
+    }
 
     /* Otherwise => real fopen. */
     FILE *realfp = __real_fopen(path, mode);
+    int realfd = -1;
     if (realfp)
     {
-        int realfd = fileno(realfp);
+        realfd = fileno(realfp);
         if (realfd >= 0 && realfd < FD_MAX_TRACK)
         {
+            ZEROPERL_LOCK(sfs_lock);
             fd_mark_in_use(realfd);
+            ZEROPERL_UNLOCK(sfs_lock);
         }
     }
+    zeroperl_trace(ZEROPERL_TRACE_FOPEN, ZEROPERL_TRACE_HOST, path, realfd, 0, realfp ? realfd : -1, t0);
     return realfp;
 }
 
@@ -468,10 +516,12 @@ int __wrap_open(const char *path, int flags, ...)
     }
     va_end(args);
 
+    uint64_t t0 = zeroperl_trace_begin();
     if (sfs_has_prefix(path))
     {
         /* Try SFS. */
         int sfd = sfs_open(path, NULL);
+        zeroperl_trace(ZEROPERL_TRACE_OPEN, ZEROPERL_TRACE_SFS, path, sfd, (uint32_t)flags, sfd, t0);
         if (sfd >= 0)
         {
             return sfd;
@@ -479,13 +529,26 @@ int __wrap_open(const char *path, int flags, ...)
         /* No fallback => return -1. */
         return -1;
     }
+    if (zeroperl_tmpfs_path(path))
+    {
+        int tfd = zeroperl_tmpfs_open(path, flags, mode);
+        zeroperl_trace(ZEROPERL_TRACE_OPEN, ZEROPERL_TRACE_TMPFS, path, tfd, (uint32_t)flags, tfd, t0);
+        return tfd;
+    }
 
-    /* Otherwise => real open. */
-    int realfd = __real_open(path, flags, mode);
+    /* Otherwise => real open (through the immutable-dir cache). */
+    int realfd = zeroperl_fscache_open(path, flags, mode);
     if (realfd >= 0 && realfd < FD_MAX_TRACK)
     {
+        ZEROPERL_LOCK(sfs_lock);
         fd_mark_in_use(realfd);
+        ZEROPERL_UNLOCK(sfs_lock);
     }
+    if (realfd >= 0 && (flags & O_ACCMODE) == O_RDONLY)
+    {
+        zeroperl_readahead_open(realfd);
+    }
+    zeroperl_trace(ZEROPERL_TRACE_OPEN, ZEROPERL_TRACE_HOST, path, realfd, (uint32_t)flags, realfd, t0);
     return realfd;
 }
 
@@ -493,9 +556,17 @@ int __wrap_open(const char *path, int flags, ...)
 __attribute__((noinline))
 int __wrap_close(int fd)
 {
+    uint64_t t0 = zeroperl_trace_begin();
+    if (zeroperl_tmpfs_fd(fd))
+    {
+        int r = zeroperl_tmpfs_close(fd);
+        zeroperl_trace(ZEROPERL_TRACE_CLOSE, ZEROPERL_TRACE_TMPFS, NULL, fd, 0, r, t0);
+        return r;
+    }
     SFS_Result rc = sfs_close(fd);
     if (rc == SFS_OK)
     {
+        zeroperl_trace(ZEROPERL_TRACE_CLOSE, ZEROPERL_TRACE_SFS, NULL, fd, 0, 0, t0);
         return 0;
     }
     if (rc == SFS_NOT_OURS)
@@ -503,11 +574,17 @@ int __wrap_close(int fd)
         /* Not ours => real close. */
         if (fd >= 0 && fd < FD_MAX_TRACK)
         {
+            ZEROPERL_LOCK(sfs_lock);
             fd_mark_free(fd);
+            ZEROPERL_UNLOCK(sfs_lock);
         }
-        return __real_close(fd);
+        zeroperl_readahead_close(fd);
+        int r = __real_close(fd);
+        zeroperl_trace(ZEROPERL_TRACE_CLOSE, ZEROPERL_TRACE_HOST, NULL, fd, 0, r, t0);
+        return r;
     }
     /* Otherwise => rc == SFS_ERR => pass the error up. */
+    zeroperl_trace(ZEROPERL_TRACE_CLOSE, ZEROPERL_TRACE_SFS, NULL, fd, 0, rc, t0);
     return (int)rc; /* -1 or something, but we store -2 as well. */
 }
 
@@ -515,47 +592,110 @@ int __wrap_close(int fd)
 __attribute__((noinline))
 int __wrap_access(const char *path, int amode)
 {
+    uint64_t t0 = zeroperl_trace_begin();
+    int r;
     /* If prefix => try SFS. */
     if (sfs_has_prefix(path))
     {
-        return sfs_access(path);
+        r = sfs_access(path);
+        zeroperl_trace(ZEROPERL_TRACE_ACCESS, ZEROPERL_TRACE_SFS, path, -1, (uint32_t)amode, r, t0);
+        return r;
     }
-    /* else => real. */
-    return __real_access(path, amode);
+    if (zeroperl_tmpfs_path(path))
+    {
+        r = zeroperl_tmpfs_access(path, amode);
+        zeroperl_trace(ZEROPERL_TRACE_ACCESS, ZEROPERL_TRACE_TMPFS, path, -1, (uint32_t)amode, r, t0);
+        return r;
+    }
+    /* else => real (through the immutable-dir cache). */
+    r = zeroperl_fscache_access(path, amode);
+    zeroperl_trace(ZEROPERL_TRACE_ACCESS, ZEROPERL_TRACE_HOST, path, -1, (uint32_t)amode, r, t0);
+    return r;
 }
 
 /* __wrap_stat */
 __attribute__((noinline))
 int __wrap_stat(const char *restrict path, struct stat *restrict stbuf)
 {
+    uint64_t t0 = zeroperl_trace_begin();
     SFS_Stat_Result rc = sfs_stat(path, -1, stbuf);
     if (rc == SFS_STAT_OURS)
     {
+        zeroperl_trace(ZEROPERL_TRACE_STAT, ZEROPERL_TRACE_SFS, path, -1, 0, 0, t0);
         return 0; /* success in SFS */
     }
     if (rc == SFS_STAT_ERR)
     {
+        zeroperl_trace(ZEROPERL_TRACE_STAT, ZEROPERL_TRACE_SFS, path, -1, 0, -1, t0);
         return -1; /* ours, but not found => no fallback. */
     }
-    /* rc == SFS_STAT_NOT_OURS => fallback. */
-    return __real_stat(path, stbuf);
+    int r;
+    if (zeroperl_tmpfs_path(path))
+    {
+        r = zeroperl_tmpfs_stat(path, stbuf);
+        zeroperl_trace(ZEROPERL_TRACE_STAT, ZEROPERL_TRACE_TMPFS, path, -1, 0, r, t0);
+        return r;
+    }
+    /* rc == SFS_STAT_NOT_OURS => fallback (through the immutable-dir cache). */
+    r = zeroperl_fscache_stat(path, stbuf);
+    zeroperl_trace(ZEROPERL_TRACE_STAT, ZEROPERL_TRACE_HOST, path, -1, 0, r, t0);
+    return r;
+}
+
+/* __wrap_lstat: neither the SFS nor the tmpfs has symlinks, so lstat == stat there. */
+__attribute__((noinline))
+int __wrap_lstat(const char *restrict path, struct stat *restrict stbuf)
+{
+    uint64_t t0 = zeroperl_trace_begin();
+    SFS_Stat_Result rc = sfs_stat(path, -1, stbuf);
+    if (rc == SFS_STAT_OURS)
+    {
+        zeroperl_trace(ZEROPERL_TRACE_LSTAT, ZEROPERL_TRACE_SFS, path, -1, 0, 0, t0);
+        return 0;
+    }
+    if (rc == SFS_STAT_ERR)
+    {
+        zeroperl_trace(ZEROPERL_TRACE_LSTAT, ZEROPERL_TRACE_SFS, path, -1, 0, -1, t0);
+        return -1;
+    }
+    int r;
+    if (zeroperl_tmpfs_path(path))
+    {
+        r = zeroperl_tmpfs_stat(path, stbuf);
+        zeroperl_trace(ZEROPERL_TRACE_LSTAT, ZEROPERL_TRACE_TMPFS, path, -1, 0, r, t0);
+        return r;
+    }
+    r = zeroperl_fscache_lstat(path, stbuf);
+    zeroperl_trace(ZEROPERL_TRACE_LSTAT, ZEROPERL_TRACE_HOST, path, -1, 0, r, t0);
+    return r;
 }
 
 /* __wrap_fstat */
 __attribute__((noinline))
 int __wrap_fstat(int fd, struct stat *stbuf)
 {
+    uint64_t t0 = zeroperl_trace_begin();
+    if (zeroperl_tmpfs_fd(fd))
+    {
+        int r = zeroperl_tmpfs_fstat(fd, stbuf);
+        zeroperl_trace(ZEROPERL_TRACE_FSTAT, ZEROPERL_TRACE_TMPFS, NULL, fd, 0, r, t0);
+        return r;
+    }
     SFS_Stat_Result rc = sfs_stat(NULL, fd, stbuf);
     if (rc == SFS_STAT_OURS)
     {
+        zeroperl_trace(ZEROPERL_TRACE_FSTAT, ZEROPERL_TRACE_SFS, NULL, fd, 0, 0, t0);
         return 0; /* SFS success */
     }
     if (rc == SFS_STAT_ERR)
     {
+        zeroperl_trace(ZEROPERL_TRACE_FSTAT, ZEROPERL_TRACE_SFS, NULL, fd, 0, -1, t0);
         return -1; /* ours, but not found => no fallback */
     }
     /* rc == SFS_STAT_NOT_OURS => fallback. */
-    return __real_fstat(fd, stbuf);
+    int r = __real_fstat(fd, stbuf);
+    zeroperl_trace(ZEROPERL_TRACE_FSTAT, ZEROPERL_TRACE_HOST, NULL, fd, 0, r, t0);
+    return r;
 }
 
 
@@ -564,13 +704,36 @@ int __wrap_fstat(int fd, struct stat *stbuf)
 __attribute__((noinline))
 ssize_t __wrap_read(int fd, void *buf, size_t count)
 {
-    ssize_t r = sfs_read(fd, buf, count);
+    uint64_t t0 = zeroperl_trace_begin();
+    ssize_t r;
+    if (zeroperl_tmpfs_fd(fd))
+    {
+        r = zeroperl_tmpfs_read(fd, buf, count);
+        zeroperl_trace(ZEROPERL_TRACE_READ, ZEROPERL_TRACE_TMPFS, NULL, fd, (uint32_t)count, r, t0);
+        return r;
+    }
+    r = sfs_read(fd, buf, count);
     if (r >= 0)
     {
+        zeroperl_trace(ZEROPERL_TRACE_READ, ZEROPERL_TRACE_SFS, NULL, fd, (uint32_t)count, r, t0);
         return r; /* SFS success */
     }
+    /* Host files opened read-only may be answered by the read-ahead cache. */
+    switch (zeroperl_readahead_read(fd, buf, count, &r))
+    {
+    case ZEROPERL_READAHEAD_HIT:
+        zeroperl_trace(ZEROPERL_TRACE_READ, ZEROPERL_TRACE_CACHE, NULL, fd, (uint32_t)count, r, t0);
+        return r;
+    case ZEROPERL_READAHEAD_MISS:
+        zeroperl_trace(ZEROPERL_TRACE_READ, ZEROPERL_TRACE_HOST, NULL, fd, (uint32_t)count, r, t0);
+        return r;
+    case ZEROPERL_READAHEAD_NOT_OURS:
+        break;
+    }
     /* fallback => real read. */
-    return __real_read(fd, buf, count);
+    r = __real_read(fd, buf, count);
+    zeroperl_trace(ZEROPERL_TRACE_READ, ZEROPERL_TRACE_HOST, NULL, fd, (uint32_t)count, r, t0);
+    return r;
 }
 
 
@@ -578,13 +741,216 @@ ssize_t __wrap_read(int fd, void *buf, size_t count)
 __attribute__((noinline))
 off_t __wrap_lseek(int fd, off_t offset, int whence)
 {
-    off_t pos = sfs_lseek(fd, offset, whence);
+    uint64_t t0 = zeroperl_trace_begin();
+    off_t pos;
+    if (zeroperl_tmpfs_fd(fd))
+    {
+        pos = zeroperl_tmpfs_lseek(fd, offset, whence);
+        zeroperl_trace(ZEROPERL_TRACE_LSEEK, ZEROPERL_TRACE_TMPFS, NULL, fd, (uint32_t)whence, pos, t0);
+        return pos;
+    }
+    pos = sfs_lseek(fd, offset, whence);
     if (pos >= 0)
     {
+        zeroperl_trace(ZEROPERL_TRACE_LSEEK, ZEROPERL_TRACE_SFS, NULL, fd, (uint32_t)whence, pos, t0);
         return pos; /* SFS success */
     }
+    switch (zeroperl_readahead_lseek(fd, offset, whence, &pos))
+    {
+    case ZEROPERL_READAHEAD_HIT:
+        zeroperl_trace(ZEROPERL_TRACE_LSEEK, ZEROPERL_TRACE_CACHE, NULL, fd, (uint32_t)whence, pos, t0);
+        return pos;
+    case ZEROPERL_READAHEAD_MISS:
+        zeroperl_trace(ZEROPERL_TRACE_LSEEK, ZEROPERL_TRACE_HOST, NULL, fd, (uint32_t)whence, pos, t0);
+        return pos;
+    case ZEROPERL_READAHEAD_NOT_OURS:
+        break;
+    }
     /* fallback => real lseek. */
-    return __real_lseek(fd, offset, whence);
+    pos = __real_lseek(fd, offset, whence);
+    zeroperl_trace(ZEROPERL_TRACE_LSEEK, ZEROPERL_TRACE_HOST, NULL, fd, (uint32_t)whence, pos, t0);
+    return pos;
+}
+
+/* -------------------------------------------------------------------------
+ * Calls that only the tmpfs (see tmpfs.c) answers itself; everything else
+ * goes straight to the host. The SFS is read-only, so writes to it fail
+ * there as they always have. Host writes drop the read-ahead cache, which
+ * cannot tell which files they touch.
+ * ------------------------------------------------------------------------- */
+
+/* __wrap_write */
+__attribute__((noinline))
+ssize_t __wrap_write(int fd, const void *buf, size_t count)
+{
+    if (zeroperl_tmpfs_fd(fd))
+    {
+        return zeroperl_tmpfs_write(fd, buf, count);
+    }
+    if (fd > STDERR_FILENO)
+    {
+        zeroperl_readahead_invalidate();
+    }
+    return __real_write(fd, buf, count);
+}
+
+/* __wrap_pwrite */
+__attribute__((noinline))
+ssize_t __wrap_pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+    if (zeroperl_tmpfs_fd(fd))
+    {
+        return zeroperl_tmpfs_pwrite(fd, buf, count, offset);
+    }
+    zeroperl_readahead_invalidate();
+    return __real_pwrite(fd, buf, count, offset);
+}
+
+/* __wrap_ftruncate */
+__attribute__((noinline))
+int __wrap_ftruncate(int fd, off_t length)
+{
+    if (zeroperl_tmpfs_fd(fd))
+    {
+        return zeroperl_tmpfs_ftruncate(fd, length);
+    }
+    zeroperl_readahead_invalidate();
+    return __real_ftruncate(fd, length);
+}
+
+/* __wrap_truncate */
+__attribute__((noinline))
+int __wrap_truncate(const char *path, off_t length)
+{
+    if (zeroperl_tmpfs_path(path))
+    {
+        return zeroperl_tmpfs_truncate(path, length);
+    }
+    zeroperl_readahead_invalidate();
+    return __real_truncate(path, length);
+}
+
+/* __wrap_dup2 and __wrap_fcntl: a duplicate shares the host's file offset,
+ * which the read-ahead cache leaves where its last fill did. */
+__attribute__((noinline))
+int __wrap_dup2(int oldfd, int newfd)
+{
+    if (oldfd != newfd)
+    {
+        /* newfd is closed first, whatever it was. */
+        zeroperl_readahead_close(newfd);
+    }
+    int r = __real_dup2(oldfd, newfd);
+    if (r >= 0)
+    {
+        zeroperl_readahead_shared(oldfd);
+    }
+    return r;
+}
+
+__attribute__((noinline))
+int __wrap_fcntl(int fd, int cmd, ...)
+{
+    /* Every fcntl argument is an int or a pointer, the same size here. */
+    va_list ap;
+    va_start(ap, cmd);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+    int r = __real_fcntl(fd, cmd, arg);
+#ifdef F_DUPFD
+    if (r >= 0 && (cmd == F_DUPFD
+#ifdef F_DUPFD_CLOEXEC
+                   || cmd == F_DUPFD_CLOEXEC
+#endif
+                   ))
+    {
+        zeroperl_readahead_shared(fd);
+    }
+#endif
+    return r;
+}
+
+/* __wrap_rename: within the tmpfs only; File::Copy::move copies on EXDEV. */
+__attribute__((noinline))
+int __wrap_rename(const char *from, const char *to)
+{
+    bool src = zeroperl_tmpfs_path(from);
+    bool dst = zeroperl_tmpfs_path(to);
+    if (src && dst)
+    {
+        return zeroperl_tmpfs_rename(from, to);
+    }
+    if (src || dst)
+    {
+        errno = EXDEV;
+        return -1;
+    }
+    return __real_rename(from, to);
+}
+
+/* __wrap_unlink */
+__attribute__((noinline))
+int __wrap_unlink(const char *path)
+{
+    if (zeroperl_tmpfs_path(path))
+    {
+        return zeroperl_tmpfs_unlink(path);
+    }
+    return __real_unlink(path);
+}
+
+/* __wrap_mkdir */
+__attribute__((noinline))
+int __wrap_mkdir(const char *path, mode_t mode)
+{
+    if (zeroperl_tmpfs_path(path))
+    {
+        return zeroperl_tmpfs_mkdir(path, mode);
+    }
+    return __real_mkdir(path, mode);
+}
+
+/* __wrap_rmdir */
+__attribute__((noinline))
+int __wrap_rmdir(const char *path)
+{
+    if (zeroperl_tmpfs_path(path))
+    {
+        return zeroperl_tmpfs_rmdir(path);
+    }
+    return __real_rmdir(path);
+}
+
+/* __wrap_chdir */
+__attribute__((noinline))
+int __wrap_chdir(const char *path)
+{
+    if (zeroperl_tmpfs_mounted)
+    {
+        return zeroperl_tmpfs_chdir(path);
+    }
+    return __real_chdir(path);
+}
+
+/* __wrap_getcwd */
+__attribute__((noinline))
+char *__wrap_getcwd(char *buf, size_t size)
+{
+    const char *cwd = zeroperl_tmpfs_cwd();
+    if (!cwd)
+    {
+        return __real_getcwd(buf, size);
+    }
+    if (!buf)
+    {
+        return strdup(cwd);
+    }
+    if (strlen(cwd) >= size)
+    {
+        errno = ERANGE;
+        return NULL;
+    }
+    return strcpy(buf, cwd);
 }
 
 /* __wrap_fileno */
@@ -592,11 +958,14 @@ __attribute__((noinline))
 int __wrap_fileno(FILE *stream)
 {
     /* 1) Check SFS first: see if this FILE* is one of ours. */
+    ZEROPERL_LOCK(sfs_lock);
     for (int i = 0; i < SFS_MAX_OPEN_FILES; i++)
     {
         if (sfs_table[i].used && sfs_table[i].fp == stream)
         {
-            return sfs_table[i].fd; /* found => SFS FD */
+            int sfd = sfs_table[i].fd;
+            ZEROPERL_UNLOCK(sfs_lock);
+            return sfd; /* found => SFS FD */
         }
     }
 
@@ -606,8 +975,51 @@ int __wrap_fileno(FILE *stream)
     {
         fd_mark_in_use(realfd);
     }
+    ZEROPERL_UNLOCK(sfs_lock);
     return realfd; /* might be negative if real fileno fails. */
 }
+/* One interpreter on argv, from perl_alloc() to perl_free(). */
+static int run_interpreter(int argc, char *argv[], bool profile)
+{
+    int exitstatus;
+    PerlInterpreter *interp = perl_alloc();
+    if (!interp)
+    {
+        return 1;
+    }
+    dTHXa(interp);
+
+    perl_construct(interp);
+
+    /* Minimal cleanup for restricted environments. */
+    PL_perl_destruct_level = 0;
+    PL_exit_flags &= ~PERL_EXIT_DESTRUCT_END;
+
+    /* Sampling profiler, only active when ZEROPERL_PROF is set. */
+    if (profile)
+    {
+        zeroperl_prof_init(aTHX);
+    }
+    /* Execution budget, only active when one is set. */
+    zeroperl_fuel_init(aTHX);
+
+    exitstatus = 0;
+    if (!perl_parse(interp, xs_init, argc, argv, NULL))
+    {
+        assert(!PL_restartop);
+        exitstatus = perl_run(interp);
+    }
+
+    if (profile)
+    {
+        zeroperl_prof_finish(aTHX);
+    }
+
+    perl_destruct(interp);
+    perl_free(interp);
+    return exitstatus;
+}
+
 // real
 int real_main(int argc, char *argv[])
 {
@@ -616,34 +1028,321 @@ int real_main(int argc, char *argv[])
     PERL_SYS_INIT3(&argc, &argv, &environ);
     PERL_SYS_FPU_INIT;
 
+    exitstatus = run_interpreter(argc, argv, true);
+
+    PERL_SYS_TERM();
+    return exitstatus;
+}
+
+#ifdef USE_ITHREADS
+/* -------------------------------------------------------------------------
+ * Parallel interpreters, in the wasi-threads build (MULTIPLICITY and
+ * ithreads, linked with shared memory).
+ *
+ * zeroperl_spawn() starts an interpreter on argv in a thread of its own and
+ * returns a handle, or -1; zeroperl_join() waits for it and returns its exit
+ * status. Each interpreter has its own Perl heap (arenas, ops, stashes), C
+ * stack and setjmp/longjmp state. They share the compiled code, the SFS
+ * image and malloc. With ZEROPERL_THREADS=N in the environment, main() runs
+ * its argv in N interpreters at once and exits with the first non-zero
+ * status. The profiler (ZEROPERL_PROF) only follows the single-interpreter
+ * path.
+ * ------------------------------------------------------------------------- */
+#ifndef ZEROPERL_MAX_THREADS
+#define ZEROPERL_MAX_THREADS 64
+#endif
+
+/* The main thread gets -z stack-size; wasi-libc's default for new threads
+   is far too small for Perl's recursion. */
+#ifndef ZEROPERL_THREAD_STACK_SIZE
+#define ZEROPERL_THREAD_STACK_SIZE (8 * 1024 * 1024)
+#endif
+
+typedef struct
+{
+    bool used;
+    pthread_t tid;
+    int argc;
+    char **argv; /* own copy: PL_origargv (and $0) point into it */
+    int status;
+} zero_thread;
+
+static zero_thread zero_threads[ZEROPERL_MAX_THREADS];
+ZEROPERL_MUTEX(zero_threads_lock);
+static pthread_once_t zero_sys_once = PTHREAD_ONCE_INIT;
+
+/* PERL_SYS_INIT3 once per instance, before the first interpreter. There is
+   no matching PERL_SYS_TERM: the instance lives as long as its threads. */
+static void zero_sys_init(void)
+{
+    int argc = 0;
+    char **argv = NULL;
+    char **env = environ;
+
+    PERL_SYS_INIT3(&argc, &argv, &env);
+    PERL_SYS_FPU_INIT;
+}
+
+static void free_argv(char **argv)
+{
+    if (argv)
+    {
+        for (char **p = argv; *p; p++)
+        {
+            free(*p);
+        }
+        free(argv);
+    }
+}
+
+static char **copy_argv(int argc, char **argv)
+{
+    char **copy = calloc((size_t)argc + 1, sizeof(char *));
+    for (int i = 0; copy && i < argc; i++)
+    {
+        if (!(copy[i] = strdup(argv[i])))
+        {
+            free_argv(copy);
+            copy = NULL;
+        }
+    }
+    return copy;
+}
+
+static int thread_main(int argc, char *argv[])
+{
+    return run_interpreter(argc, argv, false);
+}
+
+static void *zero_thread_start(void *arg)
+{
+    zero_thread *t = arg;
+
+    asyncjmp_record_stack_base();
+    t->status = asyncjmp_rt_start(thread_main, t->argc, t->argv);
+    return NULL;
+}
+
+__attribute__((export_name("zeroperl_spawn")))
+int zeroperl_spawn(int argc, char **argv)
+{
+    pthread_attr_t attr;
+    zero_thread *t = NULL;
+    int rc;
+
+    pthread_once(&zero_sys_once, zero_sys_init);
+
+    ZEROPERL_LOCK(zero_threads_lock);
+    for (int i = 0; i < ZEROPERL_MAX_THREADS; i++)
+    {
+        if (!zero_threads[i].used)
+        {
+            t = &zero_threads[i];
+            t->used = true;
+            break;
+        }
+    }
+    ZEROPERL_UNLOCK(zero_threads_lock);
+    if (!t)
+    {
+        return -1;
+    }
+
+    t->argc = argc;
+    t->argv = copy_argv(argc, argv);
+    t->status = 0;
+    rc = ENOMEM;
+    if (t->argv)
+    {
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, ZEROPERL_THREAD_STACK_SIZE);
+        rc = pthread_create(&t->tid, &attr, zero_thread_start, t);
+        pthread_attr_destroy(&attr);
+    }
+    if (rc != 0)
+    {
+        free_argv(t->argv);
+        ZEROPERL_LOCK(zero_threads_lock);
+        t->used = false;
+        ZEROPERL_UNLOCK(zero_threads_lock);
+        return -1;
+    }
+    return (int)(t - zero_threads);
+}
+
+__attribute__((export_name("zeroperl_join")))
+int zeroperl_join(int id)
+{
+    zero_thread *t;
+    int status;
+
+    if (id < 0 || id >= ZEROPERL_MAX_THREADS)
+    {
+        return -1;
+    }
+    t = &zero_threads[id];
+    ZEROPERL_LOCK(zero_threads_lock);
+    bool used = t->used;
+    ZEROPERL_UNLOCK(zero_threads_lock);
+    if (!used)
+    {
+        return -1;
+    }
+
+    pthread_join(t->tid, NULL);
+    status = t->status;
+    free_argv(t->argv);
+    t->argv = NULL;
+    ZEROPERL_LOCK(zero_threads_lock);
+    t->used = false;
+    ZEROPERL_UNLOCK(zero_threads_lock);
+    return status;
+}
+
+static int zero_thread_count(void)
+{
+    const char *env = getenv("ZEROPERL_THREADS");
+    int n = env ? atoi(env) : 0;
+    return n > ZEROPERL_MAX_THREADS ? ZEROPERL_MAX_THREADS : n;
+}
+
+static int run_parallel(int argc, char *argv[], int n)
+{
+    int ids[ZEROPERL_MAX_THREADS];
+    int exitstatus = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        ids[i] = zeroperl_spawn(argc, argv);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        int status = ids[i] < 0 ? 1 : zeroperl_join(ids[i]);
+        if (status && !exitstatus)
+        {
+            exitstatus = status;
+        }
+    }
+    return exitstatus;
+}
+#endif
+
+int real_real_main(int argc, char **argv)
+{
+#ifdef USE_ITHREADS
+    int threads = zero_thread_count();
+    if (threads > 1)
+    {
+        return run_parallel(argc, argv, threads);
+    }
+#endif
+    return asyncjmp_rt_start(real_main, argc, argv);
+}
+
+/* -------------------------------------------------------------------------
+ * Reusable-instance entry points, driven by tools/snapshot.mjs.
+ *
+ * zeroperl_init() builds the interpreter and runs argv once (typically a
+ * list of -M preloads and -e0) but never destructs it. The host snapshots
+ * linear memory after it returns, then runs each request with
+ * zeroperl_eval() and restores the dirtied pages afterwards, so every request
+ * starts from the same warm interpreter.
+ * ------------------------------------------------------------------------- */
+static const char *zero_eval_code;
+
+static int init_main(int argc, char *argv[])
+{
+    int exitstatus;
+
+    PERL_SYS_INIT3(&argc, &argv, &environ);
+    PERL_SYS_FPU_INIT;
+
     zero_perl = perl_alloc();
     if (!zero_perl)
     {
         return 1;
     }
 
+    dTHXa(zero_perl);
     perl_construct(zero_perl);
 
-    /* Minimal cleanup for restricted environments. */
     PL_perl_destruct_level = 0;
     PL_exit_flags &= ~PERL_EXIT_DESTRUCT_END;
+    zeroperl_fuel_init(aTHX);
 
-    exitstatus = 0;
-    if (!perl_parse(zero_perl, xs_init, argc, argv, NULL))
+    exitstatus = perl_parse(zero_perl, xs_init, argc, argv, NULL);
+    if (!exitstatus)
     {
-        assert(!PL_restartop);
         exitstatus = perl_run(zero_perl);
     }
+    PerlIO_flush((PerlIO *)NULL);
+    return exitstatus;
+}
 
-    perl_destruct(zero_perl);
-    perl_free(zero_perl);
-    PERL_SYS_TERM();
+static int eval_main(int argc, char *argv[])
+{
+    int ret;
+    int exitstatus = 0;
+    dTHXa(zero_perl);
+    dJMPENV;
+
+    (void)argc;
+    (void)argv;
+
+    zeroperl_fuel_refill();
+    JMPENV_PUSH(ret);
+    switch (ret)
+    {
+    case 0:
+        eval_pv(zero_eval_code, FALSE);
+        if (SvTRUE(ERRSV))
+        {
+            PerlIO_printf(PerlIO_stderr(), "%" SVf, SVfARG(ERRSV));
+            exitstatus = 255;
+        }
+        break;
+    case 2:
+        /* exit() inside the request. */
+        exitstatus = STATUS_EXIT;
+        break;
+    default:
+        exitstatus = 1;
+        break;
+    }
+    JMPENV_POP;
+
+    PerlIO_flush((PerlIO *)NULL);
     return exitstatus;
 }
 
-int real_real_main(int argc, char **argv)
+__attribute__((export_name("zeroperl_init")))
+int zeroperl_init(int argc, char **argv)
 {
-    return asyncjmp_rt_start(real_main, argc, argv);
+    return asyncjmp_rt_start(init_main, argc, argv);
+}
+
+/* Returns -2 (ASYNCJMP_RT_YIELDED) if the request used up a slice of its
+ * budget with ZEROPERL_FUEL_ACTION=yield (see fuel.c); zeroperl_resume()
+ * then continues it. No other request can start until it has finished. */
+__attribute__((export_name("zeroperl_eval")))
+int zeroperl_eval(const char *code)
+{
+    if (!zero_perl || asyncjmp_rt_suspended())
+    {
+        return 1;
+    }
+    zero_eval_code = code;
+    return asyncjmp_rt_start_yieldable(eval_main, 0, NULL);
+}
+
+__attribute__((export_name("zeroperl_resume")))
+int zeroperl_resume(void)
+{
+    if (!asyncjmp_rt_suspended())
+    {
+        return 1;
+    }
+    return asyncjmp_rt_resume();
 }
 
 static int (*volatile indirect_main)(int, char **) = real_real_main;
@@ -654,45 +1353,10 @@ int main(int argc, char **argv)
 }
 
 /* -------------------------------------------------------------------------
- * XS bootstrap table. (Adjust as your Perl config requires.)
+ * XS bootstrap table, generated by tools/profile.js from
+ * tools/profiles.json for the profile being built.
  * ------------------------------------------------------------------------- */
-EXTERN_C void boot_DynaLoader(pTHX_ CV *cv);
-EXTERN_C void boot_File__DosGlob(pTHX_ CV *cv);
-EXTERN_C void boot_File__Glob(pTHX_ CV *cv);
-EXTERN_C void boot_Sys__Hostname(pTHX_ CV *cv);
-EXTERN_C void boot_PerlIO__via(pTHX_ CV *cv);
-EXTERN_C void boot_PerlIO__mmap(pTHX_ CV *cv);
-EXTERN_C void boot_PerlIO__encoding(pTHX_ CV *cv);
-EXTERN_C void boot_attributes(pTHX_ CV *cv);
-EXTERN_C void boot_Unicode__Normalize(pTHX_ CV *cv);
-EXTERN_C void boot_Unicode__Collate(pTHX_ CV *cv);
-EXTERN_C void boot_re(pTHX_ CV *cv);
-EXTERN_C void boot_Digest__MD5(pTHX_ CV *cv);
-EXTERN_C void boot_Digest__SHA(pTHX_ CV *cv);
-EXTERN_C void boot_Math__BigInt__FastCalc(pTHX_ CV *cv);
-EXTERN_C void boot_Data__Dumper(pTHX_ CV *cv);
-EXTERN_C void boot_I18N__Langinfo(pTHX_ CV *cv);
-EXTERN_C void boot_Time__Piece(pTHX_ CV *cv);
-EXTERN_C void boot_IO(pTHX_ CV *cv);
-EXTERN_C void boot_Hash__Util__FieldHash(pTHX_ CV *cv);
-EXTERN_C void boot_Hash__Util(pTHX_ CV *cv);
-EXTERN_C void boot_Filter__Util__Call(pTHX_ CV *cv);
-EXTERN_C void boot_Encode__Unicode(pTHX_ CV *cv);
-EXTERN_C void boot_Encode(pTHX_ CV *cv);
-EXTERN_C void boot_Encode__JP(pTHX_ CV *cv);
-EXTERN_C void boot_Encode__KR(pTHX_ CV *cv);
-EXTERN_C void boot_Encode__EBCDIC(pTHX_ CV *cv);
-EXTERN_C void boot_Encode__CN(pTHX_ CV *cv);
-EXTERN_C void boot_Encode__Symbol(pTHX_ CV *cv);
-EXTERN_C void boot_Encode__Byte(pTHX_ CV *cv);
-EXTERN_C void boot_Encode__TW(pTHX_ CV *cv);
-EXTERN_C void boot_Compress__Raw__Zlib(pTHX_ CV *cv);
-EXTERN_C void boot_Compress__Raw__Bzip2(pTHX_ CV *cv);
-EXTERN_C void boot_MIME__Base64(pTHX_ CV *cv);
-EXTERN_C void boot_Cwd(pTHX_ CV *cv);
-EXTERN_C void boot_List__Util(pTHX_ CV *cv);
-EXTERN_C void boot_Fcntl(pTHX_ CV *cv);
-EXTERN_C void boot_Opcode(pTHX_ CV *cv);
+#include "zeroperl_xs.h"
 
 static void xs_init(pTHX)
 {
@@ -700,41 +1364,5 @@ static void xs_init(pTHX)
     dXSUB_SYS;
     PERL_UNUSED_CONTEXT;
 
-    newXS("DynaLoader::boot_DynaLoader", boot_DynaLoader, file);
-    newXS("File::DosGlob::bootstrap", boot_File__DosGlob, file);
-    newXS("File::Glob::bootstrap", boot_File__Glob, file);
-    newXS("Sys::Hostname::bootstrap", boot_Sys__Hostname, file);
-    newXS("PerlIO::via::bootstrap", boot_PerlIO__via, file);
-    newXS("PerlIO::mmap::bootstrap", boot_PerlIO__mmap, file);
-    newXS("PerlIO::encoding::bootstrap", boot_PerlIO__encoding, file);
-    newXS("attributes::bootstrap", boot_attributes, file);
-    newXS("Unicode::Normalize::bootstrap", boot_Unicode__Normalize, file);
-    newXS("Unicode::Collate::bootstrap", boot_Unicode__Collate, file);
-    newXS("re::bootstrap", boot_re, file);
-    newXS("Digest::MD5::bootstrap", boot_Digest__MD5, file);
-    newXS("Digest::SHA::bootstrap", boot_Digest__SHA, file);
-    newXS("Math::BigInt::FastCalc::bootstrap", boot_Math__BigInt__FastCalc, file);
-    newXS("Data::Dumper::bootstrap", boot_Data__Dumper, file);
-    newXS("I18N::Langinfo::bootstrap", boot_I18N__Langinfo, file);
-    newXS("Time::Piece::bootstrap", boot_Time__Piece, file);
-    newXS("IO::bootstrap", boot_IO, file);
-    newXS("Hash::Util::FieldHash::bootstrap", boot_Hash__Util__FieldHash, file);
-    newXS("Hash::Util::bootstrap", boot_Hash__Util, file);
-    newXS("Filter::Util::Call::bootstrap", boot_Filter__Util__Call, file);
-    newXS("Encode::Unicode::bootstrap", boot_Encode__Unicode, file);
-    newXS("Encode::bootstrap", boot_Encode, file);
-    newXS("Encode::JP::bootstrap", boot_Encode__JP, file);
-    newXS("Encode::KR::bootstrap", boot_Encode__KR, file);
-    newXS("Encode::EBCDIC::bootstrap", boot_Encode__EBCDIC, file);
-    newXS("Encode::CN::bootstrap", boot_Encode__CN, file);
-    newXS("Encode::Symbol::bootstrap", boot_Encode__Symbol, file);
-    newXS("Encode::Byte::bootstrap", boot_Encode__Byte, file);
-    newXS("Encode::TW::bootstrap", boot_Encode__TW, file);
-    newXS("Compress::Raw::Zlib::bootstrap", boot_Compress__Raw__Zlib, file);
-    newXS("Compress::Raw::Bzip2::bootstrap", boot_Compress__Raw__Bzip2, file);
-    newXS("MIME::Base64::bootstrap", boot_MIME__Base64, file);
-    newXS("Cwd::bootstrap", boot_Cwd, file);
-    newXS("List::Util::bootstrap", boot_List__Util, file);
-    newXS("Fcntl::bootstrap", boot_Fcntl, file);
-    newXS("Opcode::bootstrap", boot_Opcode, file);
+    zeroperl_xs_boot(aTHX_ file);
 }
@@ -0,0 +1,173 @@
+#!/usr/bin/env node
+/**
+ * aot.mjs
+ *
+ * Cold-start artifacts for zeroperl.wasm.
+ *
+ * wasmtime: `compile` writes a precompiled zeroperl.cwasm next to the module,
+ * with a zeroperl.cwasm.json sidecar recording the wasmtime version, the
+ * target and the sha256 of the .wasm it came from. precompiled() only
+ * returns the .cwasm when all three match the current wasmtime, host and
+ * module, and `run` falls back to the .wasm otherwise. The build compiles
+ * for a plain x86_64-unknown-linux-gnu target, so the code only uses
+ * baseline CPU features and loads on any x86_64 Linux host.
+ *
+ * Node.js: V8 has no API to serialize a compiled module across processes,
+ * and it already compiles wasm functions lazily, on first call. What every
+ * fresh process still pays is validating the whole module up front.
+ * compileModule() records each module that validated, keyed by its sha256
+ * and the V8 version, in a cache directory. The next time the same bytes
+ * are compiled it defers validation to each function's first call. A stale
+ * or forged entry cannot let invalid code run: lazily validated functions
+ * are still validated before they are compiled.
+ *
+ * Usage:
+ *   ./aot.mjs compile <zeroperl.wasm> [--target x86_64-unknown-linux-gnu]
+ *   ./aot.mjs run <zeroperl.wasm> [arguments...]
+ */
+import { createHash } from 'node:crypto';
+import { existsSync, mkdirSync, readFileSync, renameSync, writeFileSync } from 'node:fs';
+import { tmpdir } from 'node:os';
+import { basename, join, resolve } from 'node:path';
+import { spawnSync } from 'node:child_process';
+import { fileURLToPath } from 'node:url';
+import { setFlagsFromString } from 'node:v8';
+
+const DEFAULT_TARGET = 'x86_64-unknown-linux-gnu';
+
+export function wasmHash(bytes) {
+    return createHash('sha256').update(bytes).digest('hex');
+}
+
+// -----------------------------------------------------------------------------
+// Node.js.
+export function defaultCacheDir() {
+    return process.env.ZEROPERL_CACHE_DIR || join(tmpdir(), 'zeroperl-cache');
+}
+
+/**
+ * Compile `bytes` to a WebAssembly.Module. With a `cacheDir` (pass null to
+ * disable), a module that validated before is compiled with lazy
+ * validation. Cache directory errors are ignored.
+ */
+export function compileModule(bytes, { cacheDir = defaultCacheDir() } = {}) {
+    if (!cacheDir) {
+        return new WebAssembly.Module(bytes);
+    }
+    const entry = join(cacheDir, `${wasmHash(bytes)}-v8-${process.versions.v8}.json`);
+    if (existsSync(entry)) {
+        setFlagsFromString('--wasm-lazy-validation');
+        try {
+            return new WebAssembly.Module(bytes);
+        } finally {
+            setFlagsFromString('--no-wasm-lazy-validation');
+        }
+    }
+    const module = new WebAssembly.Module(bytes);
+    try {
+        mkdirSync(cacheDir, { recursive: true });
+        const tmp = `${entry}.${process.pid}`;
+        writeFileSync(tmp, JSON.stringify({ size: bytes.length, v8: process.versions.v8, date: new Date().toISOString() }) + '\n');
+        renameSync(tmp, entry);
+    } catch {
+        // Read-only or missing cache directory: the next run validates again.
+    }
+    return module;
+}
+
+// -----------------------------------------------------------------------------
+// wasmtime.
+export function wasmtimeVersion() {
+    const r = spawnSync('wasmtime', ['--version'], { encoding: 'utf8' });
+    return r.status === 0 ? r.stdout.trim() : null;
+}
+
+function hostTarget() {
+    const arch = { x64: 'x86_64', arm64: 'aarch64' }[process.arch];
+    return arch && process.platform === 'linux' ? `${arch}-unknown-linux-gnu` : null;
+}
+
+function cwasmPath(wasmPath) {
+    return wasmPath.replace(/\.wasm$/, '') + '.cwasm';
+}
+
+export function compileWasmtime(wasmPath, { target = DEFAULT_TARGET } = {}) {
+    const out = cwasmPath(wasmPath);
+    const version = wasmtimeVersion();
+    if (!version) {
+        throw new Error('wasmtime not found');
+    }
+    const r = spawnSync('wasmtime', ['compile', '--target', target, '-o', out, wasmPath], { stdio: 'inherit' });
+    if (r.status !== 0) {
+        throw new Error(`wasmtime compile: exit status ${r.status}`);
+    }
+    const sidecar = { wasm: basename(wasmPath), sha256: wasmHash(readFileSync(wasmPath)), wasmtime: version, target };
+    writeFileSync(`${out}.json`, JSON.stringify(sidecar, null, 2) + '\n');
+    return out;
+}
+
+/**
+ * The .cwasm built from `wasmPath` if it can be loaded by the installed
+ * wasmtime on this host, otherwise null (with the reason in `why`).
+ */
+export function precompiled(wasmPath, why = []) {
+    const out = cwasmPath(wasmPath);
+    let sidecar;
+    try {
+        sidecar = JSON.parse(readFileSync(`${out}.json`, 'utf8'));
+    } catch {
+        why.push(`no ${basename(out)}.json`);
+        return null;
+    }
+    if (!existsSync(out)) {
+        why.push(`no ${basename(out)}`);
+    } else if (sidecar.target !== hostTarget()) {
+        why.push(`built for ${sidecar.target}, host is ${hostTarget() ?? process.arch}`);
+    } else if (sidecar.wasmtime !== wasmtimeVersion()) {
+        why.push(`built by ${sidecar.wasmtime}, not ${wasmtimeVersion()}`);
+    } else if (sidecar.sha256 !== wasmHash(readFileSync(wasmPath))) {
+        why.push(`${basename(wasmPath)} changed since it was precompiled`);
+    } else {
+        return out;
+    }
+    return null;
+}
+
+// `wasmtime run` arguments for zeroperl, preferring the precompiled module.
+export function wasmtimeArgs(wasmPath, args, { env = { LC_ALL: 'C' }, why = [] } = {}) {
+    const cwasm = precompiled(wasmPath, why);
+    const envArgs = Object.entries(env).flatMap(([k, v]) => ['--env', `${k}=${v}`]);
+    return ['run', ...(cwasm ? ['--allow-precompiled'] : []), '--dir=/', ...envArgs, '--argv0', 'zeroperl', cwasm ?? wasmPath, ...args];
+}
+
+// -----------------------------------------------------------------------------
+function usage(msg) {
+    if (msg) console.error(msg);
+    console.error('Usage: aot.mjs compile <zeroperl.wasm> [--target triple]');
+    console.error('       aot.mjs run <zeroperl.wasm> [arguments...]');
+    process.exit(2);
+}
+
+function main([command, wasm, ...rest]) {
+    if (!wasm) usage();
+    const wasmPath = resolve(wasm);
+    if (command === 'compile') {
+        const target = rest[0] === '--target' ? rest[1] : DEFAULT_TARGET;
+        if (!target) usage('missing value for --target');
+        console.error(`Wrote ${compileWasmtime(wasmPath, { target })}`);
+    } else if (command === 'run') {
+        const why = [];
+        const args = wasmtimeArgs(wasmPath, rest, { why });
+        if (why.length && existsSync(`${cwasmPath(wasmPath)}.json`)) {
+            console.error(`aot: not using the precompiled module: ${why.join(', ')}`);
+        }
+        const r = spawnSync('wasmtime', args, { stdio: 'inherit' });
+        process.exit(r.status ?? 1);
+    } else {
+        usage(`unknown command: ${command}`);
+    }
+}
+
+if (process.argv[1] && resolve(process.argv[1]) === fileURLToPath(import.meta.url)) {
+    main(process.argv.slice(2));
+}
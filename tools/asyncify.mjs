@@ -112,7 +112,6 @@ class Asyncify {
 
 
             while (this.getState() === State.Unwinding) {
-                console.log('unwinding');
                 this.exports.asyncify_stop_unwind();
                 this.value = await this.value;
                 this.assertNoneState();
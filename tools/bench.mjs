@@ -0,0 +1,352 @@
+#!/usr/bin/env node
+/**
+ * bench.mjs
+ *
+ * Reproducible benchmarks for zeroperl.wasm under Node.js and wasmtime.
+ * Every case runs with fixed inputs (the scripts in bench/ seed their own
+ * data, and the streaming input is generated deterministically), one warmup
+ * iteration is discarded, and the remaining wall times are summarised as
+ * median and percentiles. Results are written as JSON so that two builds can
+ * be compared with --compare.
+ *
+ * Usage:
+ *   ./bench.mjs --wasm <zeroperl.wasm> [--out results.json] [--iterations 10]
+ *               [--engines node,wasmtime] [--filter <regex>]
+ *   ./bench.mjs --compare <base.json> <new.json> [--threshold 5]
+ */
+import { createHash } from 'node:crypto';
+import { closeSync, existsSync, mkdtempSync, openSync, readFileSync, rmSync, statSync, writeFileSync } from 'node:fs';
+import { cpus, platform, release, tmpdir } from 'node:os';
+import { dirname, join, resolve } from 'node:path';
+import { spawnSync } from 'node:child_process';
+import { fileURLToPath } from 'node:url';
+import { WASI } from 'node:wasi';
+import { precompiled } from './aot.mjs';
+
+const BENCH_DIR = resolve(dirname(fileURLToPath(import.meta.url)), '..', 'bench');
+const RUNNER = resolve(dirname(fileURLToPath(import.meta.url)), 'runner.mjs');
+const ENV = { LC_ALL: 'C' };
+
+// Each case is either a plain compile, or a zeroperl invocation with
+// arguments, an optional script from bench/ and an optional stdin file.
+// Cases marked optional are reported as skipped when they fail, e.g.
+// ExifTool on builds made without it. Cases that process a known amount of
+// data (`bytes`, or the stdin file) also report end-to-end MB/s. Cases with
+// an `engines` list only run on those engines. `process` cases time a whole
+// fresh process: runner.mjs under Node, wasmtime run under wasmtime, with
+// (`cached`) or without the cold-start artifacts from aot.mjs.
+export const CASES = [
+    { name: 'compile', compileOnly: true },
+    { name: 'instantiate', instantiateOnly: true, engines: ['node'] },
+    { name: 'startup', args: ['-e1'] },
+    { name: 'cold_start', args: ['-e1'], process: true },
+    { name: 'cold_start_cached', args: ['-e1'], process: true, cached: true, optional: true },
+    { name: 'pipe_fanout', script: 'procs.pl', process: true, engines: ['node'], optional: true },
+    { name: 'fork_fanout', script: 'fork.pl', process: true, engines: ['node'], optional: true },
+    { name: 'exiftool_load', args: ['-MImage::ExifTool', '-e1'], optional: true },
+    { name: 'sfs_read', script: 'sfs_read.pl' },
+    { name: 'eval_die', script: 'eval_die.pl' },
+    { name: 'regex', script: 'regex.pl' },
+    { name: 'hash', script: 'hash.pl' },
+    { name: 'hash_tags', script: 'hash.pl', args: ['tags'] },
+    { name: 'hash_long', script: 'hash.pl', args: ['long'] },
+    { name: 'unicode_prop', script: 'unicode.pl', args: ['prop'] },
+    { name: 'unicode_lc', script: 'unicode.pl', args: ['lc'] },
+    { name: 'collate_new', script: 'collate.pl', args: ['new'], optional: true },
+    { name: 'collate_sort', script: 'collate.pl', args: ['sort'], optional: true },
+    { name: 'stream', args: ['-pe', 's/(\\d+)/<$1>/g'], stdin: 'stream' },
+    { name: 'logparse', script: 'logparse.pl', stdin: 'stream' },
+    { name: 'base64', script: 'throughput.pl', args: ['base64'], bytes: 16 << 20 },
+    { name: 'md5', script: 'throughput.pl', args: ['md5'], bytes: 16 << 20 },
+    { name: 'sha256', script: 'throughput.pl', args: ['sha256'], bytes: 16 << 20 },
+    { name: 'zlib', script: 'throughput.pl', args: ['zlib'], bytes: 16 << 20 },
+    { name: 'crc32', script: 'throughput.pl', args: ['crc32'], bytes: 16 << 20 },
+    { name: 'json_encode', script: 'json.pl', args: ['encode_xs', '16'], bytes: 16 << 20 },
+    { name: 'json_decode', script: 'json.pl', args: ['decode_xs', '16'], bytes: 16 << 20 },
+    { name: 'json_encode_pp', script: 'json.pl', args: ['encode_pp', '2'], bytes: 2 << 20 },
+    { name: 'json_decode_pp', script: 'json.pl', args: ['decode_pp', '2'], bytes: 2 << 20 },
+    { name: 'table_build', script: 'storable.pl', args: ['build'] },
+    { name: 'storable_retrieve', script: 'storable.pl', args: ['retrieve'] },
+    { name: 'storable_dclone', script: 'storable.pl', args: ['dclone'] },
+    { name: 'dumper_clone', script: 'storable.pl', args: ['dumper'] },
+];
+
+function parseArgs(argv) {
+    const opts = { iterations: 10, engines: ['node', 'wasmtime'], threshold: 5 };
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        const value = () => {
+            if (i + 1 >= argv.length) {
+                usage(`missing value for ${arg}`);
+            }
+            return argv[++i];
+        };
+        if (arg === '--wasm') opts.wasm = value();
+        else if (arg === '--out') opts.out = value();
+        else if (arg === '--iterations') opts.iterations = parseInt(value(), 10);
+        else if (arg === '--engines') opts.engines = value().split(',');
+        else if (arg === '--filter') opts.filter = new RegExp(value());
+        else if (arg === '--threshold') opts.threshold = parseFloat(value());
+        else if (arg === '--compare') opts.compare = [value(), value()];
+        else usage(`unknown argument: ${arg}`);
+    }
+    return opts;
+}
+
+function usage(msg) {
+    if (msg) console.error(msg);
+    console.error('Usage: bench.mjs --wasm <zeroperl.wasm> [--out results.json] [--iterations N] [--engines node,wasmtime] [--filter regex]');
+    console.error('       bench.mjs --compare <base.json> <new.json> [--threshold percent]');
+    process.exit(1);
+}
+
+// -----------------------------------------------------------------------------
+// Statistics.
+function summarize(samples) {
+    const sorted = [...samples].sort((a, b) => a - b);
+    const pick = (p) => sorted[Math.min(sorted.length - 1, Math.ceil((p / 100) * sorted.length) - 1)];
+    const mean = sorted.reduce((sum, v) => sum + v, 0) / sorted.length;
+    const variance = sorted.reduce((sum, v) => sum + (v - mean) ** 2, 0) / sorted.length;
+    const round = (v) => Math.round(v * 1000) / 1000;
+    return {
+        unit: 'ms',
+        n: sorted.length,
+        median: round(pick(50)),
+        p90: round(pick(90)),
+        p99: round(pick(99)),
+        min: round(sorted[0]),
+        max: round(sorted[sorted.length - 1]),
+        mean: round(mean),
+        stdev: round(Math.sqrt(variance)),
+    };
+}
+
+// -----------------------------------------------------------------------------
+// Fixed inputs.
+export function streamInput() {
+    const path = join(tmpdir(), 'zeroperl-bench-stream.txt');
+    if (!existsSync(path)) {
+        const lines = [];
+        for (let i = 0; i < 200000; i++) {
+            lines.push(`line ${i} value ${(i * 7919) % 100000} status ${i % 7 ? 'ok' : 'retry'}`);
+        }
+        writeFileSync(path, lines.join('\n') + '\n');
+    }
+    return path;
+}
+
+export function caseArgs(c) {
+    return c.script ? [join(BENCH_DIR, c.script), ...(c.args ?? [])] : c.args;
+}
+
+function caseBytes(c) {
+    return c.bytes ?? (c.stdin ? statSync(streamInput()).size : 0);
+}
+
+// Elapsed milliseconds for one child process, which must exit with status 0.
+function timeProcess(command, args, { stdin = null, env = process.env } = {}) {
+    const fd = stdin ? openSync(stdin, 'r') : 'ignore';
+    try {
+        const start = process.hrtime.bigint();
+        const r = spawnSync(command, args, { stdio: [fd, 'ignore', 'pipe'], env });
+        const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+        if (r.status !== 0) {
+            throw new Error(`exit status ${r.status}: ${String(r.stderr).trim()}`);
+        }
+        return elapsed;
+    } finally {
+        if (typeof fd === 'number') closeSync(fd);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Engines. Each returns the elapsed milliseconds for one iteration, or
+// throws if zeroperl did not exit with status 0.
+const engines = {
+    node: {
+        version: () => process.version,
+        setup(wasmPath) {
+            this.wasm = wasmPath;
+            this.bytes = readFileSync(wasmPath);
+            this.module = new WebAssembly.Module(this.bytes);
+            // A private compile cache, filled by the warmup iteration.
+            this.cacheDir = mkdtempSync(join(tmpdir(), 'zeroperl-bench-cache-'));
+        },
+        teardown() {
+            rmSync(this.cacheDir, { recursive: true, force: true });
+        },
+        run(c) {
+            if (c.process) {
+                const args = [RUNNER, ...(c.cached ? [] : ['--no-cache']), this.wasm, ...caseArgs(c)];
+                const env = { ...process.env, ZEROPERL_CACHE_DIR: this.cacheDir };
+                return timeProcess(process.execPath, args, { env });
+            }
+            const start = process.hrtime.bigint();
+            if (c.compileOnly) {
+                new WebAssembly.Module(this.bytes);
+                return Number(process.hrtime.bigint() - start) / 1e6;
+            }
+            if (c.instantiateOnly) {
+                const wasi = new WASI({ version: 'preview1', args: ['zeroperl'], env: ENV, returnOnExit: true });
+                new WebAssembly.Instance(this.module, wasi.getImportObject());
+                return Number(process.hrtime.bigint() - start) / 1e6;
+            }
+            const stdout = openSync('/dev/null', 'w');
+            const stdin = c.stdin ? openSync(streamInput(), 'r') : 0;
+            try {
+                // Node's WASI imports are synchronous, so the module never
+                // unwinds to the host and the Asyncify wrapper is not needed.
+                const wasi = new WASI({
+                    version: 'preview1',
+                    args: ['zeroperl', ...caseArgs(c)],
+                    env: ENV,
+                    preopens: { '/': '/' },
+                    returnOnExit: true,
+                    stdin,
+                    stdout,
+                });
+                const instance = new WebAssembly.Instance(this.module, wasi.getImportObject());
+                const status = wasi.start(instance);
+                if (status) {
+                    throw new Error(`exit status ${status}`);
+                }
+                // Linear memory never shrinks, so its final size is the peak.
+                this.memory = instance.exports.memory.buffer.byteLength;
+            } finally {
+                closeSync(stdout);
+                if (stdin) closeSync(stdin);
+            }
+            return Number(process.hrtime.bigint() - start) / 1e6;
+        },
+    },
+    wasmtime: {
+        version() {
+            const r = spawnSync('wasmtime', ['--version'], { encoding: 'utf8' });
+            return r.status === 0 ? r.stdout.trim() : null;
+        },
+        setup(wasmPath) {
+            this.wasm = wasmPath;
+            this.cwasm = join(tmpdir(), 'zeroperl-bench.cwasm');
+            this.why = [];
+            this.precompiled = precompiled(wasmPath, this.why);
+        },
+        run(c) {
+            if (c.cached) {
+                if (!this.precompiled) {
+                    throw new Error(`no usable .cwasm: ${this.why.join(', ')}`);
+                }
+                return timeProcess('wasmtime', ['run', '--allow-precompiled', '--dir=/', '--env', 'LC_ALL=C', '--argv0', 'zeroperl', this.precompiled, ...caseArgs(c)]);
+            }
+            // Disable the compilation cache so every run pays the same cost.
+            const cmd = c.compileOnly
+                ? ['compile', '-C', 'cache=n', '-o', this.cwasm, this.wasm]
+                : ['run', '-C', 'cache=n', '--dir=/', '--env', 'LC_ALL=C', '--argv0', 'zeroperl', this.wasm, ...caseArgs(c)];
+            return timeProcess('wasmtime', cmd, { stdin: c.stdin ? streamInput() : null });
+        },
+    },
+};
+
+function runBenchmarks(opts) {
+    const wasmPath = resolve(opts.wasm);
+    const bytes = readFileSync(wasmPath);
+    const meta = {
+        wasm: wasmPath,
+        size: bytes.length,
+        sha256: createHash('sha256').update(bytes).digest('hex'),
+        revision: process.env.GITHUB_SHA || null,
+        date: new Date().toISOString(),
+        iterations: opts.iterations,
+        host: { platform: platform(), release: release(), cpu: cpus()[0]?.model, cpus: cpus().length },
+        engines: {},
+    };
+    const results = {};
+
+    for (const name of opts.engines) {
+        const engine = engines[name];
+        if (!engine) usage(`unknown engine: ${name}`);
+        const version = engine.version();
+        if (!version) {
+            console.error(`${name}: not available, skipping`);
+            continue;
+        }
+        meta.engines[name] = version;
+        engine.setup(wasmPath);
+
+        for (const c of CASES) {
+            const key = `${name}.${c.name}`;
+            if (opts.filter && !opts.filter.test(key)) continue;
+            if (c.engines && !c.engines.includes(name)) continue;
+            try {
+                engine.run(c); // warmup
+                const samples = [];
+                for (let i = 0; i < opts.iterations; i++) {
+                    samples.push(engine.run(c));
+                }
+                results[key] = summarize(samples);
+                const bytes = caseBytes(c);
+                if (bytes) {
+                    // Throughput, for comparing e.g. the scalar and SIMD builds.
+                    results[key].mb_per_s = Math.round((bytes / 1e6 / (results[key].median / 1000)) * 100) / 100;
+                }
+                if (engine.memory) {
+                    results[key].memory_bytes = engine.memory;
+                    engine.memory = 0;
+                }
+                console.error(`${key.padEnd(24)} median ${results[key].median} ms  p90 ${results[key].p90} ms`);
+            } catch (err) {
+                if (!c.optional) throw new Error(`${key}: ${err.message}`);
+                results[key] = { skipped: err.message };
+                console.error(`${key.padEnd(24)} skipped (${err.message})`);
+            }
+        }
+        engine.teardown?.();
+    }
+    return { meta, results };
+}
+
+// -----------------------------------------------------------------------------
+// Compare two result files and fail on median regressions above the threshold.
+function compare([basePath, newPath], threshold) {
+    const base = JSON.parse(readFileSync(basePath, 'utf8')).results;
+    const next = JSON.parse(readFileSync(newPath, 'utf8')).results;
+    let regressions = 0;
+    for (const key of Object.keys(next).sort()) {
+        const a = base[key]?.median;
+        const b = next[key]?.median;
+        if (a === undefined || b === undefined) {
+            console.log(`${key.padEnd(24)} ${a ?? '-'} -> ${b ?? '-'}`);
+            continue;
+        }
+        const delta = ((b - a) / a) * 100;
+        const flag = delta > threshold ? '  REGRESSION' : '';
+        if (flag) regressions++;
+        const ma = base[key].memory_bytes;
+        const mb = next[key].memory_bytes;
+        const mem = ma && mb ? `  memory ${(ma / 1048576).toFixed(1)} -> ${(mb / 1048576).toFixed(1)} MiB` : '';
+        console.log(`${key.padEnd(24)} ${a} -> ${b} ms (${delta >= 0 ? '+' : ''}${delta.toFixed(1)}%)${flag}${mem}`);
+    }
+    process.exit(regressions ? 1 : 0);
+}
+
+// The cases and inputs are shared with pgo-train.mjs, so only run when
+// invoked directly.
+if (process.argv[1] && resolve(process.argv[1]) === fileURLToPath(import.meta.url)) {
+    main();
+}
+
+function main() {
+    const opts = parseArgs(process.argv.slice(2));
+    if (opts.compare) {
+        compare(opts.compare, opts.threshold);
+    } else {
+        if (!opts.wasm) usage('--wasm is required');
+        const report = runBenchmarks(opts);
+        const json = JSON.stringify(report, null, 2);
+        if (opts.out) {
+            writeFileSync(opts.out, json + '\n');
+            console.error(`Wrote ${opts.out}`);
+        } else {
+            console.log(json);
+        }
+    }
+}
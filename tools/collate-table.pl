@@ -0,0 +1,46 @@
+#!/usr/bin/env perl
+#
+# collate-table.pl
+#
+# Parses the part of the default Unicode::Collate table that the XS does
+# not serve directly (contractions, expansions and @-directives, returned
+# by _fetch_rest) and writes the result as Unicode/Collate/default.bin.
+# The patched Collate.pm (patches/collate.patch) unpacks that file instead
+# of running parseEntry() over every line on each new().
+#
+# Runs with the native build's perl, which has the same Unicode::Collate.
+#
+# Usage:
+#   perl collate-table.pl <output file>
+#
+use strict;
+use warnings;
+use Unicode::Collate;
+
+my $out = shift or die "Usage: $0 <output file>\n";
+
+# Same steps as read_table() for a default collator.
+my $c = bless { __useXS => \&Unicode::Collate::_fetch_simple }, 'Unicode::Collate';
+for my $line (Unicode::Collate::_fetch_rest()) {
+    next if $line =~ /^\s*#/;
+    if ($line =~ s/^\s*\@//) {
+        $c->parseAtmark($line);
+    } else {
+        $c->parseEntry($line);
+    }
+}
+
+# The loader only restores these fields; fail the build rather than drop one.
+my %known = map { $_ => 1 } qw(__useXS versionTable mapping maxlength contraction);
+my @extra = grep { !$known{$_} } sort keys %$c;
+die "collate-table.pl: unexpected fields from read_table: @extra\n" if @extra;
+
+my $map = pack '(w/a w/a)*', map { $_ => join '', @{ $c->{mapping}{$_} } } sort keys %{ $c->{mapping} };
+my $max = pack '(w/a w)*', map { $_ => $c->{maxlength}{$_} } sort keys %{ $c->{maxlength} || {} };
+my $con = pack '(w/a)*', sort keys %{ $c->{contraction} || {} };
+
+open my $fh, '>:raw', $out or die "$out: $!\n";
+print $fh pack 'a4 w/a w/a w/a w/a w/a', 'ZPUC', $Unicode::Collate::VERSION, $c->{versionTable} // '', $map, $max, $con;
+close $fh or die "$out: $!\n";
+
+printf "Wrote %s: %d entries, %d bytes\n", $out, scalar keys %{ $c->{mapping} }, -s $out;
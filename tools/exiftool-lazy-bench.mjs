@@ -0,0 +1,157 @@
+#!/usr/bin/env node
+/**
+ * exiftool-lazy-bench.mjs
+ *
+ * Per-image cost of ExifTool's tag tables, loaded lazily and eagerly. Each
+ * image is read by ExifTool in a fresh instance, as a one-shot `exiftool`
+ * would, once with the tables that tools/exiftool-split.pl moved out
+ * loaded on first use (the default) and once with ZEROPERL_EXIFTOOL_LAZY=0,
+ * which loads every table of a module when it is required, as the unsplit
+ * modules do. The two modes alternate, --runs times per image.
+ *
+ * For each mode it reports the median wall time per image, and from the
+ * ZEROPERL_MEMORY_STATS summary the linear memory and malloc peak (the
+ * largest of the runs) and the SFS bytes read. Results are grouped by file
+ * extension. The tags extracted must be identical in both modes, or the
+ * script exits with status 1.
+ *
+ * Runs the precompiled .cwasm next to the module when tools/aot.mjs says it
+ * matches, as the per-process model would in production.
+ *
+ * Usage:
+ *   ./exiftool-lazy-bench.mjs --wasm <zeroperl.wasm> [--runs N] [--json <out.json>] file ...
+ */
+import { createHash } from 'node:crypto';
+import { spawnSync } from 'node:child_process';
+import { writeFileSync } from 'node:fs';
+import { extname, resolve } from 'node:path';
+import { wasmtimeArgs } from './aot.mjs';
+
+// Prints every tag of one file. Binary values are printed by length, so
+// the output does not depend on where they were allocated.
+const SCRIPT = `
+    use Image::ExifTool;
+    my $info = Image::ExifTool::ImageInfo($ARGV[0]);
+    for my $tag (sort keys %$info) {
+        my $v = $info->{$tag};
+        $v = ref $v eq 'SCALAR' ? 'binary ' . length($$v)
+           : ref $v eq 'ARRAY' ? join(',', @$v) : $v;
+        print "$tag\\t$v\\n";
+    }`;
+
+const MODES = [
+    { name: 'lazy', env: {} },
+    { name: 'eager', env: { ZEROPERL_EXIFTOOL_LAZY: '0' } },
+];
+
+function usage(msg) {
+    if (msg) console.error(msg);
+    console.error('Usage: exiftool-lazy-bench.mjs --wasm <zeroperl.wasm> [--runs N] [--json <out.json>] file ...');
+    process.exit(2);
+}
+
+function parseArgs(argv) {
+    const opts = { runs: 3, files: [] };
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        if (arg === '--wasm' && i + 1 < argv.length) opts.wasm = resolve(argv[++i]);
+        else if (arg === '--runs' && i + 1 < argv.length) opts.runs = parseInt(argv[++i], 10);
+        else if (arg === '--json' && i + 1 < argv.length) opts.json = argv[++i];
+        else if (arg.startsWith('--')) usage(`unknown argument: ${arg}`);
+        else opts.files.push(resolve(arg));
+    }
+    if (!opts.wasm || !opts.files.length) usage();
+    return opts;
+}
+
+// "memory: linear N (static S), malloc live L peak P" and
+// "memory: SFS a open (peak b), c opened, d bytes read"
+function memory(stderr) {
+    const linear = stderr.match(/^memory: linear (\d+) .*malloc live \d+ peak (\d+)/m);
+    const sfs = stderr.match(/^memory: SFS .* (\d+) bytes read/m);
+    return {
+        linear: linear ? Number(linear[1]) : 0,
+        mallocPeak: linear ? Number(linear[2]) : 0,
+        sfsRead: sfs ? Number(sfs[1]) : 0,
+    };
+}
+
+function run(wasm, env, file) {
+    const args = wasmtimeArgs(wasm, ['-e', SCRIPT, file], { env: { LC_ALL: 'C', ZEROPERL_MEMORY_STATS: '1', ...env } });
+    const start = process.hrtime.bigint();
+    const r = spawnSync('wasmtime', args, { encoding: 'utf8', maxBuffer: 1 << 28, stdio: ['ignore', 'pipe', 'pipe'] });
+    const ms = Number(process.hrtime.bigint() - start) / 1e6;
+    if (r.status !== 0) {
+        console.error(r.stderr);
+        throw new Error(`${file}: wasmtime exited with status ${r.status}`);
+    }
+    return { ms, digest: createHash('sha256').update(r.stdout).digest('hex'), ...memory(r.stderr) };
+}
+
+function median(values) {
+    const sorted = [...values].sort((a, b) => a - b);
+    return sorted[Math.floor(sorted.length / 2)];
+}
+
+const mib = (bytes) => (bytes / 1048576).toFixed(1);
+const pct = (a, b) => `${a <= b ? '' : '+'}${((a / b - 1) * 100).toFixed(1)}%`;
+
+const opts = parseArgs(process.argv.slice(2));
+const images = [];
+for (const file of opts.files) {
+    const image = { file, format: extname(file).slice(1).toUpperCase() || '-' };
+    const runs = Object.fromEntries(MODES.map((m) => [m.name, []]));
+    for (let i = 0; i < opts.runs; i++) {
+        for (const mode of MODES) runs[mode.name].push(run(opts.wasm, mode.env, file));
+    }
+    for (const mode of MODES) {
+        const r = runs[mode.name];
+        image[mode.name] = {
+            ms: median(r.map((x) => x.ms)),
+            linear: Math.max(...r.map((x) => x.linear)),
+            mallocPeak: Math.max(...r.map((x) => x.mallocPeak)),
+            sfsRead: r[0].sfsRead,
+        };
+    }
+    image.identical = new Set(MODES.flatMap((m) => runs[m.name].map((x) => x.digest))).size === 1;
+    images.push(image);
+}
+
+// Per format, and for all images: the mean of the per-image medians, the
+// largest linear memory and malloc peak, and the mean SFS bytes read.
+function summarize(list) {
+    const out = { files: list.length, identical: list.every((i) => i.identical) };
+    for (const mode of MODES) {
+        out[mode.name] = {
+            ms: list.reduce((s, i) => s + i[mode.name].ms, 0) / list.length,
+            linear: Math.max(...list.map((i) => i[mode.name].linear)),
+            mallocPeak: Math.max(...list.map((i) => i[mode.name].mallocPeak)),
+            sfsRead: list.reduce((s, i) => s + i[mode.name].sfsRead, 0) / list.length,
+        };
+    }
+    return out;
+}
+
+const formats = {};
+for (const image of images) (formats[image.format] ??= []).push(image);
+const rows = Object.keys(formats).sort().map((f) => [f, summarize(formats[f])]);
+rows.push(['all', summarize(images)]);
+
+console.log(`${images.length} images, one instance each, median of ${opts.runs} runs; ms is the mean per image\n`);
+console.log('format  files   lazy ms  eager ms  change   linear MiB lazy/eager   malloc peak MiB   SFS KiB read');
+for (const [format, s] of rows) {
+    const { lazy, eager } = s;
+    console.log(`${format.padEnd(7)} ${String(s.files).padStart(5)} ${lazy.ms.toFixed(1).padStart(9)} ${eager.ms.toFixed(1).padStart(9)} ` +
+        `${pct(lazy.ms, eager.ms).padStart(7)} ${`${mib(lazy.linear)} / ${mib(eager.linear)}`.padStart(23)} ` +
+        `${`${mib(lazy.mallocPeak)} / ${mib(eager.mallocPeak)}`.padStart(17)} ` +
+        `${`${(lazy.sfsRead / 1024).toFixed(0)} / ${(eager.sfsRead / 1024).toFixed(0)}`.padStart(14)}` +
+        `${s.identical ? '' : '  OUTPUT DIFFERS'}`);
+}
+if (opts.json) {
+    writeFileSync(opts.json, JSON.stringify({ runs: opts.runs, formats: Object.fromEntries(rows), images }, null, 2) + '\n');
+}
+const differ = images.filter((i) => !i.identical);
+if (differ.length) {
+    console.error(`\nthe extracted tags differ between lazy and eager loading: ${differ.map((i) => i.file).join(', ')}`);
+    process.exit(1);
+}
@@ -0,0 +1,431 @@
+#!/usr/bin/env perl
+#
+# exiftool-split.pl
+#
+# Moves the larger tag tables of ExifTool's modules into files of their
+# own, so that require compiles only the tables an image uses. A table
+# such as
+#
+#   %Image::ExifTool::Canon::Main = (
+#       ...
+#   );
+#
+# becomes auto/Image/ExifTool/Canon/Main.pl, holding the list in
+# parentheses, and the module gets in its place
+#
+#   Image::ExifTool::LazyTable::Define(\%Image::ExifTool::Canon::Main,
+#       \&_LoadLazyTable, 'Image/ExifTool/Canon/Main');
+#
+# plus, at its end, the _LoadLazyTable sub that evaluates a table's source.
+# Image::ExifTool::LazyTable (lib/) ties the hash and loads the table on its
+# first use.
+#
+# A table is only moved if evaluating it later gives the same result:
+#   - the module has one package statement, and the table starts with
+#     "%Name = (" and ends with ");" at the start of a line, as ExifTool
+#     writes them;
+#   - outside the subs it defines, the table reads no variable and calls
+#     nothing: it may take references (\%hash, \&sub), but not expand a
+#     hash, interpolate a string, or call a function, as these would see
+#     the state at its first use instead;
+#   - each of the module's file-scoped lexicals it names, anywhere, is
+#     declared once, before the table;
+#   - there is nothing here that the scanner below cannot read, such as a
+#     here-document.
+# Tables of less than --min bytes stay where they are.
+#
+# --check <dir> then loads every module of the split tree and of <dir>,
+# the same ExifTool unsplit, with this perl, and compares every tag table
+# both define after loading. Modules whose tables differ, or fail to load,
+# are put back as they were.
+#
+# Usage:
+#   perl exiftool-split.pl [--min BYTES] [--check <unsplit lib dir>] <lib dir>
+#
+use strict;
+use warnings;
+use File::Find;
+use File::Path qw(make_path remove_tree);
+use File::Spec;
+use File::Temp qw(tempdir);
+use FindBin;
+use Getopt::Long;
+
+my $min = 2048;
+my $check;
+GetOptions('min=i' => \$min, 'check=s' => \$check)
+    and @ARGV == 1 or die "Usage: $0 [--min BYTES] [--check <unsplit lib dir>] <lib dir>\n";
+my $lib = shift;
+
+# module path relative to $lib => { src, out, tables => [ names ], moved }
+my %split;
+my @modules;
+find(sub { push @modules, $File::Find::name if /\.pm$/ }, "$lib/Image/ExifTool");
+for my $path (sort @modules) {
+    (my $rel = $path) =~ s{^\Q$lib\E/}{};
+    my $src = ReadFile($path);
+    my ($out, @chunks) = Split($rel, $src);
+    next unless @chunks;
+    (my $dir = $rel) =~ s/\.pm$//;
+    make_path("$lib/auto/$dir");
+    my $moved = 0;
+    for my $chunk (@chunks) {
+        WriteFile("$lib/auto/$dir/$$chunk{file}", $$chunk{source});
+        $moved += length $$chunk{source};
+    }
+    WriteFile($path, $out);
+    $split{$rel} = { src => $src, out => $out, tables => [ map { $$_{table} } @chunks ], moved => $moved };
+}
+
+if ($check and %split) {
+    for my $rel (Compare($check, $lib, \%split)) {
+        print "exiftool-split.pl: restoring $rel\n";
+        WriteFile("$lib/$rel", $split{$rel}{src});
+        (my $dir = $rel) =~ s/\.pm$//;
+        remove_tree("$lib/auto/$dir");
+        delete $split{$rel};
+    }
+}
+
+my ($tables, $before, $after, $moved) = (0, 0, 0, 0);
+for my $module (values %split) {
+    $tables += @{$$module{tables}};
+    $before += length $$module{src};
+    $after += length $$module{out};
+    $moved += $$module{moved};
+}
+printf "Split %d tables out of %d modules: %d bytes of modules became %d, plus %d in auto/\n",
+    $tables, scalar keys %split, $before, $after, $moved;
+
+#------------------------------------------------------------------------------
+# Returns the module with its tables replaced, and the tables moved out:
+# { table => full name, file => name in auto/, source => text }.
+sub Split
+{
+    my ($rel, $src) = @_;
+    my @lines = split /^/, $src;
+    (my $modPath = $rel) =~ s/\.pm$//;
+
+    my @packages = grep { /^\s*package\s+[\w:]+\s*;/ } @lines;
+    return ($src) unless @packages == 1 and $src !~ /\b_LoadLazyTable\b/;
+    my ($package) = $packages[0] =~ /package\s+([\w:]+)/;
+
+    # File-scoped lexicals, name => [ line of each declaration ], and where
+    # the code ends: at __END__, or else before a trailing block of POD.
+    my (%lexicals, $podStart);
+    my ($pod, $end) = (0, scalar @lines);
+    for my $i (0 .. $#lines) {
+        local $_ = $lines[$i];
+        if (/^=(\w+)/) {
+            $podStart = $i unless $pod;
+            $pod = $1 ne 'cut';
+            next;
+        }
+        next if $pod;
+        if (/^__(END|DATA)__\b/) { $end = $i; last }
+        if (/^my\s*\(([^)]*)\)/ or /^my\s+([\$\@%]\w+)/) {
+            push @{$lexicals{$_}}, $i for $1 =~ /([\$\@%]\w+)/g;
+        }
+    }
+    $end = $podStart if $pod and $end == @lines;
+
+    my (@out, @chunks, %used);
+    $pod = 0;
+    for (my $i = 0; $i < $end; $i++) {
+        my $line = $lines[$i];
+        $pod = $1 ne 'cut' if $line =~ /^=(\w+)/;
+        my ($table) = $pod ? () : $line =~ /^%(\w+(?:::\w+)+)\s*=\s*\(\s*(?:#.*)?$/;
+        my $last = $i + 1;
+        if ($table) {
+            $last++ while $last < $end and $lines[$last] !~ /^\);\s*(?:#.*)?$/;
+        }
+        my $body = $table && $last < $end ? join('', @lines[$i + 1 .. $last - 1]) : '';
+        my $uses = length($body) >= $min ? Uses($body, \%lexicals, $i) : undef;
+        unless ($uses) {
+            push @out, $line;
+            next;
+        }
+        $used{$_} = 1 for @$uses;
+        (my $file = $table) =~ s/^\Q$package\E:://;
+        $file =~ s/::/-/g;
+        push @chunks, {
+            table  => $table,
+            file   => "$file.pl",
+            source => "#line " . ($i + 1) . " \"$rel\"\n(\n$body)\n",
+        };
+        push @out, "require Image::ExifTool::LazyTable;\n" if @chunks == 1;
+        push @out, "Image::ExifTool::LazyTable::Define(\\%$table, \\&_LoadLazyTable, '$modPath/$file');\n",
+                   "#line " . ($last + 2) . "\n";
+        $i = $last;
+    }
+    return ($src) unless @chunks;
+    return (join('', @out, LoaderSub(sort keys %used), @lines[$end .. $#lines]), @chunks);
+}
+
+# The sub a split module ends with. It names the lexicals that the tables
+# use, so that the eval can still see them. Should a table name one that
+# it cannot see, the eval fails rather than leave the variable undefined.
+sub LoaderSub
+{
+    my @names = @_;
+    return "\n# Evaluates a tag table moved out by exiftool-split.pl (see Image::ExifTool::LazyTable).\n",
+           "sub _LoadLazyTable\n{\n",
+           (@names ? '    () = (' . join(', ', map { "\\$_" } @names) . ");\n" : ''),
+           "    use warnings FATAL => 'closure';\n",
+           "    return eval \$_[0];\n}\n\n";
+}
+
+# The module's file-scoped lexicals that a table body names, or undef if
+# the table cannot be moved (see the list at the top).
+sub Uses
+{
+    my ($body, $lexicals, $start) = @_;
+    my $tokens = Tokens($body) or return undef;
+    my (@subs, %names);
+    my $depth = 0;
+    for my $n (0 .. $#$tokens) {
+        my ($type, $text, $vars) = @{$$tokens[$n]};
+        my $prev = $n ? $$tokens[$n - 1] : [ '', '' ];
+        my $next = $n < $#$tokens ? $$tokens[$n + 1][1] : '';
+        $names{$_} = 1 for @{$vars || []};
+        if ($text =~ /^[{(\[]$/ and $type eq 'op') {
+            $depth++;
+            # "sub {", or "sub ($$) {" with a prototype
+            push @subs, $depth if $text eq '{' and ($$prev[1] eq 'sub' or $$prev[0] eq 'proto');
+            next;
+        }
+        if ($text =~ /^[})\]]$/ and $type eq 'op') {
+            return undef if --$depth < 0;
+            pop @subs if @subs and $subs[-1] > $depth;
+            next;
+        }
+        # What follows is evaluated when the table is defined.
+        next if @subs;
+        if ($type eq 'var') {
+            return undef unless $$prev[1] eq '\\' and $text =~ /^[\$\@%&]\w/;
+        } elsif ($type eq 'str') {
+            return undef if @$vars;
+        } elsif ($type eq 'word') {
+            return undef unless $next eq '=>' or $text =~ /^(sub|undef|x)$/;
+        } elsif ($type eq 'op') {
+            return undef if $text =~ /^(?:->|\+\+|--|[\$\@%&]|.*[^=!<>]=)$/ or $text eq '=';
+        }
+    }
+    return undef if $depth;
+    my @uses;
+    for my $name (sort keys %names) {
+        my $decl = $$lexicals{$name} or next;
+        return undef unless @$decl == 1 and $$decl[0] < $start;
+        push @uses, $name;
+    }
+    return \@uses;
+}
+
+# Splits Perl source into [ type, text, variables ] tokens, where type is
+# num, str, var, word, proto or op. A string, regex or other quote-like
+# operator is one str token, with the variables it interpolates. A var
+# token has the variable it reads: for an element, the whole hash or
+# array; for a dereference such as %$x, the scalar. Returns undef for
+# source it does not handle.
+sub Tokens
+{
+    my $src = shift;
+    my @tokens;
+    my $regexOK = 1;    # whether a "/" here starts a regex
+    pos($src) = 0;
+    while (pos($src) < length $src) {
+        next if $src =~ /\G\s+/gc or $src =~ /\G#[^\n]*/gc;
+        return undef if $src =~ /\G<<\s*["'~\w]/gc;
+        my $token;
+        if ($src =~ /\G(['"`])/gc) {
+            my $text = Delimited(\$src, $1) // return undef;
+            $token = [ 'str', $text, $1 eq "'" ? [] : Interpolated($text) ];
+        } elsif ($src =~ /\G(?<![\w\$\@%&>:-])(qq|qw|qr|q|m|s|tr|y)\s*([^\w\s=,;)}\]>])/gc or
+                 @tokens and $tokens[-1][1] =~ /^[=!]~$/ and $src =~ /\G(m|s|tr|y)\s*([^\w\s])/gc) {
+            my ($op, $delim) = ($1, $2);
+            my $text = Delimited(\$src, $delim) // return undef;
+            if ($op =~ /^(s|tr|y)$/) {
+                if ($delim =~ /[\[({<]/) {
+                    $src =~ /\G\s*([^\w\s])/gc or return undef;
+                    $delim = $1;
+                }
+                $text .= Delimited(\$src, $delim) // return undef;
+            }
+            $src =~ /\G[a-z]*/gc;
+            my $plain = $op =~ /^(q|qw|tr|y)$/ || $delim eq "'";
+            $token = [ 'str', $text, $plain ? [] : Interpolated($text) ];
+        } elsif ($regexOK and $src =~ /\G\//gc) {
+            my $text = Delimited(\$src, '/') // return undef;
+            $src =~ /\G[a-z]*/gc;
+            $token = [ 'str', $text, Interpolated($text) ];
+        } elsif ($src =~ /\G((\$#|[\$\@%&])(\$*)(\w+(?:::\w+)*))/gc) {
+            my ($text, $sigil, $deref, $name) = ($1, $2, $3, $4);
+            if ($deref) {
+                $sigil = '$';
+            } elsif ($sigil eq '$#') {
+                $sigil = '@';
+            } elsif ($sigil =~ /[\$\@]/ and $src =~ /\G\s*([\[{])/) {
+                $sigil = $1 eq '{' ? '%' : '@';
+            }
+            $token = [ 'var', $text, [ "$sigil$name" ] ];
+        } elsif ($src =~ /\G(\$(?:\^\w|[^\w\s{}\$#]|\$(?![\w{\$])))/gc) {
+            # $], $; and the other punctuation variables
+            $token = [ 'var', $1, [] ];
+        } elsif (@tokens and ($tokens[-1][1] eq 'sub' or @tokens > 1 and $tokens[-2][1] eq 'sub') and $src =~ /\G\(([\$\@%;\\\[\]&*+]*)\)(?=\s*[{;])/gc) {
+            $token = [ 'proto', $1 ];
+        } elsif ($src =~ /\G(\d[\w.]*)/gc) {
+            $token = [ 'num', $1 ];
+        } elsif ($src =~ /\G(\w+(?:::\w+)*(?:::)?)/gc) {
+            $token = [ 'word', $1 ];
+        } elsif ($src =~ /\G(=>|->|\+\+|--|<=>|\*\*=?|&&=?|\|\|=?|\/\/=?|<<=?|>>=?|[=!<>]=|[=!]~|\.\.\.?|[-+*\/.%x&|^]=|\$#|.)/gcs) {
+            $token = [ 'op', $1 ];
+        } else {
+            return undef;
+        }
+        push @tokens, $token;
+        # A regex can follow an operator or one of these words, but not a
+        # value or a closing bracket.
+        $regexOK = $$token[0] eq 'op' ? $$token[1] !~ /^[)\]}]$/ :
+                   $$token[0] eq 'word' && $$token[1] =~ /^(and|or|not|if|unless|while|until|return|split|grep|map|x|eq|ne|lt|gt|le|ge|cmp)$/;
+    }
+    return \@tokens;
+}
+
+# The text before the delimiter that closes $open, which has just been
+# read. Brackets nest. Returns undef if it is never closed.
+sub Delimited
+{
+    my ($src, $open) = @_;
+    my %close = ('(' => ')', '[' => ']', '{' => '}', '<' => '>');
+    my $close = $close{$open} // $open;
+    my $start = pos($$src);
+    my $depth = 1;
+    while ($$src =~ /\G(?:\\.|([^\\]))/gcs) {
+        next unless defined $1;
+        if ($1 eq $close) {
+            return substr($$src, $start, pos($$src) - $start - 1) unless --$depth;
+        } elsif ($1 eq $open and $close ne $open) {
+            $depth++;
+        }
+    }
+    return undef;
+}
+
+# The variables a double-quoted string or a regex interpolates.
+sub Interpolated
+{
+    my $text = shift;
+    my @vars;
+    while ($text =~ /(?<!\\)((?:\\\\)*)([\$\@])\{?(\$*)(\w+(?:::\w+)*)\}?(\s*[\[{])?/g) {
+        my ($sigil, $deref, $name, $subscript) = ($2, $3, $4, $5);
+        next if $sigil eq '@' and $name =~ /^\d/;
+        if ($deref) {
+            $sigil = '$';
+        } elsif ($subscript) {
+            $sigil = $subscript =~ /\{/ ? '%' : '@';
+        }
+        push @vars, "$sigil$name";
+    }
+    return \@vars;
+}
+
+#------------------------------------------------------------------------------
+# Loads the split modules from each tree in a perl of their own and
+# compares every hash in the Image::ExifTool packages after loading. The
+# unsplit tree is loaded twice, and hashes that differ between those two
+# are left out. Returns the modules to put back: those with a table that
+# differs or did not load, or all of them for a difference that no split
+# module accounts for.
+sub Compare
+{
+    my ($unsplit, $lib, $split) = @_;
+    my @rels = sort keys %$split;
+    # Only the ExifTool part of $lib: the rest is for wasm32-wasi.
+    my $tmp = tempdir(CLEANUP => 1);
+    my $abs = File::Spec->rel2abs($lib);
+    make_path("$tmp/auto");
+    symlink("$abs/Image", "$tmp/Image") and symlink("$abs/auto/Image", "$tmp/auto/Image")
+        or die "symlink: $!\n";
+    my %got = Dump([ $tmp, "$FindBin::Bin/../lib" ], @rels);
+    my %want = Dump([ $unsplit ], @rels);
+    my %again = Dump([ $unsplit ], @rels);
+
+    my %owner;
+    for my $rel (@rels) {
+        (my $package = $rel) =~ s/\.pm$//;
+        $package =~ s{/}{::}g;
+        $owner{$_} = $rel for $rel, "${package}::*", @{$$split{$rel}{tables}};
+    }
+    my (%bad, @other);
+    for my $name (sort keys %{{ %got, %want }}) {
+        my ($x, $y) = ($got{$name} // 'missing', $want{$name} // 'missing');
+        next if $x eq $y and $x !~ /^ERROR/ or $y ne ($again{$name} // 'missing');
+        (my $package = $name) =~ s/::\w+$/::*/;
+        my $rel = $owner{$name} // $owner{$package};
+        if ($rel) {
+            $bad{$rel} = 1;
+        } else {
+            push @other, $name;
+        }
+        print "exiftool-split.pl: $name differs", ($x =~ /^ERROR/ ? " ($x)" : ''), "\n";
+    }
+    return @other ? @rels : sort keys %bad;
+}
+
+# Table name => md5 of its contents, or "ERROR: ..."; for a module that
+# failed to load, its path => "ERROR: ...".
+sub Dump
+{
+    my ($inc, @rels) = @_;
+    my $script = <<'EOT';
+use strict;
+use Data::Dumper;
+use Digest::MD5 qw(md5_hex);
+$Data::Dumper::Sortkeys = 1;
+$Data::Dumper::Useqq = 1;
+$Data::Dumper::Indent = 1;
+sub Error { (my $err = shift) =~ s/\s+/ /g; return "ERROR: $err" }
+require Image::ExifTool;
+for my $rel (@ARGV) {
+    eval { require $rel; 1 } or print "$rel\t", Error($@), "\n";
+}
+my @packages = ('Image::ExifTool');
+my %seen;
+while (my $package = shift @packages) {
+    no strict 'refs';
+    for my $name (sort keys %{"${package}::"}) {
+        if ($name =~ /^(\w+)::$/) {
+            push @packages, "${package}::$1" unless $1 eq 'LazyTable';
+            next;
+        }
+        my $hash = $name =~ /^\w+$/ && *{"${package}::$name"}{HASH} or next;
+        next if $seen{$hash}++;
+        my $dump = eval { Dumper({ %$hash }) };
+        print "${package}::$name\t", defined $dump ? md5_hex($dump) : Error($@), "\n";
+    }
+}
+EOT
+    open my $fh, '-|', $^X, (map { ('-I', $_) } @$inc), '-e', $script, @rels or die "$^X: $!\n";
+    my %dump = map { chomp; split /\t/, $_, 2 } <$fh>;
+    close $fh;
+    return %dump;
+}
+
+sub ReadFile
+{
+    my $path = shift;
+    open my $fh, '<:raw', $path or die "$path: $!\n";
+    local $/;
+    my $src = <$fh>;
+    close $fh;
+    return $src;
+}
+
+sub WriteFile
+{
+    my ($path, $data) = @_;
+    chmod 0644, $path if -e $path;
+    open my $fh, '>:raw', $path or die "$path: $!\n";
+    print $fh $data;
+    close $fh or die "$path: $!\n";
+}
@@ -0,0 +1,68 @@
+# exiftool-stay-open.pl
+#
+# The request loop of `exiftool -stay_open True -@ -`, on top of the
+# Image::ExifTool module that the build-exiftool SFS carries (the exiftool
+# script itself is not bundled). Used by tools/exiftool.mjs.
+#
+# Arguments arrive on STDIN one per line. "-execute[NUM]" runs the request
+# gathered so far and prints its tags as a JSON object, then "{readyNUM}".
+# "-stay_open" followed by "False" ends the loop. Within a request:
+#   FILE          the image to read
+#   -buffer=LEN   the image is the next LEN raw bytes on STDIN
+#   -n            no print conversion
+#   -TAG          extract only TAG (may be repeated)
+use strict;
+use warnings;
+use Image::ExifTool;
+use JSON::PP ();
+
+binmode STDIN;
+binmode STDOUT;
+$| = 1;
+
+# ExifTool returns UTF-8 byte strings, which are written out unchanged.
+my $json = JSON::PP->new->canonical;
+my $et = Image::ExifTool->new;
+
+# Binary values come back as scalar references and lists as array references.
+sub plain {
+    my $value = shift;
+    return $$value if ref $value eq 'SCALAR';
+    return [ map { plain($_) } @$value ] if ref $value eq 'ARRAY';
+    return ref $value ? "$value" : $value;
+}
+
+my (@tags, $file, $data, $numeric);
+while (defined(my $arg = <STDIN>)) {
+    chomp $arg;
+    if ($arg =~ /^-execute(\d*)$/) {
+        my $ready = $1;
+        my %out;
+        if (defined $file || defined $data) {
+            $out{SourceFile} = $file // '-';
+            $et->Options(PrintConv => $numeric ? 0 : 1);
+            my $info = eval { $et->ImageInfo(defined $data ? \$data : $file, @tags) }
+                || { Error => ($@ || 'ImageInfo failed') =~ s/\s+$//r };
+            $out{$_} = plain($info->{$_}) for keys %$info;
+        } else {
+            $out{Error} = 'No file specified';
+        }
+        print $json->encode(\%out), "\n{ready$ready}\n";
+        (@tags, $file, $data, $numeric) = ();
+    } elsif ($arg eq '-stay_open') {
+        my $flag = <STDIN> // 'False';
+        last if $flag =~ /^(false|0)$/i;
+    } elsif ($arg =~ /^-buffer=(\d+)$/) {
+        my $len = $1;
+        $data = '';
+        while (length $data < $len) {
+            read(STDIN, $data, $len - length $data, length $data) or last;
+        }
+    } elsif ($arg eq '-n') {
+        $numeric = 1;
+    } elsif ($arg =~ /^-(\w[\w:-]*)$/) {
+        push @tags, $1;
+    } elsif (length $arg) {
+        $file = $arg;
+    }
+}
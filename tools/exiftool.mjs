@@ -0,0 +1,443 @@
+#!/usr/bin/env node
+/**
+ * exiftool.mjs
+ *
+ * Batch ExifTool driver. Instead of one `zeroperl exiftool file.jpg` per
+ * image, each worker thread keeps one zeroperl instance running the
+ * `-stay_open` request loop (tools/exiftool-stay-open.pl by default, or
+ * a real exiftool script given with --exiftool) and feeds it requests
+ * through stdin. Several requests per instance are kept in flight, and
+ * results are returned as soon as their `{readyN}` marker is written.
+ * Parallelism comes from running one instance per worker.
+ *
+ * Stdin is served through the Asyncify-wrapped fd_read, so the instance
+ * suspends while its worker waits for the next request instead of
+ * blocking the thread.
+ *
+ * Usage:
+ *   ./exiftool.mjs --wasm <zeroperl.wasm> [--jobs N] [--depth N]
+ *                  [--exiftool <script>] [-n] [-TAG ...] [file ...]
+ *   ./exiftool.mjs --wasm <zeroperl.wasm> --bench [--jobs N] file ...
+ *
+ * With no files, paths are read from stdin, one per line. Each result is
+ * written to stdout as one line of JSON as soon as it is ready.
+ *
+ *   const pool = await ExifToolPool.create(wasmBytes, { jobs: 4 });
+ *   const tags = await pool.extract('/images/a.jpg');
+ *   const more = await pool.extract(buffer, ['-n']);
+ *   await pool.close();
+ *
+ * Requires a Node.js with `WASI.prototype.finalizeBindings` (v22 or later).
+ */
+import { readFileSync, unlinkSync, writeFileSync } from 'node:fs';
+import { availableParallelism, tmpdir } from 'node:os';
+import { join, resolve } from 'node:path';
+import { createInterface } from 'node:readline';
+import { fileURLToPath } from 'node:url';
+import { WASI } from 'node:wasi';
+import { isMainThread, parentPort, Worker, workerData } from 'node:worker_threads';
+import { compileModule } from './aot.mjs';
+import { instantiate } from './asyncify.mjs';
+import { ZeroperlExit } from './snapshot.mjs';
+
+const SERVER_SCRIPT = fileURLToPath(new URL('./exiftool-stay-open.pl', import.meta.url));
+const READY = Buffer.from('{ready');
+// Asyncify saves the unwound Perl stack here while a read waits for input;
+// the default 1000 bytes below the data segment are not enough.
+const ASYNCIFY_DATA_ADDR = 16;
+const ASYNCIFY_STACK_SIZE = 64 * 1024;
+
+// -----------------------------------------------------------------------------
+// Worker side: one zeroperl instance and its stdin/stdout plumbing.
+
+class StayOpenInstance {
+    #input = [];
+    #inputWaiter = null;
+    #stdout = Buffer.alloc(0);
+    #stderr = [];
+    #memory = null;
+    #exited = null;
+
+    constructor(onResult) {
+        this.onResult = onResult;
+    }
+
+    async start(module, argv) {
+        const wasi = new WASI({
+            version: 'preview1',
+            args: ['zeroperl', ...argv],
+            env: { LC_ALL: 'C' },
+            preopens: { '/': '/' },
+            returnOnExit: true,
+        });
+        const wasiImport = wasi.getImportObject().wasi_snapshot_preview1;
+        const imports = {
+            wasi_snapshot_preview1: {
+                ...wasiImport,
+                fd_read: (fd, iovs, iovsLen, nread) => {
+                    if (fd !== 0) return wasiImport.fd_read(fd, iovs, iovsLen, nread);
+                    if (this.#input.length) return this.#copyInput(iovs, iovsLen, nread);
+                    // Suspend the instance until the next request arrives.
+                    return new Promise((wake) => {
+                        this.#inputWaiter = () => wake(this.#copyInput(iovs, iovsLen, nread));
+                    });
+                },
+                fd_write: (fd, iovs, iovsLen, nwritten) => {
+                    if (fd !== 1 && fd !== 2) return wasiImport.fd_write(fd, iovs, iovsLen, nwritten);
+                    const bytes = this.#gather(iovs, iovsLen);
+                    new DataView(this.#memory.buffer).setUint32(nwritten, bytes.length, true);
+                    if (fd === 2) {
+                        this.#stderr.push(bytes);
+                    } else {
+                        this.#stdout = Buffer.concat([this.#stdout, bytes]);
+                        this.#drainStdout();
+                    }
+                    return 0;
+                },
+                proc_exit: (code) => {
+                    throw new ZeroperlExit(code);
+                },
+            },
+        };
+
+        const result = await instantiate(module, imports);
+        const instance = result.instance ?? result;
+        this.#memory = instance.exports.memory;
+        wasi.finalizeBindings(instance);
+
+        const stack = await instance.exports.zeroperl_malloc(ASYNCIFY_STACK_SIZE);
+        new Int32Array(this.#memory.buffer, ASYNCIFY_DATA_ADDR, 2).set([stack, stack + ASYNCIFY_STACK_SIZE]);
+
+        this.#exited = instance.exports._start().then(
+            () => 0,
+            (err) => {
+                if (err instanceof ZeroperlExit) return err.code;
+                throw err;
+            }
+        );
+        return this.#exited;
+    }
+
+    write(data) {
+        this.#input.push(Buffer.isBuffer(data) ? data : Buffer.from(data));
+        if (this.#inputWaiter) {
+            const wake = this.#inputWaiter;
+            this.#inputWaiter = null;
+            wake();
+        }
+    }
+
+    #copyInput(iovs, iovsLen, nread) {
+        const view = new DataView(this.#memory.buffer);
+        const mem = new Uint8Array(this.#memory.buffer);
+        let total = 0;
+        for (let i = 0; i < iovsLen && this.#input.length; i++) {
+            const buf = view.getUint32(iovs + 8 * i, true);
+            const len = view.getUint32(iovs + 8 * i + 4, true);
+            let filled = 0;
+            while (filled < len && this.#input.length) {
+                const chunk = this.#input[0];
+                const n = Math.min(len - filled, chunk.length);
+                mem.set(chunk.subarray(0, n), buf + filled);
+                filled += n;
+                if (n === chunk.length) this.#input.shift();
+                else this.#input[0] = chunk.subarray(n);
+            }
+            total += filled;
+        }
+        view.setUint32(nread, total, true);
+        return 0;
+    }
+
+    #gather(iovs, iovsLen) {
+        const view = new DataView(this.#memory.buffer);
+        const parts = [];
+        for (let i = 0; i < iovsLen; i++) {
+            const buf = view.getUint32(iovs + 8 * i, true);
+            const len = view.getUint32(iovs + 8 * i + 4, true);
+            parts.push(Buffer.from(this.#memory.buffer, buf, len));
+        }
+        return Buffer.concat(parts);
+    }
+
+    // Everything before a "{readyN}" line is the output of request N. JSON
+    // escapes newlines, so the marker cannot start a line inside a value.
+    #drainStdout() {
+        for (;;) {
+            let at = this.#stdout.indexOf(READY);
+            while (at > 0 && this.#stdout[at - 1] !== 0x0a) {
+                at = this.#stdout.indexOf(READY, at + 1);
+            }
+            if (at < 0) return;
+            const eol = this.#stdout.indexOf(0x0a, at);
+            if (eol < 0) return;
+            const id = Number(this.#stdout.toString('latin1', at + READY.length, eol - 1));
+            const output = this.#stdout.toString('utf8', 0, at);
+            const stderr = Buffer.concat(this.#stderr).toString('utf8');
+            this.#stdout = this.#stdout.subarray(eol + 1);
+            this.#stderr = [];
+            this.onResult({ id, output, stderr });
+        }
+    }
+}
+
+// Serialise one request in the -stay_open argument file format. Buffers are
+// sent inline to the bundled loop and through a temporary file to exiftool.
+function encodeRequest({ id, file, buffer, args }, realExiftool) {
+    const lines = [...args];
+    let tmp = null;
+    let payload = null;
+    if (buffer && realExiftool) {
+        tmp = join(tmpdir(), `zeroperl-exiftool-${process.pid}-${id}`);
+        writeFileSync(tmp, buffer);
+        lines.push(tmp);
+    } else if (buffer) {
+        lines.push(`-buffer=${buffer.length}`);
+        payload = buffer;
+    } else {
+        lines.push(file);
+    }
+    const head = Buffer.from(lines.join('\n') + '\n');
+    const tail = Buffer.from(`${payload ? '\n' : ''}-execute${id}\n`);
+    return { data: Buffer.concat(payload ? [head, payload, tail] : [head, tail]), tmp };
+}
+
+function serverArgv(exiftool, commonArgs) {
+    return exiftool
+        ? [exiftool, '-stay_open', 'True', '-@', '-', '-common_args', '-json', ...commonArgs]
+        : [SERVER_SCRIPT];
+}
+
+async function workerMain({ module, exiftool, commonArgs, fresh }) {
+    const tmpFiles = new Map();
+    const finish = ({ id, output, stderr }) => {
+        const tmp = tmpFiles.get(id);
+        if (tmp) {
+            unlinkSync(tmp);
+            tmpFiles.delete(id);
+        }
+        parentPort.postMessage({ id, output, stderr });
+    };
+    const send = (instance, req) => {
+        const { data, tmp } = encodeRequest(req, !!exiftool);
+        if (tmp) tmpFiles.set(req.id, tmp);
+        instance.write(data);
+    };
+
+    if (fresh) {
+        // The per-process model: a new instance for every request.
+        parentPort.on('message', async (req) => {
+            if (req.close) return process.exit(0);
+            const instance = new StayOpenInstance(finish);
+            const exited = instance.start(module, serverArgv(exiftool, commonArgs));
+            send(instance, req);
+            instance.write('-stay_open\nFalse\n');
+            await exited;
+        });
+        return;
+    }
+
+    const instance = new StayOpenInstance(finish);
+    const exited = instance.start(module, serverArgv(exiftool, commonArgs));
+    parentPort.on('message', (req) => {
+        if (req.close) {
+            instance.write('-stay_open\nFalse\n');
+            return;
+        }
+        send(instance, req);
+    });
+    const status = await exited;
+    parentPort.postMessage({ exited: status });
+    process.exit(0);
+}
+
+// -----------------------------------------------------------------------------
+// Main thread: the pool.
+
+export class ExifToolPool {
+    /**
+     * Start `jobs` instances. `exiftool` runs a real exiftool script
+     * instead of the bundled loop; `commonArgs` go to every request;
+     * `depth` caps the requests in flight per instance. With `fresh`,
+     * every request gets its own instance (the per-process model).
+     */
+    static async create(wasmBytes, { jobs = availableParallelism(), depth = 4, exiftool = null, commonArgs = [], fresh = false } = {}) {
+        const module = compileModule(wasmBytes);
+        return new ExifToolPool(module, { jobs, depth, exiftool, commonArgs, fresh });
+    }
+
+    #workers = [];
+    #queue = [];
+    #pending = new Map();
+    #nextId = 1;
+    #depth;
+    #commonArgs;
+    #exiftool;
+
+    constructor(module, { jobs, depth, exiftool, commonArgs, fresh }) {
+        this.#depth = fresh ? 1 : depth;
+        this.#exiftool = exiftool;
+        this.#commonArgs = commonArgs;
+        for (let i = 0; i < jobs; i++) {
+            const worker = new Worker(fileURLToPath(import.meta.url), {
+                workerData: { module, exiftool: exiftool && resolve(exiftool), commonArgs, fresh },
+            });
+            const slot = { worker, inflight: 0 };
+            worker.on('message', (msg) => this.#onMessage(slot, msg));
+            worker.on('error', (err) => this.#fail(err));
+            this.#workers.push(slot);
+        }
+    }
+
+    /**
+     * Extract the tags of a file path or Buffer. Resolves with the tag
+     * object and whatever the instance wrote to stderr for it.
+     */
+    extract(input, args = []) {
+        const id = this.#nextId++;
+        // exiftool takes the common arguments once, through -common_args.
+        const reqArgs = this.#exiftool ? args : [...this.#commonArgs, ...args];
+        const req = Buffer.isBuffer(input)
+            ? { id, buffer: input, args: reqArgs }
+            : { id, file: resolve(input), args: reqArgs };
+        return new Promise((resolveResult, reject) => {
+            this.#pending.set(id, { resolve: resolveResult, reject });
+            this.#queue.push(req);
+            this.#dispatch();
+        });
+    }
+
+    async close() {
+        await Promise.all(this.#workers.map(({ worker }) => new Promise((done) => {
+            worker.once('exit', done);
+            worker.postMessage({ close: true });
+        })));
+    }
+
+    #dispatch() {
+        while (this.#queue.length) {
+            const slot = this.#workers.reduce((a, b) => (b.inflight < a.inflight ? b : a));
+            if (slot.inflight >= this.#depth) return;
+            slot.inflight++;
+            slot.worker.postMessage(this.#queue.shift());
+        }
+    }
+
+    #onMessage(slot, { id, output, stderr, exited }) {
+        if (exited !== undefined) {
+            if (this.#pending.size) this.#fail(new Error(`zeroperl exited with status ${exited}`));
+            return;
+        }
+        slot.inflight--;
+        const pending = this.#pending.get(id);
+        this.#pending.delete(id);
+        try {
+            const data = JSON.parse(output);
+            pending.resolve({ data: Array.isArray(data) ? data[0] : data, stderr });
+        } catch (err) {
+            pending.reject(new Error(`request ${id}: ${err.message}: ${stderr || output}`));
+        }
+        this.#dispatch();
+    }
+
+    #fail(err) {
+        for (const { reject } of this.#pending.values()) reject(err);
+        this.#pending.clear();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Command line.
+
+function usage(msg) {
+    if (msg) console.error(msg);
+    console.error('Usage: exiftool.mjs --wasm <zeroperl.wasm> [--jobs N] [--depth N] [--exiftool <script>] [-n] [-TAG ...] [file ...]');
+    console.error('       exiftool.mjs --wasm <zeroperl.wasm> --bench [--jobs N] file ...');
+    process.exit(1);
+}
+
+function parseArgs(argv) {
+    const opts = { jobs: availableParallelism(), depth: 4, exiftool: null, commonArgs: [], files: [] };
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        const value = () => {
+            if (i + 1 >= argv.length) usage(`missing value for ${arg}`);
+            return argv[++i];
+        };
+        if (arg === '--wasm') opts.wasm = value();
+        else if (arg === '--jobs') opts.jobs = parseInt(value(), 10);
+        else if (arg === '--depth') opts.depth = parseInt(value(), 10);
+        else if (arg === '--exiftool') opts.exiftool = value();
+        else if (arg === '--bench') opts.bench = true;
+        else if (arg.startsWith('-')) opts.commonArgs.push(arg);
+        else opts.files.push(arg);
+    }
+    return opts;
+}
+
+async function* inputFiles(files) {
+    if (files.length) {
+        yield* files;
+        return;
+    }
+    for await (const line of createInterface({ input: process.stdin })) {
+        if (line) yield line;
+    }
+}
+
+async function run(opts, wasmBytes) {
+    const pool = await ExifToolPool.create(wasmBytes, opts);
+    const results = [];
+    let failed = 0;
+    for await (const file of inputFiles(opts.files)) {
+        results.push(pool.extract(file).then(
+            ({ data }) => process.stdout.write(JSON.stringify(data) + '\n'),
+            (err) => {
+                failed++;
+                console.error(`${file}: ${err.message}`);
+            }
+        ));
+    }
+    await Promise.all(results);
+    await pool.close();
+    return failed ? 1 : 0;
+}
+
+async function throughput(wasmBytes, opts, files, fresh) {
+    const pool = await ExifToolPool.create(wasmBytes, { ...opts, fresh });
+    if (!fresh) {
+        // Let every instance finish loading ExifTool before timing.
+        await Promise.all(Array.from({ length: opts.jobs }, () => pool.extract(files[0])));
+    }
+    const start = process.hrtime.bigint();
+    await Promise.all(files.map((file) => pool.extract(file)));
+    const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+    await pool.close();
+    return files.length / seconds;
+}
+
+// Images per second with the per-process model (a fresh instance, startup
+// and module load per image) against warm -stay_open instances.
+async function bench(opts, wasmBytes) {
+    if (!opts.files.length) usage('--bench needs files');
+    const perProcess = await throughput(wasmBytes, opts, opts.files, true);
+    const stayOpen = await throughput(wasmBytes, opts, opts.files, false);
+    const report = {
+        files: opts.files.length,
+        jobs: opts.jobs,
+        per_process_images_per_s: Math.round(perProcess * 10) / 10,
+        stay_open_images_per_s: Math.round(stayOpen * 10) / 10,
+        speedup: Math.round((stayOpen / perProcess) * 10) / 10,
+    };
+    console.log(JSON.stringify(report, null, 2));
+    return 0;
+}
+
+if (!isMainThread) {
+    await workerMain(workerData);
+} else if (resolve(process.argv[1] ?? '') === fileURLToPath(import.meta.url)) {
+    const opts = parseArgs(process.argv.slice(2));
+    if (!opts.wasm) usage('--wasm is required');
+    const wasmBytes = readFileSync(opts.wasm);
+    process.exitCode = await (opts.bench ? bench : run)(opts, wasmBytes);
+}
@@ -0,0 +1,148 @@
+#!/usr/bin/env node
+/**
+ * fscache-bench.mjs
+ *
+ * Loads a chain of modules from host library directories in one wasmtime
+ * instance, with those directories listed in ZEROPERL_IMMUTABLE and without,
+ * and reports the wall time and the host lookups made.
+ *
+ * The directories go first in @INC, so every require probes them before the
+ * SFS, as it would with a host-mounted lib. Each module is loaded with
+ * eval "require ...", so an optional module that is missing costs its
+ * failed probes instead of ending the run.
+ *
+ * Timed runs have the counters off. One extra run with the cache on sets
+ * ZEROPERL_FSCACHE_STATS=1 and takes the counts from its stderr summary:
+ * stat/lstat, access, open and opendir calls below the directories, split
+ * into those the cache answered and those that reached the host. Without
+ * the cache every one of them is a host call. The modules loaded must be
+ * the same in both modes, or the script exits with status 1.
+ *
+ * The run also stats, lstats and opens a dangling symlink in a scratch
+ * directory that is listed in ZEROPERL_IMMUTABLE too. stat fails on it and
+ * lstat does not, so a cache that lets one answer for the other shows up as
+ * a difference between the modes.
+ *
+ * Usage:
+ *   ./fscache-bench.mjs --wasm <zeroperl.wasm> --lib <dir> [--lib <dir> ...]
+ *                       [--runs N] [--json <out.json>] Module::Name ...
+ */
+import { spawnSync } from 'node:child_process';
+import { mkdtempSync, rmSync, symlinkSync, writeFileSync } from 'node:fs';
+import { tmpdir } from 'node:os';
+import { join, resolve } from 'node:path';
+
+// Loads every module named on the command line, in order, and prints
+// whether each one loaded and the file it came from. Then probes the
+// dangling symlink in $ENV{FSCACHE_PROBE}: stat first, so that its "not
+// found" is cached before lstat asks.
+const SCRIPT = `
+    for my $module (@ARGV) {
+        (my $file = "$module.pm") =~ s{::}{/}g;
+        my $ok = eval "require $module; 1";
+        print "$module\\t", ($ok ? $INC{$file} : 'missing'), "\\n";
+    }
+    my $link = "$ENV{FSCACHE_PROBE}/dangling";
+    print "dangling\\t", join(' ', -e $link ? 1 : 0, -l $link ? 1 : 0, open(my $fh, '<', $link) ? 1 : 0), "\\n";`;
+
+function usage(msg) {
+    if (msg) console.error(msg);
+    console.error('Usage: fscache-bench.mjs --wasm <zeroperl.wasm> --lib <dir> [--lib <dir> ...] [--runs N] [--json <out.json>] Module::Name ...');
+    process.exit(2);
+}
+
+function parseArgs(argv) {
+    const opts = { libs: [], runs: 5, modules: [] };
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        if (arg === '--wasm' && i + 1 < argv.length) opts.wasm = resolve(argv[++i]);
+        else if (arg === '--lib' && i + 1 < argv.length) opts.libs.push(resolve(argv[++i]));
+        else if (arg === '--runs' && i + 1 < argv.length) opts.runs = parseInt(argv[++i], 10);
+        else if (arg === '--json' && i + 1 < argv.length) opts.json = argv[++i];
+        else if (arg.startsWith('--')) usage(`unknown argument: ${arg}`);
+        else opts.modules.push(arg);
+    }
+    if (!opts.wasm || !opts.libs.length || !opts.modules.length) usage();
+    return opts;
+}
+
+function run(wasm, libs, env, modules) {
+    const args = ['run', '--dir=/', '--env', 'LC_ALL=C'];
+    for (const [k, v] of Object.entries(env)) args.push('--env', `${k}=${v}`);
+    args.push('--argv0', 'zeroperl', wasm, ...libs.map((l) => `-I${l}`), '-e', SCRIPT, ...modules);
+    const start = process.hrtime.bigint();
+    const r = spawnSync('wasmtime', args, { encoding: 'utf8', maxBuffer: 1 << 26, stdio: ['ignore', 'pipe', 'pipe'] });
+    const ms = Number(process.hrtime.bigint() - start) / 1e6;
+    if (r.status !== 0) {
+        console.error(r.stderr);
+        throw new Error(`wasmtime exited with status ${r.status}`);
+    }
+    return { ms, stdout: r.stdout, stderr: r.stderr };
+}
+
+// "fscache: stat 1 hits (2 negative) 3 misses, access 4/5, open 6 refused 7 passed, opendir 8/9"
+function counters(stderr) {
+    const m = stderr.match(/^fscache: stat (\d+) hits \((\d+) negative\) (\d+) misses, access (\d+)\/(\d+), open (\d+) refused (\d+) passed, opendir (\d+)\/(\d+)/m);
+    if (!m) throw new Error('no fscache summary on stderr; is ZEROPERL_FSCACHE_STATS supported by this build?');
+    const [statHits, negative, statMisses, accessHits, accessMisses, openHits, openMisses, dirHits, dirMisses] = m.slice(1).map(Number);
+    return {
+        stat: { cached: statHits, host: statMisses },
+        access: { cached: accessHits, host: accessMisses },
+        open: { cached: openHits, host: openMisses },
+        opendir: { cached: dirHits, host: dirMisses },
+        negative,
+    };
+}
+
+function median(values) {
+    const sorted = [...values].sort((a, b) => a - b);
+    return sorted[Math.floor(sorted.length / 2)];
+}
+
+const opts = parseArgs(process.argv.slice(2));
+const probe = mkdtempSync(join(tmpdir(), 'fscache-'));
+symlinkSync('no-such-target', join(probe, 'dangling'));
+const modes = [
+    { name: 'off', env: { FSCACHE_PROBE: probe } },
+    { name: 'immutable', env: { FSCACHE_PROBE: probe, ZEROPERL_IMMUTABLE: [...opts.libs, probe].join(':') } },
+];
+
+const counted = run(opts.wasm, opts.libs, { ...modes[1].env, ZEROPERL_FSCACHE_STATS: '1' }, opts.modules);
+const calls = counters(counted.stderr);
+const ops = ['stat', 'access', 'open', 'opendir'];
+const total = (key) => ops.reduce((s, op) => s + calls[op][key], 0);
+const loaded = counted.stdout.split('\n').filter((l) => l && !l.endsWith('\tmissing') && !l.startsWith('dangling\t')).length;
+
+const results = [];
+for (const mode of modes) {
+    const times = [];
+    let identical = true;
+    for (let i = 0; i < opts.runs; i++) {
+        const r = run(opts.wasm, opts.libs, mode.env, opts.modules);
+        times.push(r.ms);
+        identical &&= r.stdout === counted.stdout;
+    }
+    const hostCalls = mode.name === 'off' ? total('cached') + total('host') : total('host');
+    results.push({ mode: mode.name, ms: median(times), hostCalls, identical });
+}
+rmSync(probe, { recursive: true });
+
+console.log(`${opts.modules.length} modules (${loaded} found) from ${opts.libs.join(', ')}, median of ${opts.runs} runs\n`);
+console.log('call       cached    host');
+for (const op of ops) {
+    console.log(`${op.padEnd(8)} ${String(calls[op].cached).padStart(8)} ${String(calls[op].host).padStart(7)}`);
+}
+console.log(`${calls.negative} of the cached stat results were "not found"\n`);
+console.log('mode        wall ms  host calls');
+for (const r of results) {
+    console.log(`${r.mode.padEnd(10)} ${r.ms.toFixed(1).padStart(8)} ${String(r.hostCalls).padStart(11)}${r.identical ? '' : '  OUTPUT DIFFERS'}`);
+}
+const [off, on] = results;
+console.log(`\nhost calls avoided: ${off.hostCalls - on.hostCalls}, time ${((on.ms / off.ms - 1) * 100).toFixed(1)}%`);
+if (opts.json) {
+    writeFileSync(opts.json, JSON.stringify({ libs: opts.libs, modules: opts.modules, loaded, runs: opts.runs, calls, results }, null, 2) + '\n');
+}
+if (results.some((r) => !r.identical)) {
+    console.error('\nthe modules loaded or the symlink probe differ between modes');
+    process.exit(1);
+}
@@ -0,0 +1,111 @@
+#!/usr/bin/env node
+/**
+ * hash-bench.mjs
+ *
+ * Compares Perl's hash function choices on wasm. Each candidate is
+ * bench/hashfunc.c built with the flags from `profile.js <profile>
+ * hash_ccflags <hash>`, named hashfunc-<hash>.wasm. Every module runs
+ * --runs times under wasmtime and reports nanoseconds per key for each key
+ * set; the fastest run counts.
+ *
+ * Candidates are ranked by a weighted mean over the key sets. The weights
+ * follow what the interpreter hashes most: short names (tag tables,
+ * methods, struct-like hashes) far more often than long keys.
+ *
+ * Usage:
+ *   ./hash-bench.mjs [--runs N] [--threads] [--check <hash>] [--pick <out>] [--json <out.json>] hashfunc-<hash>.wasm ...
+ *
+ * --check exits with status 1 if <hash>, the function the build uses, is
+ * more than 10% slower than the best candidate. --pick writes the name of
+ * the best candidate to <out>; the workflow builds perl with it when its
+ * hash input is "fastest". --threads runs
+ * modules built for wasm32-wasip1-threads.
+ */
+import { spawnSync } from 'node:child_process';
+import { writeFileSync } from 'node:fs';
+import { basename, resolve } from 'node:path';
+
+const WEIGHTS = { tags: 4, keys: 3, long: 2, bulk: 1 };
+const TOLERANCE = 1.10;
+
+function usage(msg) {
+    if (msg) console.error(msg);
+    console.error('Usage: hash-bench.mjs [--runs N] [--threads] [--check <hash>] [--pick <out>] [--json <out.json>] hashfunc-<hash>.wasm ...');
+    process.exit(2);
+}
+
+function parseArgs(argv) {
+    const opts = { runs: 3, modules: [] };
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        if (arg === '--runs' && i + 1 < argv.length) opts.runs = parseInt(argv[++i], 10);
+        else if (arg === '--check' && i + 1 < argv.length) opts.check = argv[++i];
+        else if (arg === '--threads') opts.threads = true;
+        else if (arg === '--pick' && i + 1 < argv.length) opts.pick = argv[++i];
+        else if (arg === '--json' && i + 1 < argv.length) opts.json = argv[++i];
+        else if (arg.startsWith('--')) usage(`unknown argument: ${arg}`);
+        else opts.modules.push(arg);
+    }
+    if (!opts.modules.length) usage();
+    return opts;
+}
+
+// "tags 12.34 0123abcd" lines => { tags: 12.34, ... }, and the function name.
+function run(wasm, threads) {
+    const flags = threads ? ['-W', 'threads=y', '-S', 'threads=y'] : [];
+    const r = spawnSync('wasmtime', ['run', ...flags, resolve(wasm)], { encoding: 'utf8' });
+    if (r.status !== 0) throw new Error(`${wasm}: ${r.stderr}`);
+    const ns = {};
+    let func = '';
+    for (const line of r.stdout.split('\n')) {
+        const m = line.match(/^(\w+) ([\d.]+) [0-9a-f]+$/);
+        if (m) ns[m[1]] = Number(m[2]);
+        else if (line.startsWith('# ')) func = line.slice(2).split(',')[0];
+    }
+    return { func, ns };
+}
+
+function score(ns) {
+    let sum = 0;
+    let weights = 0;
+    for (const [set, weight] of Object.entries(WEIGHTS)) {
+        if (ns[set] === undefined) continue;
+        sum += ns[set] * weight;
+        weights += weight;
+    }
+    return sum / weights;
+}
+
+const opts = parseArgs(process.argv.slice(2));
+const results = [];
+for (const wasm of opts.modules) {
+    const hash = basename(wasm).replace(/^hashfunc-/, '').replace(/\.wasm$/, '');
+    let best = null;
+    for (let i = 0; i < opts.runs; i++) {
+        const { func, ns } = run(wasm, opts.threads);
+        best ??= { hash, func, ns: { ...ns } };
+        for (const set of Object.keys(ns)) best.ns[set] = Math.min(best.ns[set], ns[set]);
+    }
+    best.score = score(best.ns);
+    results.push(best);
+}
+results.sort((a, b) => a.score - b.score);
+
+const sets = Object.keys(WEIGHTS);
+console.log(`ns per key, fastest of ${opts.runs} runs; score weights ${sets.map((s) => `${s} ${WEIGHTS[s]}`).join(', ')}\n`);
+console.log(`${'hash'.padEnd(18)}${sets.map((s) => s.padStart(8)).join('')}   score  function`);
+for (const r of results) {
+    console.log(`${r.hash.padEnd(18)}${sets.map((s) => (r.ns[s]?.toFixed(2) ?? '-').padStart(8)).join('')} ${r.score.toFixed(2).padStart(7)}  ${r.func}`);
+}
+console.log(`\nfastest: ${results[0].hash}`);
+if (opts.json) writeFileSync(opts.json, JSON.stringify({ runs: opts.runs, weights: WEIGHTS, results }, null, 2) + '\n');
+if (opts.pick) writeFileSync(opts.pick, results[0].hash + '\n');
+
+if (opts.check) {
+    const used = results.find((r) => r.hash === opts.check);
+    if (!used) usage(`--check: no module for ${opts.check}`);
+    if (used.score > results[0].score * TOLERANCE) {
+        console.error(`${opts.check} is ${((used.score / results[0].score - 1) * 100).toFixed(0)}% slower than ${results[0].hash}`);
+        process.exit(1);
+    }
+}
@@ -0,0 +1,111 @@
+#!/usr/bin/env node
+/**
+ * pgo-train.mjs
+ *
+ * Runs the training set for the profile-guided build under wasmtime: every
+ * zeroperl case from bench.mjs, with the same scripts and inputs, and, when
+ * images are given, ExifTool over them through exiftool-stay-open.pl. The
+ * module must be the instrumented build (linked with -fprofile-generate).
+ * Each run writes its own raw profile into the output directory, and the
+ * files are merged afterwards with `llvm-profdata merge`.
+ *
+ * Usage:
+ *   ./pgo-train.mjs --wasm <zeroperl-instr.wasm> --out <dir> [--iterations 2] [images...]
+ */
+import { closeSync, existsSync, mkdirSync, openSync, statSync, writeFileSync } from 'node:fs';
+import { dirname, join, resolve } from 'node:path';
+import { spawnSync } from 'node:child_process';
+import { fileURLToPath } from 'node:url';
+import { CASES, caseArgs, streamInput } from './bench.mjs';
+
+const STAY_OPEN = join(dirname(fileURLToPath(import.meta.url)), 'exiftool-stay-open.pl');
+
+function parseArgs(argv) {
+    const opts = { iterations: 2, images: [] };
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        const value = () => {
+            if (i + 1 >= argv.length) {
+                usage(`missing value for ${arg}`);
+            }
+            return argv[++i];
+        };
+        if (arg === '--wasm') opts.wasm = value();
+        else if (arg === '--out') opts.out = value();
+        else if (arg === '--iterations') opts.iterations = parseInt(value(), 10);
+        else if (arg.startsWith('-')) usage(`unknown argument: ${arg}`);
+        else opts.images.push(resolve(arg));
+    }
+    if (!opts.wasm || !opts.out) usage('--wasm and --out are required');
+    return opts;
+}
+
+function usage(msg) {
+    if (msg) console.error(msg);
+    console.error('Usage: pgo-train.mjs --wasm <zeroperl-instr.wasm> --out <dir> [--iterations N] [images...]');
+    process.exit(2);
+}
+
+// One zeroperl run with its own LLVM_PROFILE_FILE. The profile runtime
+// writes the file at exit, so a run without one was not instrumented.
+function train(opts, name, args, stdinPath) {
+    const profile = join(opts.out, `${name}.profraw`);
+    const cmd = ['run', '--dir=/', '--env', 'LC_ALL=C', '--env', `LLVM_PROFILE_FILE=${profile}`,
+        '--argv0', 'zeroperl', opts.wasm, ...args];
+    const stdin = stdinPath ? openSync(stdinPath, 'r') : 'ignore';
+    try {
+        const r = spawnSync('wasmtime', cmd, { stdio: [stdin, 'ignore', 'pipe'] });
+        if (r.status !== 0) {
+            throw new Error(`exit status ${r.status}: ${String(r.stderr).trim()}`);
+        }
+    } finally {
+        if (typeof stdin === 'number') closeSync(stdin);
+    }
+    if (!existsSync(profile)) {
+        throw new Error(`no profile written to ${profile}; is ${opts.wasm} the instrumented build?`);
+    }
+    return statSync(profile).size;
+}
+
+// The stay_open request stream for every image, then the shutdown.
+function exiftoolInput(opts) {
+    const path = join(opts.out, 'exiftool-args.txt');
+    const lines = opts.images.flatMap((image, i) => [image, `-execute${i}`]);
+    writeFileSync(path, [...lines, '-stay_open', 'False', ''].join('\n'));
+    return path;
+}
+
+const opts = parseArgs(process.argv.slice(2));
+opts.wasm = resolve(opts.wasm);
+opts.out = resolve(opts.out);
+mkdirSync(opts.out, { recursive: true });
+
+const runs = [];
+for (const c of CASES) {
+    if (c.compileOnly || c.instantiateOnly || c.process) continue;
+    if (c.engines && !c.engines.includes('wasmtime')) continue;
+    runs.push({ name: c.name, args: caseArgs(c), stdin: c.stdin ? streamInput() : null, optional: c.optional });
+}
+if (opts.images.length) {
+    runs.push({ name: 'exiftool', args: [STAY_OPEN], stdin: exiftoolInput(opts), optional: true });
+}
+
+let written = 0;
+for (const run of runs) {
+    for (let i = 0; i < opts.iterations; i++) {
+        const name = `${run.name}-${i}`;
+        try {
+            const bytes = train(opts, name, run.args, run.stdin);
+            written++;
+            console.error(`${name.padEnd(24)} ${bytes} bytes`);
+        } catch (err) {
+            if (!run.optional) {
+                console.error(`${name}: ${err.message}`);
+                process.exit(1);
+            }
+            console.error(`${name.padEnd(24)} skipped (${err.message})`);
+            break;
+        }
+    }
+}
+console.error(`Wrote ${written} profiles to ${opts.out}`);
@@ -0,0 +1,505 @@
+#!/usr/bin/env node
+/**
+ * proc.mjs
+ *
+ * Process emulation for zeroperl under Node.js, the host side of
+ * stubs/proc.c. system(), exec, backticks, pipe opens, fork, pipe() and
+ * wait/waitpid send requests to the `request` function of the
+ * "zeroperl_proc" import module. The main module does not import it, so it
+ * still runs on any WASI host: bind() puts the function in the module's
+ * function table and registers it through the zeroperl_proc_attach export,
+ * which also checks that both sides speak PROC_VERSION.
+ *
+ * Each child is another zeroperl instance on a worker thread, so children
+ * run in parallel with their parent and with each other. A spawned child
+ * starts fresh; a forked one starts from a copy of the parent's linear
+ * memory, taken while its stack is unwound into it, and continues through
+ * the zeroperl_fork_child export. Pipes are ring buffers in shared memory;
+ * every instance sees them as ordinary descriptors and blocks on them with
+ * Atomics.wait. Only zeroperl itself can be spawned (argv[0] of `perl` or
+ * `zeroperl`, which is also what $^X is); anything else fails with ENOENT.
+ *
+ * Usage:
+ *   const proc = new ProcHost(module, { pool: 4, preopens: { '/': '/' } });
+ *   const instance = await instantiate(module, proc.wrapImports(wasi.getImportObject()));
+ *   await proc.bind(instance);
+ *
+ * `pool` keeps that many workers with the module loaded, so a child does
+ * not wait for a thread to start. `preopens` must be the ones the
+ * instance's WASI was given: a forked child's libc has them in memory.
+ */
+import { basename } from 'node:path';
+import { WASI } from 'node:wasi';
+import { Worker, isMainThread, parentPort, workerData } from 'node:worker_threads';
+
+// Must match ZEROPERL_PROC_VERSION in stubs/proc.c.
+export const PROC_VERSION = 2;
+// Pipe ends are numbered from here, clear of the descriptors Node's WASI
+// hands out and of the tmpfs ones.
+const FIRST_PIPE_FD = 1024;
+const FIRST_PID = 1000;
+const CHILD_COMMANDS = ['perl', 'zeroperl'];
+const PROC_WNOHANG = 1;
+const WASM_PAGE_SIZE = 65536;
+
+// WASI errno and filetype values.
+const ESUCCESS = 0;
+const EBADF = 8;
+const ENOSYS = 52;
+const ECHILD = 12;
+const EINVAL = 28;
+const ENOENT = 44;
+const EPIPE = 64;
+const ESPIPE = 70;
+const FILETYPE_SOCKET_STREAM = 6;
+const RIGHTS_FD_READ = 1n << 1n;
+const RIGHTS_FD_WRITE = 1n << 6n;
+
+// -----------------------------------------------------------------------------
+// One-way pipe between threads. The control words are
+//   [0] bytes read  [1] bytes written  [2] writers open  [3] readers open
+//   [4] bumped on every write or writer close, [5] on every read or reader close
+// and each side sleeps on the other side's counter. Forked children share
+// the ends of their parent, so an end is only closed when its last holder
+// closes it.
+const RING_SIZE = 1 << 16;
+const RING_HEADER = 6 * 4;
+
+export class Ring {
+    constructor(sab = null) {
+        this.sab = sab ?? new SharedArrayBuffer(RING_HEADER + RING_SIZE);
+        this.ctl = new Int32Array(this.sab, 0, 6);
+        this.data = new Uint8Array(this.sab, RING_HEADER);
+        this.mask = this.data.length - 1;
+        if (!sab) {
+            this.ctl[2] = 1;
+            this.ctl[3] = 1;
+        }
+    }
+
+    // Blocks until all of src is written. Returns the bytes written, or -1
+    // if the reader went away before any were.
+    write(src) {
+        const { ctl } = this;
+        let done = 0;
+        while (done < src.length) {
+            const seq = Atomics.load(ctl, 5);
+            if (!Atomics.load(ctl, 3)) {
+                return done || -1;
+            }
+            const w = Atomics.load(ctl, 1);
+            const free = this.data.length - ((w - Atomics.load(ctl, 0)) >>> 0);
+            if (free === 0) {
+                Atomics.wait(ctl, 5, seq);
+                continue;
+            }
+            const n = Math.min(free, src.length - done);
+            const at = w & this.mask;
+            const first = Math.min(n, this.data.length - at);
+            this.data.set(src.subarray(done, done + first), at);
+            this.data.set(src.subarray(done + first, done + n), 0);
+            Atomics.store(ctl, 1, (w + n) | 0);
+            this.bump(4);
+            done += n;
+        }
+        return done;
+    }
+
+    // Blocks until at least one byte is available. Returns the bytes read,
+    // 0 at end of file.
+    read(dst) {
+        const { ctl } = this;
+        while (dst.length) {
+            const seq = Atomics.load(ctl, 4);
+            const r = Atomics.load(ctl, 0);
+            const used = (Atomics.load(ctl, 1) - r) >>> 0;
+            if (used) {
+                const n = Math.min(used, dst.length);
+                const at = r & this.mask;
+                const first = Math.min(n, this.data.length - at);
+                dst.set(this.data.subarray(at, at + first));
+                dst.set(this.data.subarray(0, n - first), first);
+                Atomics.store(ctl, 0, (r + n) | 0);
+                this.bump(5);
+                return n;
+            }
+            if (!Atomics.load(ctl, 2)) {
+                return 0;
+            }
+            Atomics.wait(ctl, 4, seq);
+        }
+        return 0;
+    }
+
+    // One more holder of the reading or the writing end.
+    share(reading) {
+        Atomics.add(this.ctl, reading ? 3 : 2, 1);
+    }
+
+    closeWriter() {
+        Atomics.sub(this.ctl, 2, 1);
+        this.bump(4);
+    }
+
+    closeReader() {
+        Atomics.sub(this.ctl, 3, 1);
+        this.bump(5);
+    }
+
+    bump(index) {
+        Atomics.add(this.ctl, index, 1);
+        Atomics.notify(this.ctl, index);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// The "zeroperl_proc" import module, as a module of its own that re-exports
+// the host function, since only functions exported by a wasm module can go
+// into a function table:
+//   (module
+//     (type (func (param i32 i32 i32 i32) (result i32)))
+//     (import "zeroperl_proc" "request" (func (type 0)))
+//     (export "request" (func 0)))
+const name = (str) => [str.length, ...new TextEncoder().encode(str)];
+const SHIM = new WebAssembly.Module(new Uint8Array([
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00,
+    0x01, 0x09, 0x01, 0x60, 0x04, 0x7f, 0x7f, 0x7f, 0x7f, 0x01, 0x7f,
+    0x02, 0x19, 0x01, ...name('zeroperl_proc'), ...name('request'), 0x00, 0x00,
+    0x07, 0x0b, 0x01, ...name('request'), 0x00, 0x00,
+]));
+
+// -----------------------------------------------------------------------------
+export class ProcHost {
+    constructor(module, { pool = 0, commands = CHILD_COMMANDS, preopens = { '/': '/' }, fds = [], pids = null } = {}) {
+        this.module = module;
+        this.commands = new Set(commands);
+        this.poolSize = pool;
+        this.preopens = preopens;
+        this.memory = null;
+        // Ring ends by descriptor, starting with the ones inherited.
+        this.fds = new Map(fds.map(({ fd, ring, reading }) => [fd, { ring, reading }]));
+        this.nextFd = Math.max(FIRST_PIPE_FD, ...[...this.fds.keys()].map((fd) => fd + 1));
+        this.children = new Map();
+        // Pids come from one counter for the whole tree of instances.
+        this.pids = pids ?? new Int32Array(new SharedArrayBuffer(4));
+        // Bumped by every child of this host when it exits.
+        this.exits = new Int32Array(new SharedArrayBuffer(4));
+        this.idle = [];
+        for (let i = 0; i < pool; i++) {
+            this.idle.push(this.startWorker());
+        }
+    }
+
+    /**
+     * Attach to an instance of the module. Resolves to false, with process
+     * requests failing with ENOSYS, for a module without process support or
+     * one that speaks another version.
+     */
+    async bind(instance) {
+        const { exports } = instance;
+        this.memory = exports.memory;
+        const table = exports.__indirect_function_table;
+        if (!table || !exports.zeroperl_proc_attach) {
+            return false;
+        }
+        const shim = new WebAssembly.Instance(SHIM, {
+            zeroperl_proc: { request: (req, len, reply, cap) => this.request(req, len, reply, cap) },
+        });
+        const index = table.grow(1);
+        table.set(index, shim.exports.request);
+        const version = await exports.zeroperl_proc_attach(PROC_VERSION, index);
+        if (version !== PROC_VERSION) {
+            console.error(`zeroperl proc: module speaks version ${version}, not ${PROC_VERSION}; no child processes`);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * The WASI imports with pipe descriptors handled here.
+     */
+    wrapImports(imports) {
+        const wasi = imports.wasi_snapshot_preview1;
+        const pipe = (fd) => this.fds.get(fd);
+        const wrapped = {
+            ...wasi,
+            fd_write: (fd, iovs, iovsLen, nwritten) => {
+                const p = pipe(fd);
+                return p ? this.pipeWrite(p, iovs, iovsLen, nwritten) : wasi.fd_write(fd, iovs, iovsLen, nwritten);
+            },
+            fd_read: (fd, iovs, iovsLen, nread) => {
+                const p = pipe(fd);
+                return p ? this.pipeRead(p, iovs, iovsLen, nread) : wasi.fd_read(fd, iovs, iovsLen, nread);
+            },
+            fd_close: (fd) => (pipe(fd) ? this.closePipe(fd) : wasi.fd_close(fd)),
+            fd_fdstat_get: (fd, buf) => {
+                const p = pipe(fd);
+                if (!p) return wasi.fd_fdstat_get(fd, buf);
+                const view = this.view();
+                view.setUint8(buf, FILETYPE_SOCKET_STREAM);
+                view.setUint16(buf + 2, 0, true);
+                view.setBigUint64(buf + 8, p.reading ? RIGHTS_FD_READ : RIGHTS_FD_WRITE, true);
+                view.setBigUint64(buf + 16, 0n, true);
+                return ESUCCESS;
+            },
+            fd_filestat_get: (fd, buf) => {
+                if (!pipe(fd)) return wasi.fd_filestat_get(fd, buf);
+                new Uint8Array(this.memory.buffer, buf, 64).fill(0);
+                this.view().setUint8(buf + 16, FILETYPE_SOCKET_STREAM);
+                return ESUCCESS;
+            },
+            fd_fdstat_set_flags: (fd, flags) => (pipe(fd) ? ESUCCESS : wasi.fd_fdstat_set_flags(fd, flags)),
+            fd_seek: (fd, offset, whence, newOffset) => (pipe(fd) ? ESPIPE : wasi.fd_seek(fd, offset, whence, newOffset)),
+            fd_tell: (fd, offset) => (pipe(fd) ? ESPIPE : wasi.fd_tell(fd, offset)),
+        };
+        return { ...imports, wasi_snapshot_preview1: wrapped };
+    }
+
+    view() {
+        return new DataView(this.memory.buffer);
+    }
+
+    iovecs(iovs, iovsLen) {
+        const view = this.view();
+        const out = [];
+        for (let i = 0; i < iovsLen; i++) {
+            const ptr = view.getUint32(iovs + i * 8, true);
+            const len = view.getUint32(iovs + i * 8 + 4, true);
+            out.push(new Uint8Array(this.memory.buffer, ptr, len));
+        }
+        return out;
+    }
+
+    pipeWrite(p, iovs, iovsLen, nwritten) {
+        if (p.reading) return EBADF;
+        let total = 0;
+        for (const bytes of this.iovecs(iovs, iovsLen)) {
+            const n = p.ring.write(bytes);
+            if (n < 0) {
+                if (!total) return EPIPE;
+                break;
+            }
+            total += n;
+        }
+        this.view().setUint32(nwritten, total, true);
+        return ESUCCESS;
+    }
+
+    // Blocks for the first buffer only, like read() on a pipe.
+    pipeRead(p, iovs, iovsLen, nread) {
+        if (!p.reading) return EBADF;
+        let total = 0;
+        for (const bytes of this.iovecs(iovs, iovsLen)) {
+            if (!bytes.length) continue;
+            if (total && Atomics.load(p.ring.ctl, 0) === Atomics.load(p.ring.ctl, 1)) break;
+            const n = p.ring.read(bytes);
+            total += n;
+            if (n < bytes.length) break;
+        }
+        this.view().setUint32(nread, total, true);
+        return ESUCCESS;
+    }
+
+    closePipe(fd) {
+        const p = this.fds.get(fd);
+        if (p.reading) p.ring.closeReader();
+        else p.ring.closeWriter();
+        this.fds.delete(fd);
+        return ESUCCESS;
+    }
+
+    // Every pipe end still open, when the instance is done.
+    closeAll() {
+        for (const fd of [...this.fds.keys()]) {
+            this.closePipe(fd);
+        }
+    }
+
+    addPipe(ring, reading) {
+        const fd = this.nextFd++;
+        this.fds.set(fd, { ring, reading });
+        return fd;
+    }
+
+    // -------------------------------------------------------------------------
+    // zeroperl_proc.request: NUL-terminated fields, answered with
+    // space-separated numbers written to `reply`. Returns their length.
+    request(req, len, reply, cap) {
+        const fields = Buffer.from(this.memory.buffer, req, len).toString('utf8').split('\0');
+        fields.pop();
+        let answer;
+        try {
+            if (fields[0] === 'spawn') answer = this.spawn(fields);
+            else if (fields[0] === 'fork') answer = this.fork(fields);
+            else if (fields[0] === 'pipe') answer = this.pipe();
+            else if (fields[0] === 'wait') answer = this.wait(parseInt(fields[1], 10), parseInt(fields[2], 10));
+            else answer = [-ENOSYS];
+        } catch (err) {
+            console.error(`zeroperl proc: ${err.message}`);
+            answer = [-EINVAL];
+        }
+        const bytes = new TextEncoder().encode(answer.join(' ')).subarray(0, cap);
+        new Uint8Array(this.memory.buffer, reply, bytes.length).set(bytes);
+        return bytes.length;
+    }
+
+    // spawn <stdin> <stdout> <argc> <arg>... <envc> <env>...
+    spawn(fields) {
+        const [, stdinMode, stdoutMode] = fields;
+        const argc = parseInt(fields[3], 10);
+        const args = fields.slice(4, 4 + argc);
+        const envc = parseInt(fields[4 + argc], 10);
+        const envList = fields.slice(5 + argc, 5 + argc + envc);
+        if (!argc || !this.commands.has(basename(args[0]))) {
+            return [-ENOENT];
+        }
+        const env = {};
+        for (const entry of envList) {
+            const eq = entry.indexOf('=');
+            if (eq > 0) env[entry.slice(0, eq)] = entry.slice(eq + 1);
+        }
+
+        const stdin = stdinMode === 'pipe' ? new Ring() : null;
+        const stdout = stdoutMode === 'pipe' ? new Ring() : null;
+        const fds = [];
+        if (stdin) fds.push({ fd: 0, sab: stdin.sab, reading: true });
+        if (stdout) fds.push({ fd: 1, sab: stdout.sab, reading: false });
+        const pid = this.startChild({ args: ['zeroperl', ...args.slice(1)], env, fds });
+        // The parent writes the child's stdin and reads its stdout.
+        return [pid, stdin ? this.addPipe(stdin, false) : -1, stdout ? this.addPipe(stdout, true) : -1];
+    }
+
+    // fork <stdin> <stdout>: the caller is inside asyncjmp_rt_checkpoint, so
+    // its memory holds its whole stack. The child gets a copy of it and of
+    // every pipe end, except the stdio a new pipe replaces.
+    fork(fields) {
+        const [, stdinMode, stdoutMode] = fields;
+        const stdin = stdinMode === 'pipe' ? new Ring() : null;
+        const stdout = stdoutMode === 'pipe' ? new Ring() : null;
+        const fds = [];
+        for (const [fd, p] of this.fds) {
+            if ((fd === 0 && stdin) || (fd === 1 && stdout)) continue;
+            p.ring.share(p.reading);
+            fds.push({ fd, sab: p.ring.sab, reading: p.reading });
+        }
+        if (stdin) fds.push({ fd: 0, sab: stdin.sab, reading: true });
+        if (stdout) fds.push({ fd: 1, sab: stdout.sab, reading: false });
+        const memory = this.memory.buffer.slice(0);
+        const pid = this.startChild({ args: ['zeroperl'], env: {}, fds, memory }, [memory]);
+        return [pid, stdin ? this.addPipe(stdin, false) : -1, stdout ? this.addPipe(stdout, true) : -1];
+    }
+
+    pipe() {
+        const ring = new Ring();
+        return [this.addPipe(ring, true), this.addPipe(ring, false)];
+    }
+
+    startChild(job, transfer = []) {
+        const pid = FIRST_PID + Atomics.add(this.pids, 0, 1);
+        const status = new Int32Array(new SharedArrayBuffer(8));
+        const worker = this.idle.pop() ?? this.startWorker();
+        worker.postMessage({
+            ...job,
+            module: this.module,
+            pid,
+            pool: this.poolSize,
+            preopens: this.preopens,
+            pids: this.pids.buffer,
+            status: status.buffer,
+            exits: this.exits.buffer,
+        }, transfer);
+        this.children.set(pid, { status, worker });
+        return pid;
+    }
+
+    // wait <pid> <flags>: pid -1 is any child.
+    wait(pid, flags) {
+        for (;;) {
+            const seen = Atomics.load(this.exits, 0);
+            const candidates = pid === -1 ? [...this.children.keys()] : this.children.has(pid) ? [pid] : [];
+            if (!candidates.length) {
+                return [-ECHILD];
+            }
+            const done = candidates.find((p) => Atomics.load(this.children.get(p).status, 0) === 1);
+            if (done !== undefined) {
+                const child = this.children.get(done);
+                this.children.delete(done);
+                if (this.idle.length < this.poolSize) this.idle.push(child.worker);
+                else child.worker.terminate();
+                return [done, Atomics.load(child.status, 1)];
+            }
+            if (flags & PROC_WNOHANG) {
+                return [0, 0];
+            }
+            Atomics.wait(this.exits, 0, seen);
+        }
+    }
+
+    startWorker() {
+        const worker = new Worker(new URL(import.meta.url), { workerData: { zeroperlProc: true } });
+        worker.unref();
+        return worker;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Worker side: run one child at a time, for as long as the parent keeps the
+// worker. Node's WASI imports are synchronous, so the child does not need
+// the Asyncify wrapper. A forked child's memory is copied in before it is
+// attached, since the copy holds the parent's attachment.
+async function runChild(job) {
+    const status = new Int32Array(job.status);
+    const exits = new Int32Array(job.exits);
+    const fds = job.fds.map(({ fd, sab, reading }) => ({ fd, ring: new Ring(sab), reading }));
+    let proc = null;
+    let code = 255;
+    try {
+        const wasi = new WASI({
+            version: 'preview1',
+            args: job.args,
+            env: job.env,
+            preopens: job.preopens,
+            returnOnExit: true,
+        });
+        proc = new ProcHost(job.module, {
+            pool: job.pool,
+            preopens: job.preopens,
+            fds,
+            pids: new Int32Array(job.pids),
+        });
+        const instance = new WebAssembly.Instance(job.module, proc.wrapImports(wasi.getImportObject()));
+        const { memory } = instance.exports;
+        if (job.memory) {
+            const grow = job.memory.byteLength - memory.buffer.byteLength;
+            if (grow > 0) memory.grow(grow / WASM_PAGE_SIZE);
+            new Uint8Array(memory.buffer).set(new Uint8Array(job.memory));
+        }
+        await proc.bind(instance);
+        if (job.memory) {
+            const _start = () => instance.exports.zeroperl_fork_child(job.pid);
+            code = wasi.start({ exports: { memory, _start } }) ?? 0;
+        } else {
+            code = wasi.start(instance) ?? 0;
+        }
+    } catch (err) {
+        console.error(`zeroperl child: ${err.message}`);
+    } finally {
+        if (proc) {
+            proc.closeAll();
+        } else {
+            for (const { ring, reading } of fds) {
+                if (reading) ring.closeReader();
+                else ring.closeWriter();
+            }
+        }
+        Atomics.store(status, 1, code);
+        Atomics.store(status, 0, 1);
+        Atomics.notify(status, 0);
+        Atomics.add(exits, 0, 1);
+        Atomics.notify(exits, 0);
+    }
+}
+
+if (!isMainThread && workerData?.zeroperlProc) {
+    parentPort.on('message', runChild);
+}
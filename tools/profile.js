@@ -0,0 +1,184 @@
+#!/usr/bin/env node
+/**
+ * profile.js
+ *
+ * Expands a build profile from profiles.json into the pieces the workflow
+ * needs, so that the extension list lives in one place.
+ *
+ * Usage:
+ *   ./profile.js <profile> static_ext     space separated list for Configure -Dstatic_ext
+ *   ./profile.js <profile> noextensions   extensions Configure must not build
+ *   ./profile.js <profile> archives       lib/auto/... archives to link
+ *   ./profile.js <profile> xs_init        C header with the boot declarations and table
+ *   ./profile.js <profile> sfs_delete     paths under the prefix to drop from the SFS (delete.js format)
+ *   ./profile.js <profile> has <ext>      exit status 0 if the profile links <ext>
+ *   ./profile.js <profile> exiftool       exit status 0 if the profile bundles ExifTool
+ *   ./profile.js <profile> hash           the profile's hash function spec
+ *   ./profile.js <profile> hash_ccflags [<hash>]
+ *                                         compiler flags selecting the hash function (the
+ *                                         profile's, or <hash>) and the seed
+ *   ./profile.js <profile> hashes         every hash function spec, one per line
+ */
+'use strict';
+
+const fs = require('fs');
+const path = require('path');
+
+const PERL_VERSION = '5.40.0';
+const ARCHNAME = 'wasm32-wasi';
+
+const config = JSON.parse(fs.readFileSync(path.join(__dirname, 'profiles.json'), 'utf8'));
+const all = Object.keys(config.extensions);
+
+function usage(msg) {
+    if (msg) console.error(msg);
+    console.error(`Usage: ${path.basename(process.argv[1])} <${Object.keys(config.profiles).join('|')}> <static_ext|noextensions|archives|xs_init|sfs_delete|has <ext>|exiftool|hash|hash_ccflags [<hash>]|hashes>`);
+    process.exit(1);
+}
+
+// Resolve "inherits" chains and "*" into an ordered list of extensions
+// (always in the order of the "extensions" table, which is the boot order).
+function resolve(name, seen = new Set()) {
+    const profile = config.profiles[name];
+    if (!profile) usage(`unknown profile: ${name}`);
+    if (seen.has(name)) usage(`profile inheritance loop at ${name}`);
+    seen.add(name);
+
+    if (profile.extensions === '*') return new Set(all);
+    const exts = profile.inherits ? resolve(profile.inherits, seen) : new Set();
+    for (const ext of profile.extensions) {
+        if (!config.extensions[ext]) usage(`profile ${name}: unknown extension ${ext}`);
+        exts.add(ext);
+    }
+    return exts;
+}
+
+// A profile setting, looked up along the "inherits" chain.
+function inherited(name, key) {
+    for (let p = config.profiles[name]; p; p = config.profiles[p.inherits]) {
+        if (p[key] !== undefined) return p[key];
+    }
+    return undefined;
+}
+
+const exiftoolEnabled = (name) => inherited(name, 'exiftool') ?? true;
+
+// Every "<function>" and "<function>+sbox32" spec.
+const hashes = () => Object.keys(config.hash.functions).flatMap((f) => [`${f}+sbox32`, f]);
+
+// hv_func.h picks the function from PERL_HASH_FUNC_*, and uses SBOX32 for
+// short keys unless PERL_HASH_USE_SBOX32_ALSO is 0. NO_HASH_SEED replaces
+// the seed from random_get (or PERL_HASH_SEED) with a compiled-in one, and
+// PERL_PERTURB_KEYS_DISABLED makes key order depend on the keys alone.
+const hashSpec = (name) => inherited(name, 'hash') || config.hash.default;
+
+function hashCcflags(name, spec) {
+    spec ||= hashSpec(name);
+    if (spec === 'fastest') usage(`"fastest" is only for the workflow's hash input, which resolves it with tools/hash-bench.mjs --pick; pass one of ${hashes().join(', ')}`);
+    if (!hashes().includes(spec)) usage(`unknown hash function: ${spec} (${hashes().join(', ')})`);
+    const [func, sbox] = spec.split('+');
+    const flags = [config.hash.functions[func], `-DPERL_HASH_USE_SBOX32_ALSO=${sbox ? 1 : 0}`];
+    const seed = inherited(name, 'hash_seed') || 'random';
+    if (seed === 'fixed') flags.push('-DNO_HASH_SEED', '-DPERL_PERTURB_KEYS_DISABLED');
+    else if (seed !== 'random') usage(`profile ${name}: hash_seed must be "random" or "fixed"`);
+    return flags.join(' ');
+}
+
+const bootName = (ext) => 'boot_' + ext.replace(/\//g, '__');
+const packageName = (ext) => ext.replace(/\//g, '::');
+const archive = (ext) => `lib/auto/${ext}/${ext.split('/').pop()}.a`;
+
+function xsInit(name, exts) {
+    const booted = all.filter((ext) => exts.has(ext) && config.extensions[ext].boot !== false);
+    const lines = [
+        `/* Generated by tools/profile.js for the "${name}" profile. Do not edit. */`,
+        '#ifndef ZEROPERL_XS_H',
+        '#define ZEROPERL_XS_H',
+        '',
+        'EXTERN_C void boot_DynaLoader(pTHX_ CV *cv);',
+    ];
+    for (const ext of booted) {
+        lines.push(`EXTERN_C void ${bootName(ext)}(pTHX_ CV *cv);`);
+        const simd = config.extensions[ext].simd_boot;
+        if (simd) {
+            lines.push('#ifdef __wasm_simd128__', `EXTERN_C void ${simd}(pTHX_ CV *cv);`, '#endif');
+        }
+    }
+    lines.push('', 'static void zeroperl_xs_boot(pTHX_ const char *file)', '{');
+    lines.push('    newXS("DynaLoader::boot_DynaLoader", boot_DynaLoader, file);');
+    for (const ext of booted) {
+        const stmt = (fn) => `    newXS("${packageName(ext)}::bootstrap", ${fn}, file);`;
+        const simd = config.extensions[ext].simd_boot;
+        if (simd) {
+            lines.push('#ifdef __wasm_simd128__', stmt(simd), '#else', stmt(bootName(ext)), '#endif');
+        } else {
+            lines.push(stmt(bootName(ext)));
+        }
+    }
+    lines.push('}', '', '#endif', '');
+    return lines.join('\n');
+}
+
+// Modules of extensions left out of the profile. A directory is only
+// dropped when no linked extension lives below it (Hash/Util stays for
+// Hash/Util/FieldHash).
+function sfsDelete(name, exts) {
+    const roots = [`lib/${PERL_VERSION}`, `lib/${PERL_VERSION}/${ARCHNAME}`];
+    const out = [];
+    for (const ext of all.filter((e) => !exts.has(e))) {
+        const keepDir = [...exts].some((e) => e.startsWith(ext + '/'));
+        for (const root of roots) {
+            out.push(`${root}/${ext}.pm`);
+            if (!keepDir) out.push(`${root}/${ext}`);
+            for (const extra of config.extensions[ext].sfs || []) {
+                out.push(`${root}/${extra}`);
+            }
+        }
+    }
+    if (!exiftoolEnabled(name)) {
+        const arch = `lib/${PERL_VERSION}/${ARCHNAME}`;
+        out.push(`${arch}/Image`, `${arch}/File/RandomAccess.pm`, `${arch}/File/RandomAccess.pod`);
+        // Image::ExifTool::LazyTable, copied from lib/ for every profile.
+        out.push(`lib/${PERL_VERSION}/Image`);
+    }
+    return out.join('\n') + '\n';
+}
+
+const [name, what, arg] = process.argv.slice(2);
+if (!name || !what) usage();
+const exts = resolve(name);
+
+switch (what) {
+    case 'static_ext':
+        console.log(all.filter((e) => exts.has(e)).join(' '));
+        break;
+    case 'noextensions':
+        console.log([...config.never, ...all.filter((e) => !exts.has(e))].join(' '));
+        break;
+    case 'archives':
+        console.log(all.filter((e) => exts.has(e) && config.extensions[e].boot !== false).map(archive).join(' '));
+        break;
+    case 'xs_init':
+        process.stdout.write(xsInit(name, exts));
+        break;
+    case 'sfs_delete':
+        process.stdout.write(sfsDelete(name, exts));
+        break;
+    case 'has':
+        process.exit(exts.has(arg) ? 0 : 1);
+        break;
+    case 'exiftool':
+        process.exit(exiftoolEnabled(name) ? 0 : 1);
+        break;
+    case 'hash':
+        console.log(hashSpec(name));
+        break;
+    case 'hash_ccflags':
+        console.log(hashCcflags(name, arg));
+        break;
+    case 'hashes':
+        console.log(hashes().join('\n'));
+        break;
+    default:
+        usage(`unknown output: ${what}`);
+}
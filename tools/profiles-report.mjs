@@ -0,0 +1,43 @@
+#!/usr/bin/env node
+/**
+ * profiles-report.mjs
+ *
+ * Summarises the bench.json files of a profile matrix build as a markdown
+ * table: module size next to the Node compile, instantiate and startup
+ * medians, and the cold start of a fresh process without and with the
+ * cold-start artifacts (see aot.mjs) on Node and wasmtime, smallest profile
+ * first.
+ *
+ * Usage:
+ *   ./profiles-report.mjs <bench.json>...
+ */
+import { readFileSync } from 'node:fs';
+import { basename } from 'node:path';
+
+const files = process.argv.slice(2);
+if (!files.length) {
+    console.error('Usage: profiles-report.mjs <bench.json>...');
+    process.exit(1);
+}
+
+const median = (results, key) => results[key]?.median ?? '-';
+
+const rows = files.map((file) => {
+    const { meta, results } = JSON.parse(readFileSync(file, 'utf8'));
+    return {
+        profile: basename(meta.wasm, '.wasm').replace(/^zeroperl-/, ''),
+        size: meta.size,
+        compile: median(results, 'node.compile'),
+        instantiate: median(results, 'node.instantiate'),
+        startup: median(results, 'node.startup'),
+        cold: `${median(results, 'node.cold_start')} / ${median(results, 'node.cold_start_cached')}`,
+        coldWasmtime: `${median(results, 'wasmtime.cold_start')} / ${median(results, 'wasmtime.cold_start_cached')}`,
+    };
+});
+rows.sort((a, b) => a.size - b.size);
+
+console.log('| Profile | Size (MiB) | Compile (ms) | Instantiate (ms) | Startup (ms) | Node cold start, uncached / cached (ms) | wasmtime cold start, .wasm / .cwasm (ms) |');
+console.log('|---|---:|---:|---:|---:|---:|---:|');
+for (const r of rows) {
+    console.log(`| ${r.profile} | ${(r.size / 1048576).toFixed(2)} | ${r.compile} | ${r.instantiate} | ${r.startup} | ${r.cold} | ${r.coldWasmtime} |`);
+}
@@ -0,0 +1,133 @@
+#!/usr/bin/env node
+/**
+ * readahead-bench.mjs
+ *
+ * Runs ExifTool over a set of image files in one wasmtime instance, with the
+ * read-ahead cache off and then at each given block size, and reports the
+ * wall time and the host calls made for reads and seeks.
+ *
+ * Timed runs have tracing off. One extra run per mode sets ZEROPERL_TRACE=1
+ * and ZEROPERL_READAHEAD_STATS=1 and takes the counts from their stderr
+ * summaries:
+ *   - read() and lseek() calls made through the wrappers, split into those
+ *     the cache answered alone and those that reached the host;
+ *   - the host calls themselves. With the cache off that is one per host
+ *     read() and lseek(); with it on, the fstat() checks, block fills,
+ *     direct reads and SEEK_END seeks that readahead.c counted.
+ * The tags extracted must be identical in every mode, or the script exits
+ * with status 1.
+ *
+ * Usage:
+ *   ./readahead-bench.mjs --wasm <zeroperl.wasm> [--sizes 64k,16k] [--blocks N]
+ *                         [--runs N] [--json <out.json>] file ...
+ */
+import { createHash } from 'node:crypto';
+import { spawnSync } from 'node:child_process';
+import { writeFileSync } from 'node:fs';
+import { resolve } from 'node:path';
+
+// Prints every tag of every file. Binary values are printed by length, so
+// the output does not depend on where they were allocated.
+const SCRIPT = `
+    use Image::ExifTool;
+    for my $file (@ARGV) {
+        my $info = Image::ExifTool::ImageInfo($file);
+        for my $tag (sort keys %$info) {
+            my $v = $info->{$tag};
+            $v = ref $v eq 'SCALAR' ? 'binary ' . length($$v)
+               : ref $v eq 'ARRAY' ? join(',', @$v) : $v;
+            print "$file\\t$tag\\t$v\\n";
+        }
+    }`;
+
+function usage(msg) {
+    if (msg) console.error(msg);
+    console.error('Usage: readahead-bench.mjs --wasm <zeroperl.wasm> [--sizes 64k,16k] [--blocks N] [--runs N] [--json <out.json>] file ...');
+    process.exit(2);
+}
+
+function parseArgs(argv) {
+    const opts = { sizes: ['64k'], blocks: null, runs: 5, files: [] };
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        if (arg === '--wasm' && i + 1 < argv.length) opts.wasm = resolve(argv[++i]);
+        else if (arg === '--sizes' && i + 1 < argv.length) opts.sizes = argv[++i].split(',');
+        else if (arg === '--blocks' && i + 1 < argv.length) opts.blocks = argv[++i];
+        else if (arg === '--runs' && i + 1 < argv.length) opts.runs = parseInt(argv[++i], 10);
+        else if (arg === '--json' && i + 1 < argv.length) opts.json = argv[++i];
+        else if (arg.startsWith('--')) usage(`unknown argument: ${arg}`);
+        else opts.files.push(resolve(arg));
+    }
+    if (!opts.wasm || !opts.files.length) usage();
+    return opts;
+}
+
+function run(wasm, env, files) {
+    const args = ['run', '--dir=/', '--env', 'LC_ALL=C'];
+    for (const [k, v] of Object.entries(env)) args.push('--env', `${k}=${v}`);
+    args.push('--argv0', 'zeroperl', wasm, '-e', SCRIPT, ...files);
+    const start = process.hrtime.bigint();
+    const r = spawnSync('wasmtime', args, { encoding: 'utf8', maxBuffer: 1 << 28, stdio: ['ignore', 'pipe', 'pipe'] });
+    const ms = Number(process.hrtime.bigint() - start) / 1e6;
+    if (r.status !== 0) {
+        console.error(r.stderr);
+        throw new Error(`wasmtime exited with status ${r.status}`);
+    }
+    return { ms, stdout: r.stdout, stderr: r.stderr };
+}
+
+// "trace: read   sfs 1 tmpfs 0 cache 2 host 3, ..." => { sfs, tmpfs, cache, host }
+function traced(stderr, op) {
+    const m = stderr.match(new RegExp(`^trace: ${op}\\s+sfs (\\d+) tmpfs (\\d+) cache (\\d+) host (\\d+)`, 'm'));
+    const [sfs, tmpfs, cache, host] = m ? m.slice(1).map(Number) : [0, 0, 0, 0];
+    return { sfs, tmpfs, cache, host };
+}
+
+function median(values) {
+    const sorted = [...values].sort((a, b) => a - b);
+    return sorted[Math.floor(sorted.length / 2)];
+}
+
+const opts = parseArgs(process.argv.slice(2));
+const modes = [{ name: 'off', env: {} }];
+for (const size of opts.sizes) {
+    const env = { ZEROPERL_READAHEAD: size };
+    if (opts.blocks) env.ZEROPERL_READAHEAD_BLOCKS = opts.blocks;
+    modes.push({ name: size, env });
+}
+
+const results = [];
+let expected = null;
+for (const mode of modes) {
+    const counted = run(opts.wasm, { ...mode.env, ZEROPERL_TRACE: '1', ZEROPERL_READAHEAD_STATS: '1' }, opts.files);
+    const digest = createHash('sha256').update(counted.stdout).digest('hex');
+    expected ??= digest;
+    const read = traced(counted.stderr, 'read');
+    const lseek = traced(counted.stderr, 'lseek');
+    const ra = counted.stderr.match(/^readahead: (\d+) host calls/m);
+    const times = [];
+    for (let i = 0; i < opts.runs; i++) times.push(run(opts.wasm, mode.env, opts.files).ms);
+    results.push({
+        mode: mode.name,
+        ms: median(times),
+        reads: read.cache + read.host,
+        lseeks: lseek.cache + lseek.host,
+        cached: read.cache + lseek.cache,
+        hostCalls: ra ? Number(ra[1]) : read.host + lseek.host,
+        identical: digest === expected,
+    });
+}
+
+const base = results[0];
+console.log(`${opts.files.length} files, median of ${opts.runs} runs\n`);
+console.log('mode      wall ms   reads  lseeks  cached  host calls  vs off');
+for (const r of results) {
+    const change = r === base ? '' : `${((r.ms / base.ms - 1) * 100).toFixed(1)}% time, ${r.hostCalls - base.hostCalls} calls`;
+    console.log(`${r.mode.padEnd(8)} ${r.ms.toFixed(1).padStart(8)} ${String(r.reads).padStart(7)} ${String(r.lseeks).padStart(7)} ` +
+        `${String(r.cached).padStart(7)} ${String(r.hostCalls).padStart(11)}  ${change}${r.identical ? '' : ' OUTPUT DIFFERS'}`);
+}
+if (opts.json) writeFileSync(opts.json, JSON.stringify({ files: opts.files.length, runs: opts.runs, results }, null, 2) + '\n');
+if (results.some(r => !r.identical)) {
+    console.error('\nthe extracted tags differ between modes');
+    process.exit(1);
+}
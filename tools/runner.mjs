@@ -1,39 +1,90 @@
 #!/usr/bin/env node
 import { readFile } from 'node:fs/promises';
+import { resolve } from 'node:path';
 import { WASI } from 'node:wasi';
+import { compileModule } from './aot.mjs';
 import { instantiate } from './asyncify.mjs';
+import { ProcHost } from './proc.mjs';
+import { ZeroperlSession } from './snapshot.mjs';
+
+// Run each script in its own request on one warm instance, resetting linear
+// memory to the post-init snapshot in between (see snapshot.mjs).
+//   runner --snapshot <path-to-wasm> [-MModule ...] script.pl [script.pl ...]
+async function runSnapshot(wasmPath, rest) {
+    const preload = rest.filter((arg) => arg.startsWith('-M'));
+    const scripts = rest.filter((arg) => !arg.startsWith('-M'));
+
+    const wasmBuffer = await readFile(wasmPath);
+    const session = await ZeroperlSession.create(wasmBuffer, {
+        args: [...preload, '-e0'],
+    });
+    console.error('WASM loaded successfully, baseline captured');
+
+    let status = 0;
+    for (const script of scripts) {
+        const path = JSON.stringify(resolve(script));
+        const result = await session.run(`do ${path}; die $@ if $@;`);
+        const { restoreMs, dirtyPages, grownPages, totalPages } = result.stats;
+        const memory = result.memory
+            ? `, malloc peak ${result.memory.malloc_peak_bytes} bytes, SFS ${result.memory.sfs_bytes_read} bytes read`
+            : '';
+        console.error(
+            `${script}: status ${result.status}, restored ${dirtyPages} dirty + ${grownPages} grown ` +
+            `of ${totalPages} pages in ${restoreMs.toFixed(2)} ms${memory}`
+        );
+        status ||= result.status;
+    }
+    process.exit(status);
+}
 
 (async () => {
 
-    const [, , wasmPath, ...args] = process.argv;
+    const [, , ...argv] = process.argv;
+    // --no-cache: always validate the whole module (see aot.mjs).
+    const noCache = argv[0] === '--no-cache';
+    if (noCache) argv.shift();
+    if (argv[0] === '--snapshot') {
+        const [, wasmPath, ...rest] = argv;
+        if (!wasmPath) {
+            console.error('Usage: runner --snapshot <path-to-wasm> [-MModule ...] <script.pl ...>');
+            process.exit(1);
+        }
+        return runSnapshot(wasmPath, rest);
+    }
+
+    const [wasmPath, ...args] = argv;
 
     if (!wasmPath) {
-        console.error('Usage: runner <path-to-wasm> [arguments...]');
+        console.error('Usage: runner [--no-cache] <path-to-wasm> [arguments...]');
         process.exit(1);
     }
 
     // Create a new WASI instance
+    const preopens = {
+        '/': '/',
+    };
     const wasi = new WASI({
         version: 'preview1',
-        args: ['zeroperl', '-V'], 
+        args: ['zeroperl', ...(args.length ? args : ['-V'])],
         env: {
             LC_ALL: 'C',
         },
-        preopens: {
-            '/': '/',
-        },
+        preopens,
         returnOnExit: false,
     });
 
+    // Load the WASM. Child processes are further instances of the same
+    // module (see proc.mjs); ZEROPERL_PROC_POOL keeps that many warm.
+    const wasmBuffer = await readFile(wasmPath);
+    const module = compileModule(wasmBuffer, { cacheDir: noCache ? null : undefined });
+    const proc = new ProcHost(module, { pool: parseInt(process.env.ZEROPERL_PROC_POOL ?? '0', 10) || 0, preopens });
+
     // Create the import object for the WASM module
-    const imports = {
-        ...wasi.getImportObject(),
-    };
+    const imports = proc.wrapImports(wasi.getImportObject());
 
-    // Load and instantiate the WASM
-    const wasmBuffer = await readFile(wasmPath);
-    const { instance } = await instantiate(wasmBuffer, imports);
-    console.log('WASM loaded successfully');
+    const instance = await instantiate(module, imports);
+    await proc.bind(instance);
+    console.error('WASM loaded successfully');
 
     // Start the WASI application
     wasi.start(instance);
@@ -0,0 +1,255 @@
+/**
+ * snapshot.mjs
+ *
+ * Runs many Perl requests against one zeroperl instance while keeping them
+ * isolated from each other. The module is initialised once through
+ * `zeroperl_init` (see stubs/zeroperl.c), then linear memory and the stack
+ * pointer are captured as a baseline. After every `zeroperl_eval` request,
+ * the pages that differ from the baseline are copied back, pages added by
+ * memory growth are zeroed, and any file descriptors the request left open
+ * are closed, so the next request sees the same state a fresh instance
+ * would after init.
+ *
+ * Dirty pages are found by diffing each 64 KiB wasm page against the
+ * baseline with `Buffer.compare` (a native memcmp), which is far cheaper than
+ * copying the whole memory back and needs no instrumentation of stores.
+ *
+ * Usage:
+ *   const session = await ZeroperlSession.create(wasmBytes, {
+ *       args: ['-MImage::ExifTool', '-e0'],
+ *       env: { LC_ALL: 'C' },
+ *       preopens: { '/': '/' },
+ *   });
+ *   const { status, stats, memory } = await session.run('print "hi\\n"');
+ *
+ * `memory` holds the request's memory accounting from the
+ * zeroperl_memory_stats export (stubs/memstats.h), read before the reset.
+ * Its stack figures need ZEROPERL_MEMORY_STATS in `env`.
+ *
+ * With `budget: { ops, ms, yield: true }`, a request runs in slices of at
+ * most that many ops or milliseconds (stubs/fuel.c). Between slices the
+ * session gives the event loop a turn, so many sessions in one thread
+ * share it fairly and a runaway request cannot block it; `slices` in the
+ * result counts them. Without `yield`, a request that runs out of budget
+ * dies with "Execution budget exhausted" instead.
+ *
+ * Requires a Node.js with `WASI.prototype.finalizeBindings` (v22 or later).
+ */
+import { WASI } from 'node:wasi';
+import { instantiate } from './asyncify.mjs';
+
+const WASM_PAGE_SIZE = 65536;
+// ASYNCJMP_RT_YIELDED in stubs/setjmp.h.
+const YIELDED = -2;
+const ZERO_PAGE = Buffer.alloc(WASM_PAGE_SIZE);
+
+// struct zeroperl_memory_stats, in order: 32-bit fields, sfs_bytes_read, then
+// the 32-bit TMPFS_STATS_FIELDS.
+const MEMORY_STATS_FIELDS = [
+    'memory_bytes', 'static_bytes', 'malloc_live_bytes', 'malloc_peak_bytes',
+    'stack_size', 'stack_peak_bytes', 'asyncify_peak_bytes', 'asyncify_buffer_size',
+    'sfs_open', 'sfs_open_peak', 'sfs_opens', 'stack_tracked',
+];
+const TMPFS_STATS_FIELDS = ['tmpfs_bytes', 'tmpfs_peak_bytes', 'tmpfs_limit'];
+
+export class ZeroperlExit extends Error {
+    constructor(code) {
+        super(`zeroperl exited with status ${code}`);
+        this.code = code;
+    }
+}
+
+export class ZeroperlSession {
+    static async create(wasmBytes, { args = ['-e0'], env = { LC_ALL: 'C' }, preopens = { '/': '/' }, budget = null } = {}) {
+        const session = new ZeroperlSession();
+        await session.#instantiate(wasmBytes, env, preopens);
+        if (budget) {
+            await session.#exports.zeroperl_set_budget(budget.ops ?? 0, budget.ms ?? 0, budget.yield ? 1 : 0);
+        }
+        const status = await session.#init(args);
+        if (status !== 0) {
+            throw new Error(`zeroperl_init failed with status ${status}`);
+        }
+        await session.capture();
+        return session;
+    }
+
+    #wasi = null;
+    #exports = null;
+    #memory = null;
+    #openFds = new Set();
+    #baseline = null;
+    #baselineSp = 0;
+
+    async #instantiate(wasmBytes, env, preopens) {
+        this.#wasi = new WASI({
+            version: 'preview1',
+            args: ['zeroperl'],
+            env,
+            preopens,
+            returnOnExit: true,
+        });
+        if (typeof this.#wasi.finalizeBindings !== 'function') {
+            throw new Error('snapshot sessions need WASI.finalizeBindings (Node.js 22 or later)');
+        }
+
+        const wasiImport = this.#wasi.getImportObject().wasi_snapshot_preview1;
+        const imports = {
+            wasi_snapshot_preview1: {
+                ...wasiImport,
+                // Remember descriptors opened by a request so that they can be
+                // closed when its memory is thrown away.
+                path_open: (...args) => {
+                    const rc = wasiImport.path_open(...args);
+                    if (rc === 0) {
+                        this.#openFds.add(new DataView(this.#memory.buffer).getUint32(args[8], true));
+                    }
+                    return rc;
+                },
+                fd_close: (fd) => {
+                    this.#openFds.delete(fd);
+                    return wasiImport.fd_close(fd);
+                },
+                // exit() and die at top level end the request, not the instance.
+                proc_exit: (code) => {
+                    throw new ZeroperlExit(code);
+                },
+            },
+        };
+
+        const { instance } = await instantiate(wasmBytes, imports);
+        this.#exports = instance.exports;
+        this.#memory = instance.exports.memory;
+        this.#wasi.finalizeBindings(instance);
+    }
+
+    async #init(args) {
+        const argv = ['zeroperl', ...args];
+        const ptrs = [];
+        for (const arg of argv) {
+            ptrs.push(await this.#writeString(arg));
+        }
+        const argvPtr = await this.#exports.zeroperl_malloc(4 * (argv.length + 1));
+        const view = new DataView(this.#memory.buffer);
+        ptrs.forEach((ptr, i) => view.setUint32(argvPtr + 4 * i, ptr, true));
+        view.setUint32(argvPtr + 4 * argv.length, 0, true);
+        return this.#call(() => this.#exports.zeroperl_init(argv.length, argvPtr));
+    }
+
+    // Copy a NUL-terminated string into guest memory. Every export goes
+    // through the Asyncify wrapper, so even zeroperl_malloc is awaited.
+    async #writeString(str) {
+        const bytes = Buffer.from(`${str}\0`, 'utf8');
+        const ptr = await this.#exports.zeroperl_malloc(bytes.length);
+        new Uint8Array(this.#memory.buffer, ptr, bytes.length).set(bytes);
+        return ptr;
+    }
+
+    async #call(fn) {
+        try {
+            return await fn();
+        } catch (err) {
+            if (err instanceof ZeroperlExit) {
+                return err.code;
+            }
+            throw err;
+        }
+    }
+
+    /**
+     * Record the current memory and stack pointer as the state every
+     * request starts from.
+     */
+    async capture() {
+        this.#baseline = Buffer.from(this.#memory.buffer.slice(0));
+        this.#baselineSp = await this.#exports.zeroperl_get_stack_pointer();
+        this.#openFds.clear();
+    }
+
+    /**
+     * Run one request and reset the instance afterwards.
+     * Returns the request's exit status together with the restore statistics.
+     */
+    async run(code) {
+        const codePtr = await this.#writeString(code);
+        let status = await this.#call(() => this.#exports.zeroperl_eval(codePtr));
+        let slices = 1;
+        while (status === YIELDED) {
+            await new Promise((resolve) => setImmediate(resolve));
+            status = await this.#call(() => this.#exports.zeroperl_resume());
+            slices++;
+        }
+        const memory = await this.memoryStats();
+        const stats = await this.restore();
+        return { status, stats, memory, slices };
+    }
+
+    /**
+     * The instance's memory accounting, or null for a module built without
+     * stubs/memstats.c.
+     */
+    async memoryStats() {
+        if (!this.#exports.zeroperl_memory_stats) {
+            return null;
+        }
+        const ptr = await this.#exports.zeroperl_memory_stats();
+        const view = new DataView(this.#memory.buffer, ptr);
+        const stats = {};
+        MEMORY_STATS_FIELDS.forEach((name, i) => {
+            stats[name] = view.getUint32(4 * i, true);
+        });
+        stats.sfs_bytes_read = Number(view.getBigUint64(4 * MEMORY_STATS_FIELDS.length, true));
+        TMPFS_STATS_FIELDS.forEach((name, i) => {
+            stats[name] = view.getUint32(4 * MEMORY_STATS_FIELDS.length + 8 + 4 * i, true);
+        });
+        return stats;
+    }
+
+    /**
+     * Copy dirty pages back from the baseline, zero pages gained through
+     * memory growth, and reset the stack pointer and leaked descriptors.
+     */
+    async restore() {
+        const start = process.hrtime.bigint();
+        const buffer = this.#memory.buffer;
+        const current = Buffer.from(buffer);
+        const baseLength = this.#baseline.length;
+        let dirtyPages = 0;
+        let grownPages = 0;
+
+        for (let off = 0; off < baseLength; off += WASM_PAGE_SIZE) {
+            const want = this.#baseline.subarray(off, off + WASM_PAGE_SIZE);
+            const have = current.subarray(off, off + WASM_PAGE_SIZE);
+            if (Buffer.compare(want, have) !== 0) {
+                have.set(want);
+                dirtyPages++;
+            }
+        }
+
+        // Memory cannot shrink. Pages past the baseline are handed out again
+        // by sbrk() on the next request, and must look freshly grown.
+        for (let off = baseLength; off < current.length; off += WASM_PAGE_SIZE) {
+            const have = current.subarray(off, off + WASM_PAGE_SIZE);
+            if (Buffer.compare(ZERO_PAGE, have) !== 0) {
+                have.fill(0);
+                grownPages++;
+            }
+        }
+
+        await this.#exports.zeroperl_set_stack_pointer(this.#baselineSp);
+
+        const wasiImport = this.#wasi.getImportObject().wasi_snapshot_preview1;
+        for (const fd of this.#openFds) {
+            wasiImport.fd_close(fd);
+        }
+        this.#openFds.clear();
+
+        return {
+            restoreMs: Number(process.hrtime.bigint() - start) / 1e6,
+            totalPages: current.length / WASM_PAGE_SIZE,
+            baselinePages: baseLength / WASM_PAGE_SIZE,
+            dirtyPages,
+            grownPages,
+        };
+    }
+}
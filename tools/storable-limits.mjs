@@ -0,0 +1,125 @@
+#!/usr/bin/env node
+/**
+ * storable-limits.mjs
+ *
+ * Storable refuses to store or clone data nested deeper than
+ * $Storable::recursion_limit (arrays) and $Storable::recursion_limit_hash
+ * (hashes), because its C code recurses once per level. Perl 5.40 ships
+ * fixed defaults for both in dist/Storable/__Storable__.pm and does not
+ * measure them at build time. This script measures what the linked wasm
+ * module can actually take, under each engine, where running out of stack
+ * is a trap that ends the instance.
+ *
+ * Each probe is a fresh instance that nests arrays or hashes N deep and
+ * round-trips them through freeze/thaw and dclone with the limits off. The
+ * recommended limits are half the deepest nesting that survived on every
+ * engine, to leave room for the callers' own frames and for engines or
+ * tiers with larger frames.
+ *
+ * Usage:
+ *   ./storable-limits.mjs --wasm <zeroperl.wasm> [--engines node,wasmtime] [--check]
+ *
+ * --check exits with status 1 if the limits the module was built with are
+ * above the recommended ones. Lower them with a patch to
+ * dist/Storable/__Storable__.pm in patches/, applied by the workflow.
+ */
+import { spawnSync } from 'node:child_process';
+import { dirname, resolve } from 'node:path';
+import { fileURLToPath } from 'node:url';
+
+const RUNNER = resolve(dirname(fileURLToPath(import.meta.url)), 'runner.mjs');
+// Bisection stops when the bracket is within 1/32 of the depth found.
+const PRECISION = 32;
+const MAX_DEPTH = 1 << 20;
+
+const engines = {
+    node: (wasm, args) => [process.execPath, [RUNNER, wasm, ...args]],
+    wasmtime: (wasm, args) => ['wasmtime', ['run', '--dir=/', '--env', 'LC_ALL=C', '--argv0', 'zeroperl', wasm, ...args]],
+};
+
+function usage(msg) {
+    if (msg) console.error(msg);
+    console.error('Usage: storable-limits.mjs --wasm <zeroperl.wasm> [--engines node,wasmtime] [--check]');
+    process.exit(2);
+}
+
+function parseArgs(argv) {
+    const opts = { engines: Object.keys(engines), check: false };
+    for (let i = 0; i < argv.length; i++) {
+        const arg = argv[i];
+        if (arg === '--wasm' && i + 1 < argv.length) opts.wasm = resolve(argv[++i]);
+        else if (arg === '--engines' && i + 1 < argv.length) opts.engines = argv[++i].split(',');
+        else if (arg === '--check') opts.check = true;
+        else usage(`unknown argument: ${arg}`);
+    }
+    if (!opts.wasm) usage();
+    for (const name of opts.engines) {
+        if (!engines[name]) usage(`unknown engine: ${name}`);
+    }
+    return opts;
+}
+
+function perl(engine, wasm, code) {
+    const [command, args] = engines[engine](wasm, ['-MStorable', '-e', code]);
+    const r = spawnSync(command, args, { encoding: 'utf8', stdio: ['ignore', 'pipe', 'pipe'] });
+    return r.status === 0 ? r.stdout : null;
+}
+
+// True if a structure nested `depth` deep survives a round trip.
+function survives(engine, wasm, kind, depth) {
+    const wrap = kind === 'hash' ? '{ k => $d }' : '[ $d ]';
+    const code = `
+        local $Storable::recursion_limit = -1;
+        local $Storable::recursion_limit_hash = -1;
+        my $d = 0;
+        $d = ${wrap} for 1 .. ${depth};
+        Storable::thaw(Storable::freeze($d));
+        Storable::dclone($d);
+        print "ok\\n";`;
+    return perl(engine, wasm, code) === 'ok\n';
+}
+
+function deepest(engine, wasm, kind) {
+    let good = 0;
+    let bad = 0;
+    for (let depth = 256; depth <= MAX_DEPTH; depth *= 2) {
+        if (!survives(engine, wasm, kind, depth)) {
+            bad = depth;
+            break;
+        }
+        good = depth;
+    }
+    if (!bad) return good;
+    while (bad - good > Math.max(1, good / PRECISION)) {
+        const mid = Math.floor((good + bad) / 2);
+        if (survives(engine, wasm, kind, mid)) good = mid;
+        else bad = mid;
+    }
+    return good;
+}
+
+const opts = parseArgs(process.argv.slice(2));
+const recommended = { array: Infinity, hash: Infinity };
+for (const engine of opts.engines) {
+    for (const kind of ['array', 'hash']) {
+        const depth = deepest(engine, opts.wasm, kind);
+        console.log(`${engine}: ${kind === 'hash' ? 'hashes' : 'arrays'} nest ${depth} deep`);
+        recommended[kind] = Math.min(recommended[kind], Math.floor(depth / 2));
+    }
+}
+
+console.log(`\nrecommended: recursion_limit ${recommended.array}, recursion_limit_hash ${recommended.hash}`);
+
+if (opts.check) {
+    const out = perl(opts.engines[0], opts.wasm, 'print "$Storable::recursion_limit $Storable::recursion_limit_hash\\n"');
+    if (!out) {
+        console.error('\ncould not read the limits of the module');
+        process.exit(1);
+    }
+    const [array, hash] = out.trim().split(' ').map(Number);
+    console.log(`\nbuilt with: recursion_limit ${array}, recursion_limit_hash ${hash}`);
+    if (array > recommended.array || hash > recommended.hash) {
+        console.error('the built limits are above the recommended ones');
+        process.exit(1);
+    }
+}
@@ -0,0 +1,198 @@
+#!/usr/bin/env node
+/**
+ * trace.mjs
+ *
+ * Reads the I/O call records of stubs/trace.c, either straight from a live
+ * instance's memory or from a ZEROPERL_TRACE_FILE, and reports what is
+ * worth fixing: paths opened or stat'ed over and over, lookups that keep
+ * failing, reads that return only a few bytes, and the slowest calls.
+ *
+ * Usage:
+ *   ./trace.mjs <trace-file> [--top 15]
+ *
+ *   const trace = new TraceReader(instance);   // starts tracing
+ *   ...run code...
+ *   const records = trace.drain();
+ *   console.log(formatReport(analyse(records)));
+ */
+import { readFileSync } from 'node:fs';
+import { resolve } from 'node:path';
+import { fileURLToPath } from 'node:url';
+
+// Must match stubs/trace.h.
+const MAGIC = 0x5254505a;
+const VERSION = 1;
+const HEADER_SIZE = 40;
+const RECORD_SIZE = 64;
+const PATH_TAIL = 28;
+export const OPS = [null, 'open', 'fopen', 'close', 'read', 'lseek', 'stat', 'lstat', 'fstat', 'access'];
+const ROUTES = ['sfs', 'host', 'tmpfs', 'cache'];
+const ENOENT = 44;
+const TINY_READ = 512;
+
+function decodeHeader(view, at) {
+    const magic = view.getUint32(at, true);
+    const version = view.getUint16(at + 4, true);
+    const recordSize = view.getUint16(at + 6, true);
+    if (magic !== MAGIC || version !== VERSION || recordSize !== RECORD_SIZE) {
+        throw new Error(`not a version ${VERSION} zeroperl trace (magic ${magic.toString(16)}, version ${version})`);
+    }
+    return {
+        capacity: view.getUint32(at + 8, true),
+        records: view.getUint32(at + 12, true),
+        written: view.getBigUint64(at + 16, true),
+        read: view.getBigUint64(at + 24, true),
+        dropped: view.getBigUint64(at + 32, true),
+    };
+}
+
+function decodeRecord(bytes, at) {
+    const view = new DataView(bytes.buffer, bytes.byteOffset + at, RECORD_SIZE);
+    const pathBytes = bytes.subarray(at + 36, at + 36 + PATH_TAIL);
+    const end = pathBytes.indexOf(0);
+    const path = Buffer.from(pathBytes.subarray(0, end < 0 ? PATH_TAIL : end)).toString('utf8');
+    return {
+        startNs: view.getBigUint64(0, true),
+        result: Number(view.getBigInt64(8, true)),
+        elapsedNs: view.getUint32(16, true),
+        arg: view.getUint32(20, true),
+        fd: view.getInt32(24, true),
+        pathHash: view.getUint32(28, true),
+        error: view.getUint16(32, true),
+        op: OPS[view.getUint8(34)] ?? `op${view.getUint8(34)}`,
+        route: ROUTES[view.getUint8(35)] ?? 'unknown',
+        // Only the tail of long paths is kept.
+        path: path.length === PATH_TAIL - 1 ? `...${path}` : path,
+    };
+}
+
+/** Records from a ZEROPERL_TRACE_FILE: a header, then records. */
+export function readTraceFile(path) {
+    const bytes = readFileSync(path);
+    decodeHeader(new DataView(bytes.buffer, bytes.byteOffset, bytes.length), 0);
+    const records = [];
+    for (let at = HEADER_SIZE; at + RECORD_SIZE <= bytes.length; at += RECORD_SIZE) {
+        records.push(decodeRecord(bytes, at));
+    }
+    return records;
+}
+
+/**
+ * Tracing on a live instance. The constructor turns it on; drain() returns
+ * the records written since the last drain, and may be called between any
+ * two calls into the instance.
+ */
+export class TraceReader {
+    constructor(instance, { capacity = 0 } = {}) {
+        this.exports = instance.exports;
+        this.ring = this.exports.zeroperl_trace_start(capacity);
+        if (!this.ring) {
+            throw new Error('zeroperl_trace_start failed');
+        }
+        this.dropped = 0n;
+    }
+
+    drain() {
+        const memory = this.exports.memory.buffer;
+        const view = new DataView(memory);
+        const ring = decodeHeader(view, this.ring);
+        const bytes = new Uint8Array(memory);
+        const records = [];
+        for (let n = ring.read; n < ring.written; n++) {
+            records.push(decodeRecord(bytes, ring.records + Number(n % BigInt(ring.capacity)) * RECORD_SIZE));
+        }
+        view.setBigUint64(this.ring + 24, ring.written, true);
+        this.dropped = ring.dropped;
+        return records;
+    }
+
+    stop() {
+        this.exports.zeroperl_trace_stop();
+    }
+}
+
+function countBy(map, key, record) {
+    const entry = map.get(key) ?? { path: record.path, count: 0, ns: 0 };
+    entry.count++;
+    entry.ns += record.elapsedNs;
+    map.set(key, entry);
+}
+
+function top(map, n, min = 1) {
+    return [...map.values()].filter((e) => e.count >= min).sort((a, b) => b.count - a.count).slice(0, n);
+}
+
+/** Group records into the findings formatReport() prints. */
+export function analyse(records, { top: n = 15 } = {}) {
+    const opens = new Map();
+    const stats = new Map();
+    const missing = new Map();
+    const tiny = new Map();
+    const fdPaths = new Map();
+    const totals = new Map();
+
+    for (const r of records) {
+        const t = totals.get(r.op) ?? { op: r.op, sfs: 0, tmpfs: 0, cache: 0, host: 0, failed: 0, ns: 0 };
+        t[r.route]++;
+        t.ns += r.elapsedNs;
+        if (r.result < 0) t.failed++;
+        totals.set(r.op, t);
+
+        if (r.op === 'open' || r.op === 'fopen') {
+            countBy(opens, r.pathHash, r);
+            if (r.result >= 0) fdPaths.set(r.fd, r.path);
+        } else if (r.op === 'stat' || r.op === 'lstat' || r.op === 'access') {
+            countBy(stats, r.pathHash, r);
+        } else if (r.op === 'read' && r.result >= 0 && r.result < TINY_READ && r.arg >= TINY_READ) {
+            // Short reads that asked for more are the ones worth batching.
+            countBy(tiny, r.fd, { ...r, path: fdPaths.get(r.fd) ?? `fd ${r.fd}` });
+        }
+        if (r.result < 0 && r.error === ENOENT && r.pathHash) {
+            countBy(missing, r.pathHash, r);
+        }
+    }
+    return {
+        records: records.length,
+        totals: [...totals.values()],
+        repeatedOpens: top(opens, n, 2),
+        repeatedLookups: top(stats, n, 2),
+        missing: top(missing, n),
+        tinyReads: top(tiny, n),
+        slowest: [...records].sort((a, b) => b.elapsedNs - a.elapsedNs).slice(0, n),
+    };
+}
+
+export function formatReport(report) {
+    const ms = (ns) => (ns / 1e6).toFixed(3);
+    const lines = [`${report.records} calls`];
+    for (const t of report.totals) {
+        lines.push(`  ${t.op.padEnd(7)} sfs ${t.sfs} tmpfs ${t.tmpfs} cache ${t.cache} host ${t.host}, failed ${t.failed}, ${ms(t.ns)} ms`);
+    }
+    const section = (title, entries) => {
+        if (!entries.length) return;
+        lines.push('', title);
+        for (const e of entries) lines.push(`  ${String(e.count).padStart(6)}  ${ms(e.ns).padStart(9)} ms  ${e.path}`);
+    };
+    section('Opened more than once:', report.repeatedOpens);
+    section('Looked up more than once:', report.repeatedLookups);
+    section('Not found (ENOENT):', report.missing);
+    section(`Reads under ${TINY_READ} bytes:`, report.tinyReads);
+    if (report.slowest.length) {
+        lines.push('', 'Slowest calls:');
+        for (const r of report.slowest) {
+            lines.push(`  ${ms(r.elapsedNs).padStart(9)} ms  ${r.op} ${r.route} ${r.path || `fd ${r.fd}`} = ${r.result}`);
+        }
+    }
+    return lines.join('\n');
+}
+
+if (process.argv[1] && resolve(process.argv[1]) === fileURLToPath(import.meta.url)) {
+    const args = process.argv.slice(2);
+    const i = args.indexOf('--top');
+    const n = i >= 0 ? parseInt(args.splice(i, 2)[1], 10) : 15;
+    if (args.length !== 1) {
+        console.error('Usage: trace.mjs <trace-file> [--top N]');
+        process.exit(2);
+    }
+    console.log(formatReport(analyse(readTraceFile(args[0]), { top: n })));
+}